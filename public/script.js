@@ -18,9 +18,12 @@ let board = [];
 let isMultiplayer = false;
 let myPlayerId = 0; 
 let gameActive = false;
-let pollInterval = null;
+let pollGeneration = 0;
+let gameSocket = null;
+let stateVersion = 0;
 let currentMode = 'othello'; 
 let currentDifficulty = 'medium';
+let botGeneration = 0;
 
 // --- Auth State ---
 let currentUser = JSON.parse(localStorage.getItem('user')) || null;
@@ -326,6 +329,7 @@ function initGame(mode) {
     
     currentPlayer = BLACK;
     gameActive = true;
+    botGeneration++;
     
     // UI Switch
     lobbyPanel.classList.add('hidden');
@@ -346,7 +350,7 @@ function exitGame(skipNotify = false) {
         myPlayerId = 0;
     }
     gameActive = false;
-    if (pollInterval) clearInterval(pollInterval);
+    stopStatePolling();
     gamePanel.classList.add('hidden');
     lobbyPanel.classList.remove('hidden');
     connectionStatus.innerText = "";
@@ -555,59 +559,6 @@ const weights = [
     [100, -20, 10,  5,  5, 10, -20, 100]
 ];
 
-const precisionWeights = [
-    [100, -25,  10,   5,   5,  10, -25, 100],
-    [-25, -40,  -3,  -3,  -3,  -3, -40, -25],
-    [ 10,  -3,   2,   2,   2,   2,  -3,  10],
-    [  5,  -3,   2,   1,   1,   2,  -3,   5],
-    [  5,  -3,   2,   1,   1,   2,  -3,   5],
-    [ 10,  -3,   2,   2,   2,   2,  -3,  10],
-    [-25, -40,  -3,  -3,  -3,  -3, -40, -25],
-    [100, -25,  10,   5,   5,  10, -25, 100]
-];
-
-function evaluateBoard(targetBoard, player) {
-    let score = 0;
-    const opponent = (player === BLACK) ? WHITE : BLACK;
-    for (let r = 0; r < SIZE; r++) {
-        for (let c = 0; c < SIZE; c++) {
-            if (targetBoard[r][c] === player) score += precisionWeights[r][c];
-            else if (targetBoard[r][c] === opponent) score -= precisionWeights[r][c];
-        }
-    }
-    return score;
-}
-
-function minimax(targetBoard, depth, isMaximizing, player) {
-    const activePlayer = isMaximizing ? player : (player === BLACK ? WHITE : BLACK);
-    const moves = getValidMoves(activePlayer, targetBoard);
-
-    if (depth === 0 || moves.length === 0) {
-        return evaluateBoard(targetBoard, player);
-    }
-
-    if (isMaximizing) {
-        let maxEval = -Infinity;
-        for (const move of moves) {
-            const newBoard = targetBoard.map(row => [...row]);
-            applyMove(move.r, move.c, player, newBoard);
-            const evalScore = minimax(newBoard, depth - 1, false, player);
-            maxEval = Math.max(maxEval, evalScore);
-        }
-        return maxEval;
-    } else {
-        let minEval = Infinity;
-        const opponent = (player === BLACK) ? WHITE : BLACK;
-        for (const move of moves) {
-            const newBoard = targetBoard.map(row => [...row]);
-            applyMove(move.r, move.c, opponent, newBoard);
-            const evalScore = minimax(newBoard, depth - 1, true, player);
-            minEval = Math.min(minEval, evalScore);
-        }
-        return minEval;
-    }
-}
-
 function getBestMoveHeuristic(moves) {
     let bestMove = moves[0];
     let bestScore = -Infinity;
@@ -621,30 +572,38 @@ function getBestMoveHeuristic(moves) {
     return bestMove;
 }
 
-function botTurn() {
+async function requestAiMove() {
+    const res = await fetch('/ai/move', {
+        method: 'POST',
+        headers: { 'Content-Type': 'application/json' },
+        body: JSON.stringify({
+            board: board.flat(),
+            player: WHITE,
+            difficulty: currentDifficulty,
+            mode: currentMode
+        })
+    });
+    if (!res.ok) throw new Error(`AI request failed (${res.status})`);
+    return res.json();
+}
+
+async function botTurn() {
     if (!gameActive || isMultiplayer) return;
     
     const moves = getValidMoves(WHITE);
     if (moves.length === 0) return;
 
-    let move;
-    if (currentDifficulty === 'easy') {
-        move = Math.random() < 0.2 ? moves[Math.floor(Math.random() * moves.length)] : getBestMoveHeuristic(moves);
-    } else if (currentDifficulty === 'medium') {
-        move = getBestMoveHeuristic(moves);
-    } else {
-        let bestScore = -Infinity;
-        move = moves[0];
-        for (const m of moves) {
-            const nextBoard = board.map(row => [...row]);
-            applyMove(m.r, m.c, WHITE, nextBoard);
-            const score = minimax(nextBoard, 3, false, WHITE);
-            if (score > bestScore) {
-                bestScore = score;
-                move = m;
-            }
-        }
+    const generation = botGeneration;
+    let move = null;
+    try {
+        const data = await requestAiMove();
+        if (!data.pass && isValidMove(data.r, data.c, WHITE)) move = { r: data.r, c: data.c };
+    } catch (e) {
+        console.error(e);
     }
+    // The game may have been restarted or left while the server was searching.
+    if (generation !== botGeneration || !gameActive || isMultiplayer) return;
+    if (!move) move = getBestMoveHeuristic(moves);
 
     applyMove(move.r, move.c, WHITE);
     currentPlayer = BLACK;
@@ -696,7 +655,7 @@ function startLocalGame(mode) {
     currentDifficulty = document.getElementById('difficulty-select').value;
     logGameSession('singleplayer', mode, currentDifficulty, 0);
     refreshSessionLists();
-    if (pollInterval) clearInterval(pollInterval);
+    stopStatePolling();
     initGame(mode);
 }
 
@@ -727,8 +686,7 @@ async function startMultiplayerGame(mode) {
         lobbyPanel.classList.add('hidden');
         gamePanel.classList.remove('hidden');
         
-        pollInterval = setInterval(() => pollState(roomId), 1000);
-        pollState(roomId);
+        startGameChannel(roomId);
         logGameSession('multiplayer', currentMode, '', parseInt(roomId, 10) || 0);
         refreshSessionLists();
         
@@ -742,37 +700,117 @@ async function startMultiplayerGame(mode) {
     }
 }
 
-async function pollState(roomId) {
-    try {
-        const res = await fetch(`/state?room=${roomId}`);
-        if (!res.ok) return;
-        const data = await res.json();
-        
-        if (data.status === "timed_out") {
-            alert("Game timed out due to 10 minutes of inactivity.");
-            exitGame();
-            return;
+// The /ws channel carries our moves and the room's per-move deltas (placed square plus flip
+// mask). If the socket can't be opened, or drops mid-game, we fall back to long-polling.
+function startGameChannel(roomId) {
+    stopStatePolling();
+    if (!('WebSocket' in window)) {
+        startStatePolling(roomId);
+        return;
+    }
+    const generation = pollGeneration;
+    const scheme = location.protocol === 'https:' ? 'wss' : 'ws';
+    const socket = new WebSocket(`${scheme}://${location.host}/ws`);
+    gameSocket = socket;
+    socket.onopen = () => {
+        socket.send(JSON.stringify({ t: 'join', room: parseInt(roomId, 10) || 1, player: myPlayerId }));
+    };
+    socket.onmessage = (event) => {
+        if (generation !== pollGeneration) return;
+        const msg = JSON.parse(event.data);
+        if (msg.t === 'state') {
+            updateBoardFromMasks(msg.black, msg.white);
+            applyRoomState(msg.status, msg.turn);
+        } else if (msg.t === 'move') {
+            applyDelta(msg.sq, msg.p, msg.flips);
+            applyRoomState(msg.status, msg.turn);
+        } else if (msg.t === 'closed') {
+            applyRoomState('waiting', currentPlayer);
+        } else if (msg.t === 'error') {
+            console.warn(msg.error);
+        }
+    };
+    socket.onclose = () => {
+        if (gameSocket === socket) gameSocket = null;
+        if (generation === pollGeneration) startStatePolling(roomId);
+    };
+}
+
+// Long-poll: each request parks on the server until the room's version moves past
+// the one we last saw, so moves show up as soon as they land.
+function startStatePolling(roomId) {
+    stopStatePolling();
+    const generation = pollGeneration;
+    stateVersion = 0;
+    (async () => {
+        while (generation === pollGeneration) {
+            const keepGoing = await pollState(roomId, stateVersion);
+            if (!keepGoing) break;
         }
+    })();
+}
 
-        if (gameActive && data.status === "waiting") {
-            alert("Opponent has left the game. Room reset.");
-            exitGame(true);
-            return;
+function stopStatePolling() {
+    pollGeneration++;
+    if (gameSocket) {
+        const socket = gameSocket;
+        gameSocket = null;
+        socket.close();
+    }
+}
+
+async function pollState(roomId, since = 0) {
+    const generation = pollGeneration;
+    try {
+        const query = since ? `&since=${since}` : '';
+        const res = await fetch(`/state?room=${roomId}${query}`);
+        if (generation !== pollGeneration) return false;
+        if (!res.ok) {
+            await new Promise(resolve => setTimeout(resolve, 1000));
+            return true;
         }
+        const data = await res.json();
+        if (generation !== pollGeneration) return false;
+        if (data.version && data.version > stateVersion) stateVersion = data.version;
 
         if (data.status === "active" || data.status === "finished") {
             updateBoardFromState(data.board);
-            currentPlayer = data.turn;
-            gameActive = (data.status === "active");
-            renderBoard();
-            updateUI();
-            
-            if (data.status === "finished") {
-                clearInterval(pollInterval);
-                turnIndicator.innerText = "Game Over!";
-            }
         }
-    } catch (e) { console.error(e); }
+        return applyRoomState(data.status, data.turn);
+    } catch (e) {
+        console.error(e);
+        await new Promise(resolve => setTimeout(resolve, 1000));
+        return true;
+    }
+}
+
+// Shared by /state and /ws once the board is current. Returns false when this client's game is over.
+function applyRoomState(status, turn) {
+    if (status === "timed_out") {
+        alert("Game timed out due to 10 minutes of inactivity.");
+        exitGame();
+        return false;
+    }
+
+    if (gameActive && status === "waiting") {
+        alert("Opponent has left the game. Room reset.");
+        exitGame(true);
+        return false;
+    }
+
+    if (status === "active" || status === "finished") {
+        currentPlayer = turn;
+        gameActive = (status === "active");
+        renderBoard();
+        updateUI();
+
+        if (status === "finished") {
+            stopStatePolling();
+            turnIndicator.innerText = "Game Over!";
+            return false;
+        }
+    }
+    return true;
 }
 
 function updateBoardFromState(flatBoard) {
@@ -786,14 +824,37 @@ function updateBoardFromState(flatBoard) {
     }
 }
 
+// /ws masks are 16 hex digits, bit r * 8 + c.
+function updateBoardFromMasks(blackHex, whiteHex) {
+    const black = BigInt(`0x${blackHex}`);
+    const white = BigInt(`0x${whiteHex}`);
+    for (let sq = 0; sq < SIZE * SIZE; sq++) {
+        const bit = 1n << BigInt(sq);
+        board[Math.floor(sq / SIZE)][sq % SIZE] = (black & bit) ? BLACK : (white & bit) ? WHITE : 0;
+    }
+}
+
+function applyDelta(square, player, flipsHex) {
+    const flips = BigInt(`0x${flipsHex}`);
+    board[Math.floor(square / SIZE)][square % SIZE] = player;
+    for (let sq = 0; sq < SIZE * SIZE; sq++) {
+        if (flips & (1n << BigInt(sq))) board[Math.floor(sq / SIZE)][sq % SIZE] = player;
+    }
+}
+
 async function sendMove(r, c) {
+    if (gameSocket && gameSocket.readyState === WebSocket.OPEN) {
+        // The resulting delta comes back over the socket like everyone else's.
+        gameSocket.send(JSON.stringify({ t: 'move', r, c }));
+        return;
+    }
     const roomId = document.getElementById('room-input').value;
     try {
         await fetch(`/move?room=${roomId}`, { 
             method: 'POST',
             body: JSON.stringify({ r, c, player: myPlayerId })
         });
-        pollState(roomId);
+        // The pending long-poll wakes on our own move; no extra fetch needed.
     } catch (e) { console.error(e); }
 }
 
@@ -1053,6 +1114,6 @@ if (window.initialState) {
         renderBoard(); // Hydrate board
         updateUI();
         
-        pollInterval = setInterval(() => pollState(s.roomId), 1000);
+        startStatePolling(s.roomId);
     }
 }
@@ -13,16 +13,85 @@
 
 #include "../data/db.h"
 #include "../http/handlers.h"
+#include "../http/page_template.h"
+#include "../http/static_assets.h"
+#include "../http/ws_game.h"
 #include "../core/memory.h"
+#include "../core/metrics.h"
+#include "../game/ai_pool.h"
+#include "../game/tt.h"
 
 #define PORT 31744
+#define INDEX_TEMPLATE "templates/index.html.tmpl"
+#define STATIC_DIR "./public"
+#define STATIC_PREFIX "/static"
+#define AI_TT_MB 64
+/* AI search worker threads; 0 means one per online core. */
+#define AI_WORKERS 0
+/* The cleanup thread ticks every second; session compaction and memory collection run every
+   this many ticks. */
+#define CLEANUP_HOUSEKEEPING_TICKS 60
+
+/* Every API route. Each handler runs inside its thread's request arena (cev_arena_*), so the
+   cJSON trees it builds are released in one step when it returns. */
+#define API_ROUTES(X) \
+    X(get, "/", root_handler) \
+    X(post, "/join", join_handler) \
+    X(post, "/leave", leave_handler) \
+    X(get, "/state", state_handler) \
+    X(post, "/move", move_handler) \
+    X(post, "/ai/move", ai_move_handler) \
+    X(get, "/ai/stats", ai_stats_handler) \
+    X(post, "/login", login_handler) \
+    X(post, "/register", register_handler) \
+    X(get, "/rankings", rankings_handler) \
+    X(get, "/user_info", user_info_handler) \
+    X(get, "/rooms", rooms_handler) \
+    X(get, "/sessions", sessions_handler) \
+    X(post, "/sessions/log", sessions_log_handler) \
+    X(get, "/betting/enter", betting_enter_handler) \
+    X(get, "/betting/slots", betting_slots_handler) \
+    X(get, "/betting/rankings", betting_rankings_handler) \
+    X(post, "/betting/place", betting_place_handler) \
+    X(post, "/betting/multiplayer/place", betting_multiplayer_place_handler) \
+    X(get, "/betting/multiplayer/history", betting_multiplayer_history_handler) \
+    X(get, "/betting/multiplayer/predict", betting_multiplayer_predict_handler) \
+    X(get, "/admin/locks", admin_locks_handler) \
+    X(get, "/admin/mem", admin_mem_handler) \
+    X(get, "/metrics", metrics_handler)
+
+/* Every route runs inside a request arena and is timed into /metrics. */
+#define DEFINE_ROUTE_WRAPPER(method, path, handler) \
+    static int handler##_metric = -1; \
+    static void handler##_wrapped(cwist_http_request *req, cwist_http_response *res) { \
+        uint64_t start = cev_metrics_now_ns(); \
+        cev_arena_begin(); \
+        handler(req, res); \
+        cev_arena_reset(); \
+        cev_metrics_observe(handler##_metric, res->status_code, cev_metrics_now_ns() - start); \
+    }
+API_ROUTES(DEFINE_ROUTE_WRAPPER)
+DEFINE_ROUTE_WRAPPER(get, STATIC_PREFIX "/*", static_asset_handler)
 
 void *cleanup_thread(void *arg) {
     cwist_db *db = (cwist_db *)arg;
-    while(1) {
-        sleep(60);
+    for (unsigned tick = 1;; tick++) {
+        // Room expiry is driven by a timer wheel, so the per-second pass only touches rooms
+        // that are actually due; the heavier housekeeping still runs once a minute.
+        sleep(1);
         cleanup_stale_rooms(db);
+        if (tick % CLEANUP_HOUSEKEEPING_TICKS != 0) continue;
+
+        int compacted = db_compact_sessions(db);
+        if (compacted > 0) printf("[ceversi] sessions: rolled %d old rows into session_totals\n", compacted);
         cev_mem_collect();
+
+        cev_mem_totals mem;
+        cev_mem_get_totals(&mem);
+        printf("[ceversi] mem: live=%llu bytes in %llu objects, %.1f allocs/s, expired=%llu, failed=%llu\n",
+               (unsigned long long)mem.live_bytes, (unsigned long long)mem.live_objects,
+               mem.allocs_per_sec, (unsigned long long)mem.expired, (unsigned long long)mem.failures);
+        fflush(stdout);
     }
     return NULL;
 }
@@ -35,15 +104,54 @@ int main(int argc, char **argv) {
     }
 
     int use_https = 1;
+    int dev_mode = 0;
+    int explain = 0;
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--no-certs") == 0) {
             use_https = 0;
+        } else if (strcmp(argv[i], "--dev") == 0) {
+            dev_mode = 1;
+        } else if (strcmp(argv[i], "--explain") == 0) {
+            explain = 1;
         }
     }
 
     signal(SIGPIPE, SIG_IGN);
     cev_mem_bootstrap();
 
+    int tt_mb = AI_TT_MB;
+    char *tt_env = getenv("AI_TT_MB");
+    if (tt_env) {
+        tt_mb = atoi(tt_env);
+    }
+    if (tt_mb > 0 && tt_init((size_t)tt_mb) != 0) {
+        fprintf(stderr, "Failed to allocate %d MiB AI transposition table; searching uncached\n", tt_mb);
+    }
+
+    int ai_workers = AI_WORKERS;
+    char *ai_workers_env = getenv("AI_WORKERS");
+    if (ai_workers_env) {
+        ai_workers = atoi(ai_workers_env);
+    }
+    if (ai_workers <= 0) {
+        ai_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (ai_pool_start(ai_workers) == 0) {
+        fprintf(stderr, "Failed to start AI worker pool; searching on request threads\n");
+    }
+
+    // Outside --dev, public/ is served from memory, precompressed, and the page links to
+    // content-hashed URLs. Loaded before the template so its links can be rewritten.
+    if (!dev_mode) {
+        int assets = static_assets_load(STATIC_DIR, STATIC_PREFIX);
+        printf("Loaded %d static assets from %s\n", assets, STATIC_DIR);
+    }
+
+    // --dev recompiles the page template whenever the file changes.
+    if (page_template_load(INDEX_TEMPLATE, dev_mode) != 0) {
+        fprintf(stderr, "Failed to compile %s; / will answer 500\n", INDEX_TEMPLATE);
+    }
+
     cwist_app *app = cwist_app_create();
     if (!app) {
         fprintf(stderr, "Failed to create cwist app\n");
@@ -65,36 +173,59 @@ int main(int argc, char **argv) {
     cwist_db *db = cwist_app_get_db(app);
     init_db(db); 
 
+    // Session history kept per identity (SESSION_KEEP_SINGLE / SESSION_KEEP_MULTI, 0 = keep all).
+    int keep_single = DB_SESSION_KEEP_DEFAULT;
+    int keep_multi = DB_SESSION_KEEP_DEFAULT;
+    char *keep_env = getenv("SESSION_KEEP_SINGLE");
+    if (keep_env) {
+        keep_single = atoi(keep_env);
+    }
+    keep_env = getenv("SESSION_KEEP_MULTI");
+    if (keep_env) {
+        keep_multi = atoi(keep_env);
+    }
+    db_set_session_retention(keep_single, keep_multi);
+
+    // --explain refuses to serve while a hot query would scan a whole table.
+    if (explain) {
+        int scans = db_explain_queries();
+        if (scans != 0) {
+            fprintf(stderr, "--explain: %d statement(s) without a usable index; refusing to start\n", scans);
+            ai_pool_stop();
+            cwist_app_destroy(app);
+            return 1;
+        }
+        printf("--explain: every hot statement uses an index\n");
+    }
+
     pthread_t tid;
     pthread_create(&tid, NULL, cleanup_thread, db);
     pthread_detach(tid);
 
     // Explicit API Routes
-    cwist_app_get(app, "/", root_handler);
-    cwist_app_post(app, "/join", join_handler);
-    cwist_app_post(app, "/leave", leave_handler);
-    cwist_app_get(app, "/state", state_handler);
-    cwist_app_post(app, "/move", move_handler);
-    cwist_app_post(app, "/login", login_handler);
-    cwist_app_post(app, "/register", register_handler);
-    cwist_app_get(app, "/rankings", rankings_handler);
-    cwist_app_get(app, "/user_info", user_info_handler);
-    cwist_app_get(app, "/rooms", rooms_handler);
-    cwist_app_get(app, "/sessions", sessions_handler);
-    cwist_app_post(app, "/sessions/log", sessions_log_handler);
-    cwist_app_get(app, "/betting/enter", betting_enter_handler);
-    cwist_app_get(app, "/betting/slots", betting_slots_handler);
-    cwist_app_get(app, "/betting/rankings", betting_rankings_handler);
-    cwist_app_post(app, "/betting/place", betting_place_handler);
-    cwist_app_post(app, "/betting/multiplayer/place", betting_multiplayer_place_handler);
-    cwist_app_get(app, "/betting/multiplayer/history", betting_multiplayer_history_handler);
+#define REGISTER_ROUTE(method, path, handler) \
+    handler##_metric = cev_metrics_route(#method, path); \
+    cwist_app_##method(app, path, handler##_wrapped);
+    API_ROUTES(REGISTER_ROUTE)
+#undef REGISTER_ROUTE
+
+    // Persistent game channel: moves in, per-move deltas out to players and spectators.
+    ws_game_init();
+    cwist_app_ws(app, "/ws", ws_game_handler);
     
-    // Static files fallback
-    cwist_app_static(app, "/static", "./public"); 
+    static_asset_handler_metric = cev_metrics_route("get", STATIC_PREFIX "/*");
+    for (int i = 0; i < static_assets_count(); i++) {
+        cwist_app_get(app, static_assets_url(i), static_asset_handler_wrapped);
+        cwist_app_get(app, static_assets_hashed_url(i), static_asset_handler_wrapped);
+    }
+
+    // Static files fallback (everything in --dev, files added after startup otherwise)
+    cwist_app_static(app, STATIC_PREFIX, STATIC_DIR);
 
     printf("Starting %s Othello Server on port %d...\n", use_https ? "HTTPS" : "HTTP", port);
     
     int rc = cwist_app_listen(app, port);
+    ai_pool_stop();
     cwist_app_destroy(app);
     return rc;
 }
@@ -0,0 +1,214 @@
+#include "json_writer.h"
+
+#include "metrics.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CEV_JSON_INITIAL 4096
+
+static pthread_key_t writer_key;
+static pthread_once_t writer_once = PTHREAD_ONCE_INIT;
+
+static void free_writer(void *ptr) {
+    cev_json *w = ptr;
+    free(w->buf);
+    free(w);
+}
+
+static void make_writer_key(void) {
+    pthread_key_create(&writer_key, free_writer);
+}
+
+cev_json *cev_json_thread(void) {
+    pthread_once(&writer_once, make_writer_key);
+    cev_json *w = pthread_getspecific(writer_key);
+    if (!w) {
+        w = calloc(1, sizeof(*w));
+        if (!w) return NULL;
+        pthread_setspecific(writer_key, w);
+    }
+    w->len = 0;
+    w->depth = 0;
+    w->has_items = 0;
+    w->after_key = 0;
+    w->failed = 0;
+    w->started_ns = cev_metrics_now_ns();
+    if (w->buf) w->buf[0] = '\0';
+    return w;
+}
+
+/* Makes room for n more bytes plus the terminator. */
+static int reserve(cev_json *w, size_t n) {
+    if (w->failed) return -1;
+    if (w->len + n + 1 <= w->cap) return 0;
+    size_t cap = w->cap ? w->cap : CEV_JSON_INITIAL;
+    while (cap < w->len + n + 1) cap *= 2;
+    char *grown = realloc(w->buf, cap);
+    if (!grown) {
+        w->failed = 1;
+        return -1;
+    }
+    w->buf = grown;
+    w->cap = cap;
+    return 0;
+}
+
+static void put(cev_json *w, const char *s, size_t n) {
+    if (reserve(w, n) != 0) return;
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+    w->buf[w->len] = '\0';
+}
+
+static void put_char(cev_json *w, char c) {
+    if (reserve(w, 1) != 0) return;
+    w->buf[w->len++] = c;
+    w->buf[w->len] = '\0';
+}
+
+/* Emits the separator a new value or key needs at the current depth. */
+static void before_value(cev_json *w) {
+    if (w->after_key) {
+        w->after_key = 0;
+        return;
+    }
+    uint32_t bit = 1u << w->depth;
+    if (w->has_items & bit) put_char(w, ',');
+    w->has_items |= bit;
+}
+
+static void open_container(cev_json *w, char c) {
+    before_value(w);
+    if (w->depth + 1 >= CEV_JSON_DEPTH_MAX) {
+        w->failed = 1;
+        return;
+    }
+    put_char(w, c);
+    w->depth++;
+    w->has_items &= ~(1u << w->depth);
+}
+
+static void close_container(cev_json *w, char c) {
+    if (w->depth > 0) w->depth--;
+    put_char(w, c);
+}
+
+void cev_json_begin_object(cev_json *w) { open_container(w, '{'); }
+void cev_json_end_object(cev_json *w) { close_container(w, '}'); }
+void cev_json_begin_array(cev_json *w) { open_container(w, '['); }
+void cev_json_end_array(cev_json *w) { close_container(w, ']'); }
+
+static void put_escaped(cev_json *w, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+    put_char(w, '"');
+    const char *run = s;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        put(w, run, (size_t)(s - run));
+        run = s + 1;
+        switch (c) {
+        case '"': put(w, "\\\"", 2); break;
+        case '\\': put(w, "\\\\", 2); break;
+        case '\n': put(w, "\\n", 2); break;
+        case '\r': put(w, "\\r", 2); break;
+        case '\t': put(w, "\\t", 2); break;
+        case '\b': put(w, "\\b", 2); break;
+        case '\f': put(w, "\\f", 2); break;
+        default: {
+            char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+            put(w, esc, sizeof(esc));
+            break;
+        }
+        }
+    }
+    put(w, run, (size_t)(s - run));
+    put_char(w, '"');
+}
+
+void cev_json_key(cev_json *w, const char *key) {
+    before_value(w);
+    put_escaped(w, key ? key : "");
+    put_char(w, ':');
+    w->after_key = 1;
+}
+
+void cev_json_string(cev_json *w, const char *s) {
+    before_value(w);
+    put_escaped(w, s ? s : "");
+}
+
+void cev_json_int(cev_json *w, long long v) {
+    char num[24];
+    int n = snprintf(num, sizeof(num), "%lld", v);
+    before_value(w);
+    put(w, num, (size_t)n);
+}
+
+void cev_json_uint64(cev_json *w, uint64_t v) {
+    char num[24];
+    int n = snprintf(num, sizeof(num), "%llu", (unsigned long long)v);
+    before_value(w);
+    put(w, num, (size_t)n);
+}
+
+void cev_json_double(cev_json *w, double v) {
+    before_value(w);
+    if (!isfinite(v)) {
+        put(w, "null", 4);
+        return;
+    }
+    char num[32];
+    int n = snprintf(num, sizeof(num), "%.15g", v);
+    if (strtod(num, NULL) != v) n = snprintf(num, sizeof(num), "%.17g", v);
+    put(w, num, (size_t)n);
+}
+
+void cev_json_bool(cev_json *w, int v) {
+    before_value(w);
+    if (v) put(w, "true", 4);
+    else put(w, "false", 5);
+}
+
+void cev_json_null(cev_json *w) {
+    before_value(w);
+    put(w, "null", 4);
+}
+
+void cev_json_kv_string(cev_json *w, const char *key, const char *s) {
+    cev_json_key(w, key);
+    cev_json_string(w, s);
+}
+
+void cev_json_kv_int(cev_json *w, const char *key, long long v) {
+    cev_json_key(w, key);
+    cev_json_int(w, v);
+}
+
+void cev_json_kv_uint64(cev_json *w, const char *key, uint64_t v) {
+    cev_json_key(w, key);
+    cev_json_uint64(w, v);
+}
+
+void cev_json_kv_double(cev_json *w, const char *key, double v) {
+    cev_json_key(w, key);
+    cev_json_double(w, v);
+}
+
+void cev_json_kv_bool(cev_json *w, const char *key, int v) {
+    cev_json_key(w, key);
+    cev_json_bool(w, v);
+}
+
+const char *cev_json_data(const cev_json *w) {
+    if (!w || w->failed) return NULL;
+    return w->buf ? w->buf : "";
+}
+
+size_t cev_json_len(const cev_json *w) {
+    return (w && !w->failed) ? w->len : 0;
+}
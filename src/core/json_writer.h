@@ -0,0 +1,55 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CEV_JSON_DEPTH_MAX 32
+
+/* Streaming JSON writer over a growable buffer. Commas and nesting are tracked, so callers
+   only emit keys and values in order. */
+typedef struct cev_json {
+    char *buf;
+    size_t len;
+    size_t cap;
+    int depth;
+    /* Bit d set: the container at depth d already holds a value. */
+    uint32_t has_items;
+    int after_key;
+    int failed;
+    /* When cev_json_thread handed the writer out; send_json charges the elapsed time to the
+       JSON timer in /metrics. */
+    uint64_t started_ns;
+} cev_json;
+
+/* Returns the calling thread's writer, emptied. Its buffer is kept for the thread's lifetime,
+   so a steady stream of responses does no heap allocation. */
+cev_json *cev_json_thread(void);
+
+void cev_json_begin_object(cev_json *w);
+void cev_json_end_object(cev_json *w);
+void cev_json_begin_array(cev_json *w);
+void cev_json_end_array(cev_json *w);
+
+void cev_json_key(cev_json *w, const char *key);
+void cev_json_string(cev_json *w, const char *s);
+void cev_json_int(cev_json *w, long long v);
+void cev_json_uint64(cev_json *w, uint64_t v);
+/* Prints the shortest form that reads back exactly; NaN and infinities become null. */
+void cev_json_double(cev_json *w, double v);
+void cev_json_bool(cev_json *w, int v);
+void cev_json_null(cev_json *w);
+
+/* key + value shorthands for object members. */
+void cev_json_kv_string(cev_json *w, const char *key, const char *s);
+void cev_json_kv_int(cev_json *w, const char *key, long long v);
+void cev_json_kv_uint64(cev_json *w, const char *key, uint64_t v);
+void cev_json_kv_double(cev_json *w, const char *key, double v);
+void cev_json_kv_bool(cev_json *w, const char *key, int v);
+
+/* NUL-terminated output, or NULL if the buffer could not grow or nesting went past
+   CEV_JSON_DEPTH_MAX. */
+const char *cev_json_data(const cev_json *w);
+size_t cev_json_len(const cev_json *w);
+
+#endif
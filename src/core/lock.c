@@ -0,0 +1,43 @@
+#include "lock.h"
+
+#include <time.h>
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void cev_lock_init(cev_lock *lock) {
+    pthread_mutex_init(&lock->mutex, NULL);
+    lock->acquired = 0;
+    lock->contended = 0;
+    lock->waited_ns = 0;
+}
+
+void cev_lock_acquire(cev_lock *lock) {
+    if (pthread_mutex_trylock(&lock->mutex) != 0) {
+        __atomic_add_fetch(&lock->contended, 1, __ATOMIC_RELAXED);
+        /* Only the slow path is timed, so uncontended acquisitions stay clock-free. */
+        uint64_t start = now_ns();
+        pthread_mutex_lock(&lock->mutex);
+        __atomic_add_fetch(&lock->waited_ns, now_ns() - start, __ATOMIC_RELAXED);
+    }
+    __atomic_add_fetch(&lock->acquired, 1, __ATOMIC_RELAXED);
+}
+
+void cev_lock_release(cev_lock *lock) {
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+uint64_t cev_lock_acquired(const cev_lock *lock) {
+    return __atomic_load_n(&lock->acquired, __ATOMIC_RELAXED);
+}
+
+uint64_t cev_lock_contended(const cev_lock *lock) {
+    return __atomic_load_n(&lock->contended, __ATOMIC_RELAXED);
+}
+
+uint64_t cev_lock_waited_ns(const cev_lock *lock) {
+    return __atomic_load_n(&lock->waited_ns, __ATOMIC_RELAXED);
+}
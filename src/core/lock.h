@@ -0,0 +1,27 @@
+#ifndef LOCK_H
+#define LOCK_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+/* A mutex that counts how often it was taken, how often a caller had to wait for it, and
+   how long those waits took in total. */
+typedef struct cev_lock {
+    pthread_mutex_t mutex;
+    uint64_t acquired;
+    uint64_t contended;
+    uint64_t waited_ns;
+} cev_lock;
+
+#define CEV_LOCK_INITIALIZER { PTHREAD_MUTEX_INITIALIZER, 0, 0, 0 }
+
+void cev_lock_init(cev_lock *lock);
+void cev_lock_acquire(cev_lock *lock);
+void cev_lock_release(cev_lock *lock);
+
+/* Relaxed reads; good enough for monitoring. */
+uint64_t cev_lock_acquired(const cev_lock *lock);
+uint64_t cev_lock_contended(const cev_lock *lock);
+uint64_t cev_lock_waited_ns(const cev_lock *lock);
+
+#endif /* LOCK_H */
@@ -1,6 +1,11 @@
 #include "memory.h"
 
+#include "lock.h"
+#include "slab.h"
+
 #include <cjson/cJSON.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
@@ -9,37 +14,328 @@
 
 #define CEV_MEM_DEFAULT_TTL TT_MINUTE(10)
 #define CEV_MEM_JSON_TTL TT_SECOND(30)
+/* Far beyond any uptime, and still well inside uint64_t once added to the tick count. */
+#define CEV_MEM_PINNED_TTL TT_HOUR(24ULL * 365ULL * 100ULL)
 /* Strict mode in libttak currently corrupts bookkeeping headers, so stick to alignment only. */
 #define CEV_MEM_FLAGS TTAK_MEM_CACHE_ALIGNED
+/* The first arena block is kept across requests; larger requests chain extra blocks that are
+   returned on reset. */
+#define CEV_ARENA_BLOCK (64 * 1024)
+#define CEV_ARENA_ALIGN 16
+
+/* libttak allocations carry a header linking them into the expiry wheel; 64 bytes keeps the
+   caller's pointer cache-aligned. */
+#define CEV_MEM_HEADER 64
+#define CEV_MEM_MAGIC_LIVE 0x63657661u
+#define CEV_MEM_MAGIC_REAPED 0x72656170u
+
+/* Two-level expiry wheel in ticks of 2^30 ns (about a second), as in rooms.c: level 0 holds
+   the next 64 ticks, level 1 64-tick spans out to ~73 minutes. Later deadlines (pinned
+   tables) park in level 1's farthest slot and are re-filed when it cascades. */
+#define CEV_MEM_TICK_SHIFT 30
+#define CEV_MEM_WHEEL_BITS 6
+#define CEV_MEM_WHEEL_SLOTS (1 << CEV_MEM_WHEEL_BITS)
+#define CEV_MEM_WHEEL_MASK (CEV_MEM_WHEEL_SLOTS - 1)
+
+typedef struct cev_mem_header {
+    struct cev_mem_header *prev;
+    struct cev_mem_header *next;
+    uint64_t expires_ns;
+    size_t size;
+    uint32_t site;
+    uint32_t magic;
+    uint8_t level;
+    uint8_t slot;
+} cev_mem_header;
+
+_Static_assert(sizeof(cev_mem_header) <= CEV_MEM_HEADER, "cev_mem header outgrew its slot");
+
+typedef struct cev_mem_site {
+    const char *name;
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t failures;
+    uint64_t expired;
+    uint64_t live_objects;
+    uint64_t live_bytes;
+} cev_mem_site;
+
+/* Guards the expiry wheel, the site table and the rate sample. The last site slot absorbs
+   call sites beyond the table. wheel_now is the next tick still to be reaped. */
+static cev_lock track_lock = CEV_LOCK_INITIALIZER;
+static cev_mem_header *wheel[2][CEV_MEM_WHEEL_SLOTS];
+static uint64_t wheel_now;
+static int wheel_started;
+static cev_mem_site sites[CEV_MEM_SITES_MAX];
+static int site_count;
+static uint64_t rate_sample_ns;
+static uint64_t rate_sample_allocs;
+static uint64_t total_allocs;
+static double allocs_per_sec;
+
+typedef struct cev_arena_block {
+    struct cev_arena_block *next;
+    size_t size;
+    size_t used;
+    _Alignas(CEV_ARENA_ALIGN) unsigned char data[];
+} cev_arena_block;
+
+typedef struct cev_arena {
+    /* Newest block first; the last one is the retained first block. */
+    cev_arena_block *blocks;
+    int active;
+} cev_arena;
+
+static pthread_key_t arena_key;
+static pthread_once_t arena_once = PTHREAD_ONCE_INIT;
 
 static uint64_t cev_mem_now(void) {
     return ttak_get_tick_count_ns();
 }
 
-static void *cev_mem_alloc_internal(size_t size, uint64_t lifetime_ns, ttak_mem_flags_t flags) {
+/* Call with track_lock held. Only a site's first allocation gets here: afterwards its static
+   ref remembers the slot. Names are still compared so a site compiled into several units
+   shares one row. */
+static uint32_t site_index(cev_mem_site_ref *ref) {
+    if (ref->index >= 0) return (uint32_t)ref->index;
+    int i = 0;
+    while (i < site_count && strcmp(sites[i].name, ref->name) != 0) i++;
+    if (i == site_count) {
+        if (site_count == CEV_MEM_SITES_MAX - 1) {
+            sites[site_count].name = "other";
+            site_count++;
+        }
+        if (site_count == CEV_MEM_SITES_MAX) {
+            i = CEV_MEM_SITES_MAX - 1;
+        } else {
+            sites[site_count].name = ref->name;
+            i = site_count++;
+        }
+    }
+    ref->index = i;
+    return (uint32_t)i;
+}
+
+/* Call with track_lock held. */
+static void wheel_unlink(cev_mem_header *h) {
+    if (h->prev) h->prev->next = h->next;
+    else wheel[h->level][h->slot] = h->next;
+    if (h->next) h->next->prev = h->prev;
+}
+
+/* Call with track_lock held. Deadlines already behind the wheel go in the next tick reaped. */
+static void wheel_link(cev_mem_header *h) {
+    uint64_t tick = h->expires_ns >> CEV_MEM_TICK_SHIFT;
+    if (tick < wheel_now) tick = wheel_now;
+    h->level = 0;
+    h->slot = (uint8_t)(tick & CEV_MEM_WHEEL_MASK);
+    if (tick - wheel_now >= CEV_MEM_WHEEL_SLOTS) {
+        uint64_t span = tick >> CEV_MEM_WHEEL_BITS;
+        uint64_t last = (wheel_now >> CEV_MEM_WHEEL_BITS) + CEV_MEM_WHEEL_MASK;
+        h->level = 1;
+        h->slot = (uint8_t)((span < last ? span : last) & CEV_MEM_WHEEL_MASK);
+    }
+    h->prev = NULL;
+    h->next = wheel[h->level][h->slot];
+    if (h->next) h->next->prev = h;
+    wheel[h->level][h->slot] = h;
+}
+
+/* Call with track_lock held. Once wheel_now reaches a 64-tick boundary, re-files the level-1
+   span starting there. Nothing links into that span afterwards, so repeating it is a no-op. */
+static void wheel_cascade(void) {
+    if ((wheel_now & CEV_MEM_WHEEL_MASK) != 0) return;
+    cev_mem_header **span = &wheel[1][(wheel_now >> CEV_MEM_WHEEL_BITS) & CEV_MEM_WHEEL_MASK];
+    cev_mem_header *h = *span;
+    *span = NULL;
+    while (h) {
+        cev_mem_header *next = h->next;
+        wheel_link(h);
+        h = next;
+    }
+}
+
+/* Call with track_lock held, after h has left the wheel. */
+static void reap_header(cev_mem_header *h) {
+    h->magic = CEV_MEM_MAGIC_REAPED;
+    cev_mem_site *site = &sites[h->site];
+    site->expired++;
+    site->live_objects--;
+    site->live_bytes -= h->size;
+}
+
+/* Unlinks every allocation that has expired by now, so libttak can reclaim it without leaving
+   dangling list entries. Each one still unfreed at this point is counted as expired. Ticks that
+   have fully elapsed are emptied wholesale; in the current tick only headers already due are
+   taken. The work is therefore the expired headers, those a cascade re-files and one slot,
+   never the whole live set. */
+static void reap_expired(uint64_t now) {
+    uint64_t now_tick = now >> CEV_MEM_TICK_SHIFT;
+    cev_lock_acquire(&track_lock);
+    if (!wheel_started) {
+        cev_lock_release(&track_lock);
+        return;
+    }
+    while (wheel_now < now_tick) {
+        wheel_cascade();
+        cev_mem_header **slot = &wheel[0][wheel_now & CEV_MEM_WHEEL_MASK];
+        cev_mem_header *h = *slot;
+        *slot = NULL;
+        while (h) {
+            reap_header(h);
+            h = h->next;
+        }
+        wheel_now++;
+    }
+    wheel_cascade();
+    cev_mem_header *h = wheel[0][wheel_now & CEV_MEM_WHEEL_MASK];
+    while (h) {
+        cev_mem_header *next = h->next;
+        if (h->expires_ns <= now) {
+            wheel_unlink(h);
+            reap_header(h);
+        }
+        h = next;
+    }
+    cev_lock_release(&track_lock);
+}
+
+static void *cev_mem_alloc_internal(size_t size, uint64_t lifetime_ns, ttak_mem_flags_t flags,
+                                    cev_mem_site_ref *site) {
     if (size == 0) {
         return NULL;
     }
     uint64_t now = cev_mem_now();
     uint64_t ttl = lifetime_ns ? lifetime_ns : CEV_MEM_DEFAULT_TTL;
-    void *ptr = ttak_mem_alloc_with_flags(size, ttl, now, flags);
-    if (!ptr) {
+    cev_mem_header *h = ttak_mem_alloc_with_flags(CEV_MEM_HEADER + size, ttl, now, flags);
+    if (!h) {
+        reap_expired(now);
         tt_autoclean_dirty_pointers(now);
-        ptr = ttak_mem_alloc_with_flags(size, ttl, cev_mem_now(), flags);
+        now = cev_mem_now();
+        h = ttak_mem_alloc_with_flags(CEV_MEM_HEADER + size, ttl, now, flags);
+    }
+
+    cev_lock_acquire(&track_lock);
+    cev_mem_site *entry = &sites[site_index(site)];
+    if (h) {
+        if (!wheel_started) {
+            wheel_now = now >> CEV_MEM_TICK_SHIFT;
+            wheel_started = 1;
+        }
+        h->expires_ns = now + ttl;
+        wheel_link(h);
+        h->size = size;
+        h->site = (uint32_t)(entry - sites);
+        h->magic = CEV_MEM_MAGIC_LIVE;
+        entry->allocs++;
+        entry->live_objects++;
+        entry->live_bytes += size;
+        total_allocs++;
+    } else {
+        entry->failures++;
+    }
+    cev_lock_release(&track_lock);
+
+    if (!h) {
+        fprintf(stderr, "[ceversi] libttak allocation failed (size=%zu, site=%s)\n", size, site->name);
+        return NULL;
     }
-    if (!ptr) {
-        fprintf(stderr, "[ceversi] libttak allocation failed (size=%zu)\n", size);
+    return (unsigned char *)h + CEV_MEM_HEADER;
+}
+
+static void free_arena(void *ptr) {
+    cev_arena *arena = ptr;
+    while (arena->blocks) {
+        cev_arena_block *next = arena->blocks->next;
+        free(arena->blocks);
+        arena->blocks = next;
     }
+    free(arena);
+}
+
+static void make_arena_key(void) {
+    pthread_key_create(&arena_key, free_arena);
+}
+
+static cev_arena *active_arena(void) {
+    pthread_once(&arena_once, make_arena_key);
+    cev_arena *arena = pthread_getspecific(arena_key);
+    return (arena && arena->active) ? arena : NULL;
+}
+
+static cev_arena_block *new_block(size_t size) {
+    cev_arena_block *block = malloc(sizeof(*block) + size);
+    if (!block) return NULL;
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+static int arena_owns(const cev_arena *arena, const void *ptr) {
+    const unsigned char *p = ptr;
+    for (const cev_arena_block *b = arena->blocks; b; b = b->next) {
+        if (p >= b->data && p < b->data + b->size) return 1;
+    }
+    return 0;
+}
+
+void cev_arena_begin(void) {
+    pthread_once(&arena_once, make_arena_key);
+    cev_arena *arena = pthread_getspecific(arena_key);
+    if (!arena) {
+        arena = calloc(1, sizeof(*arena));
+        if (!arena) return;
+        arena->blocks = new_block(CEV_ARENA_BLOCK);
+        if (!arena->blocks) {
+            free(arena);
+            return;
+        }
+        pthread_setspecific(arena_key, arena);
+    }
+    arena->active = 1;
+}
+
+void *cev_arena_alloc(size_t size) {
+    cev_arena *arena = active_arena();
+    if (!arena || size == 0) return NULL;
+    size = (size + CEV_ARENA_ALIGN - 1) & ~(size_t)(CEV_ARENA_ALIGN - 1);
+    cev_arena_block *block = arena->blocks;
+    if (block->size - block->used < size) {
+        block = new_block(size > CEV_ARENA_BLOCK ? size : CEV_ARENA_BLOCK);
+        if (!block) return NULL;
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+    void *ptr = block->data + block->used;
+    block->used += size;
     return ptr;
 }
 
+void cev_arena_reset(void) {
+    cev_arena *arena = active_arena();
+    if (!arena) return;
+    while (arena->blocks->next) {
+        cev_arena_block *next = arena->blocks->next;
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+    arena->blocks->used = 0;
+    arena->active = 0;
+}
+
+static cev_mem_site_ref cjson_site = { "cjson", -1 };
+
+/* Request arena first; outside a request, small nodes and strings come from the slab pools. */
 static void *cev_cjson_malloc(size_t size) {
-    return cev_mem_alloc_internal(size, CEV_MEM_JSON_TTL, CEV_MEM_FLAGS);
+    void *ptr = active_arena() ? cev_arena_alloc(size) : NULL;
+    if (!ptr) ptr = cev_slab_alloc(size);
+    if (!ptr) ptr = cev_mem_alloc_internal(size, CEV_MEM_JSON_TTL, CEV_MEM_FLAGS, &cjson_site);
+    return ptr;
 }
 
 static void cev_cjson_free(void *ptr) {
-    if (!ptr) return;
-    ttak_mem_free(ptr);
+    cev_mem_free(ptr);
 }
 
 void cev_mem_bootstrap(void) {
@@ -53,18 +349,22 @@ void cev_mem_bootstrap(void) {
     initialized = 1;
 }
 
-void *cev_mem_alloc(size_t size) {
-    return cev_mem_alloc_internal(size, CEV_MEM_DEFAULT_TTL, CEV_MEM_FLAGS);
+void *cev_mem_alloc_at(size_t size, cev_mem_site_ref *site) {
+    return cev_mem_alloc_internal(size, CEV_MEM_DEFAULT_TTL, CEV_MEM_FLAGS, site);
 }
 
-void *cev_mem_alloc_ttl(size_t size, uint64_t lifetime_ns) {
-    return cev_mem_alloc_internal(size, lifetime_ns, CEV_MEM_FLAGS);
+void *cev_mem_alloc_ttl_at(size_t size, uint64_t lifetime_ns, cev_mem_site_ref *site) {
+    return cev_mem_alloc_internal(size, lifetime_ns, CEV_MEM_FLAGS, site);
 }
 
-char *cev_mem_strdup(const char *src) {
+void *cev_mem_alloc_pinned_at(size_t size, cev_mem_site_ref *site) {
+    return cev_mem_alloc_internal(size, CEV_MEM_PINNED_TTL, CEV_MEM_FLAGS, site);
+}
+
+char *cev_mem_strdup_at(const char *src, cev_mem_site_ref *site) {
     if (!src) return NULL;
     size_t len = strlen(src) + 1;
-    char *copy = cev_mem_alloc(len);
+    char *copy = cev_mem_alloc_at(len, site);
     if (!copy) return NULL;
     memcpy(copy, src, len);
     return copy;
@@ -72,9 +372,70 @@ char *cev_mem_strdup(const char *src) {
 
 void cev_mem_free(void *ptr) {
     if (!ptr) return;
-    ttak_mem_free(ptr);
+    cev_arena *arena = active_arena();
+    if (arena && arena_owns(arena, ptr)) return;
+    if (cev_slab_owns(ptr)) {
+        cev_slab_free(ptr);
+        return;
+    }
+    cev_mem_header *h = (cev_mem_header *)((unsigned char *)ptr - CEV_MEM_HEADER);
+    /* The magic is only read under the lock, so a concurrent reap cannot unlink and count the
+       header between the check and the unlink. A reaped header is already out of the wheel and
+       the counts but not yet reclaimed by libttak, so the free still goes through. */
+    cev_lock_acquire(&track_lock);
+    if (h->magic == CEV_MEM_MAGIC_LIVE) {
+        wheel_unlink(h);
+        cev_mem_site *site = &sites[h->site];
+        site->frees++;
+        site->live_objects--;
+        site->live_bytes -= h->size;
+    }
+    h->magic = 0;
+    cev_lock_release(&track_lock);
+    ttak_mem_free(h);
 }
 
 void cev_mem_collect(void) {
-    tt_autoclean_dirty_pointers(cev_mem_now());
+    uint64_t now = cev_mem_now();
+    reap_expired(now);
+    tt_autoclean_dirty_pointers(now);
+
+    cev_lock_acquire(&track_lock);
+    if (rate_sample_ns && now > rate_sample_ns) {
+        allocs_per_sec = (double)(total_allocs - rate_sample_allocs) * 1e9 / (double)(now - rate_sample_ns);
+    }
+    rate_sample_ns = now;
+    rate_sample_allocs = total_allocs;
+    cev_lock_release(&track_lock);
+}
+
+void cev_mem_get_totals(cev_mem_totals *out) {
+    memset(out, 0, sizeof(*out));
+    cev_lock_acquire(&track_lock);
+    for (int i = 0; i < site_count; i++) {
+        out->allocs += sites[i].allocs;
+        out->frees += sites[i].frees;
+        out->failures += sites[i].failures;
+        out->expired += sites[i].expired;
+        out->live_objects += sites[i].live_objects;
+        out->live_bytes += sites[i].live_bytes;
+    }
+    out->allocs_per_sec = allocs_per_sec;
+    cev_lock_release(&track_lock);
+}
+
+int cev_mem_site_stats(cev_mem_site_stat *rows, int max) {
+    cev_lock_acquire(&track_lock);
+    int n = site_count < max ? site_count : max;
+    for (int i = 0; i < n; i++) {
+        snprintf(rows[i].site, sizeof(rows[i].site), "%s", sites[i].name);
+        rows[i].allocs = sites[i].allocs;
+        rows[i].frees = sites[i].frees;
+        rows[i].failures = sites[i].failures;
+        rows[i].expired = sites[i].expired;
+        rows[i].live_objects = sites[i].live_objects;
+        rows[i].live_bytes = sites[i].live_bytes;
+    }
+    cev_lock_release(&track_lock);
+    return n;
 }
@@ -7,15 +7,77 @@
 /* Initializes the libttak-backed memory hooks (idempotent). */
 void cev_mem_bootstrap(void);
 
+/* Every allocation is accounted to the call site that made it (see cev_mem_site_stats). */
+#define CEV_MEM_STR2(x) #x
+#define CEV_MEM_STR(x) CEV_MEM_STR2(x)
+#define CEV_MEM_SITE __FILE__ ":" CEV_MEM_STR(__LINE__)
+
+/* One per call site, static: caches the site's slot in the stats table after its first
+   allocation. index is guarded by the allocator's lock. */
+typedef struct cev_mem_site_ref {
+    const char *name;
+    int index;
+} cev_mem_site_ref;
+
+#define CEV_MEM_SITE_REF ({ static cev_mem_site_ref cev_mem_site_ = { CEV_MEM_SITE, -1 }; &cev_mem_site_; })
+
 /* Strict, tracked allocation helpers. */
-void *cev_mem_alloc(size_t size);
-void *cev_mem_alloc_ttl(size_t size, uint64_t lifetime_ns);
-char *cev_mem_strdup(const char *src);
+#define cev_mem_alloc(size) cev_mem_alloc_at((size), CEV_MEM_SITE_REF)
+#define cev_mem_alloc_ttl(size, lifetime_ns) cev_mem_alloc_ttl_at((size), (lifetime_ns), CEV_MEM_SITE_REF)
+#define cev_mem_strdup(src) cev_mem_strdup_at((src), CEV_MEM_SITE_REF)
+/* Cache-aligned allocation for tables that live as long as the process; never reclaimed by
+   cev_mem_collect. Release with cev_mem_free. */
+#define cev_mem_alloc_pinned(size) cev_mem_alloc_pinned_at((size), CEV_MEM_SITE_REF)
 
-/* Frees memory previously returned from the helpers or libttak-backed cJSON. */
+void *cev_mem_alloc_at(size_t size, cev_mem_site_ref *site);
+void *cev_mem_alloc_ttl_at(size_t size, uint64_t lifetime_ns, cev_mem_site_ref *site);
+char *cev_mem_strdup_at(const char *src, cev_mem_site_ref *site);
+void *cev_mem_alloc_pinned_at(size_t size, cev_mem_site_ref *site);
+
+/* Frees memory previously returned from the helpers or libttak-backed cJSON (arena and slab
+   pointers included). */
 void cev_mem_free(void *ptr);
 
-/* Trigger background collection of expired pointers. */
+/* Trigger background collection of expired pointers. Allocations still unfreed past their
+   TTL are counted as expired against their call site before libttak reclaims them. */
 void cev_mem_collect(void);
 
+#define CEV_MEM_SITES_MAX 64
+
+typedef struct cev_mem_site_stat {
+    char site[64];
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t failures;
+    /* Reclaimed by TTL instead of freed: a leak, or an object still in use when it was reaped. */
+    uint64_t expired;
+    uint64_t live_objects;
+    uint64_t live_bytes;
+} cev_mem_site_stat;
+
+typedef struct cev_mem_totals {
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t failures;
+    uint64_t expired;
+    uint64_t live_objects;
+    uint64_t live_bytes;
+    /* Over the interval between the last two cev_mem_collect calls. */
+    double allocs_per_sec;
+} cev_mem_totals;
+
+/* Covers libttak-backed allocations only; arena and slab memory is reported separately. */
+void cev_mem_get_totals(cev_mem_totals *out);
+/* One row per call site seen so far; returns the number written. */
+int cev_mem_site_stats(cev_mem_site_stat *rows, int max);
+
+/* Per-thread bump-pointer arena for one request. Between cev_arena_begin and cev_arena_reset,
+   cJSON nodes (and the strings cJSON prints) on this thread come from the arena instead of
+   libttak; cev_mem_free and cJSON_Delete on them are no-ops. cev_arena_reset releases it all
+   at once, so nothing allocated in between may outlive the request. */
+void cev_arena_begin(void);
+/* 16-byte aligned; NULL when no arena is active on this thread. */
+void *cev_arena_alloc(size_t size);
+void cev_arena_reset(void);
+
 #endif /* MEMORY_H */
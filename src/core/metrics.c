@@ -0,0 +1,252 @@
+#include "metrics.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Status classes 1xx..5xx. */
+#define STATUS_CLASSES 5
+
+typedef struct route_info {
+    char method[8];
+    char path[64];
+} route_info;
+
+/* One thread's counters. Only the owning thread writes them; scrapes read them with relaxed
+   loads, so a scrape may see a request counted but its latency bucket not yet. */
+typedef struct metrics_shard {
+    uint64_t requests[CEV_METRICS_ROUTES_MAX][STATUS_CLASSES];
+    uint64_t buckets[CEV_METRICS_ROUTES_MAX][CEV_METRICS_BUCKETS];
+    uint64_t sum_ns[CEV_METRICS_ROUTES_MAX];
+    uint64_t timer_calls[CEV_TIMER_COUNT];
+    uint64_t timer_ns[CEV_TIMER_COUNT];
+    struct metrics_shard *next;
+} metrics_shard;
+
+static route_info routes[CEV_METRICS_ROUTES_MAX];
+static int route_count;
+
+/* Guards the shard lists. A thread's shard is folded into 'retired' when the thread exits
+   and parked on the free list for the next thread, so totals never go backwards. */
+static pthread_mutex_t shards_mutex = PTHREAD_MUTEX_INITIALIZER;
+static metrics_shard *live_shards;
+static metrics_shard *free_shards;
+static metrics_shard retired;
+
+static __thread metrics_shard *self;
+static pthread_key_t shard_key;
+static pthread_once_t shard_once = PTHREAD_ONCE_INIT;
+
+static const char *timer_names[CEV_TIMER_COUNT] = {
+    [CEV_TIMER_SQLITE] = "sqlite",
+    [CEV_TIMER_JSON] = "json"
+};
+
+static void bump(uint64_t *counter, uint64_t v) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + v, __ATOMIC_RELAXED);
+}
+
+static uint64_t load(const uint64_t *counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static void fold(uint64_t *dst, uint64_t *src, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] += load(&src[i]);
+        __atomic_store_n(&src[i], 0, __ATOMIC_RELAXED);
+    }
+}
+
+static void retire_shard(void *ptr) {
+    metrics_shard *shard = ptr;
+    pthread_mutex_lock(&shards_mutex);
+    metrics_shard **link = &live_shards;
+    while (*link && *link != shard) link = &(*link)->next;
+    if (*link) *link = shard->next;
+    fold(&retired.requests[0][0], &shard->requests[0][0], sizeof(shard->requests) / sizeof(uint64_t));
+    fold(&retired.buckets[0][0], &shard->buckets[0][0], sizeof(shard->buckets) / sizeof(uint64_t));
+    fold(retired.sum_ns, shard->sum_ns, CEV_METRICS_ROUTES_MAX);
+    fold(retired.timer_calls, shard->timer_calls, CEV_TIMER_COUNT);
+    fold(retired.timer_ns, shard->timer_ns, CEV_TIMER_COUNT);
+    shard->next = free_shards;
+    free_shards = shard;
+    pthread_mutex_unlock(&shards_mutex);
+}
+
+static void make_shard_key(void) {
+    pthread_key_create(&shard_key, retire_shard);
+}
+
+static metrics_shard *thread_shard(void) {
+    if (self) return self;
+    pthread_once(&shard_once, make_shard_key);
+    pthread_mutex_lock(&shards_mutex);
+    metrics_shard *shard = free_shards;
+    if (shard) free_shards = shard->next;
+    else shard = calloc(1, sizeof(*shard));
+    if (shard) {
+        shard->next = live_shards;
+        live_shards = shard;
+    }
+    pthread_mutex_unlock(&shards_mutex);
+    if (!shard) return NULL;
+    pthread_setspecific(shard_key, shard);
+    self = shard;
+    return shard;
+}
+
+static int bucket_of(uint64_t ns) {
+    if (ns < (1ULL << CEV_METRICS_BUCKET_MIN_SHIFT)) return 0;
+    int octave = 63 - __builtin_clzll(ns);
+    if (octave >= CEV_METRICS_BUCKET_MAX_SHIFT) return CEV_METRICS_BUCKETS - 1;
+    int sub = (int)((ns >> (octave - 2)) & (CEV_METRICS_BUCKET_SUBS - 1));
+    return 1 + (octave - CEV_METRICS_BUCKET_MIN_SHIFT) * CEV_METRICS_BUCKET_SUBS + sub;
+}
+
+/* Upper bound in ns of every bucket but the last. */
+static uint64_t bucket_upper(int b) {
+    if (b == 0) return 1ULL << CEV_METRICS_BUCKET_MIN_SHIFT;
+    int octave = CEV_METRICS_BUCKET_MIN_SHIFT + (b - 1) / CEV_METRICS_BUCKET_SUBS;
+    int sub = (b - 1) % CEV_METRICS_BUCKET_SUBS;
+    return (1ULL << octave) + (uint64_t)(sub + 1) * (1ULL << (octave - 2));
+}
+
+uint64_t cev_metrics_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+int cev_metrics_route(const char *method, const char *path) {
+    if (route_count == CEV_METRICS_ROUTES_MAX) return -1;
+    route_info *r = &routes[route_count];
+    snprintf(r->method, sizeof(r->method), "%s", method);
+    for (char *m = r->method; *m; m++) {
+        if (*m >= 'a' && *m <= 'z') *m = (char)(*m - 'a' + 'A');
+    }
+    snprintf(r->path, sizeof(r->path), "%s", path);
+    return route_count++;
+}
+
+void cev_metrics_observe(int route, int status, uint64_t elapsed_ns) {
+    if (route < 0 || route >= CEV_METRICS_ROUTES_MAX) return;
+    metrics_shard *shard = thread_shard();
+    if (!shard) return;
+    /* Handlers that never set a status answer 200. */
+    int class = status >= 100 && status < 600 ? status / 100 - 1 : 1;
+    bump(&shard->requests[route][class], 1);
+    bump(&shard->buckets[route][bucket_of(elapsed_ns)], 1);
+    bump(&shard->sum_ns[route], elapsed_ns);
+}
+
+void cev_metrics_add_time(cev_metrics_timer timer, uint64_t elapsed_ns) {
+    metrics_shard *shard = thread_shard();
+    if (!shard) return;
+    bump(&shard->timer_calls[timer], 1);
+    bump(&shard->timer_ns[timer], elapsed_ns);
+}
+
+void cev_metrics_printf(cev_metrics_buf *b, const char *fmt, ...) {
+    if (b->failed) return;
+    for (;;) {
+        size_t room = b->cap - b->len;
+        va_list ap;
+        va_start(ap, fmt);
+        int n = room ? vsnprintf(b->data + b->len, room, fmt, ap) : -1;
+        va_end(ap);
+        if (n >= 0 && (size_t)n < room) {
+            b->len += (size_t)n;
+            return;
+        }
+        size_t cap = b->cap ? b->cap * 2 : 16384;
+        if (n >= 0 && cap < b->len + (size_t)n + 1) cap = b->len + (size_t)n + 1;
+        char *grown = realloc(b->data, cap);
+        if (!grown) {
+            b->failed = 1;
+            return;
+        }
+        b->data = grown;
+        b->cap = cap;
+    }
+}
+
+void cev_metrics_buf_free(cev_metrics_buf *b) {
+    free(b->data);
+    memset(b, 0, sizeof(*b));
+}
+
+static void add_shard(metrics_shard *out, const metrics_shard *s) {
+    for (int r = 0; r < route_count; r++) {
+        for (int c = 0; c < STATUS_CLASSES; c++) out->requests[r][c] += load(&s->requests[r][c]);
+        for (int k = 0; k < CEV_METRICS_BUCKETS; k++) out->buckets[r][k] += load(&s->buckets[r][k]);
+        out->sum_ns[r] += load(&s->sum_ns[r]);
+    }
+    for (int t = 0; t < CEV_TIMER_COUNT; t++) {
+        out->timer_calls[t] += load(&s->timer_calls[t]);
+        out->timer_ns[t] += load(&s->timer_ns[t]);
+    }
+}
+
+/* Sums every live shard and the retired totals into out. */
+static void snapshot(metrics_shard *out) {
+    memset(out, 0, sizeof(*out));
+    pthread_mutex_lock(&shards_mutex);
+    add_shard(out, &retired);
+    for (const metrics_shard *s = live_shards; s; s = s->next) add_shard(out, s);
+    pthread_mutex_unlock(&shards_mutex);
+}
+
+void cev_metrics_write(cev_metrics_buf *b) {
+    metrics_shard *sum = malloc(sizeof(*sum));
+    if (!sum) {
+        b->failed = 1;
+        return;
+    }
+    snapshot(sum);
+
+    cev_metrics_printf(b, "# HELP ceversi_http_requests_total Requests handled, by route and status class.\n");
+    cev_metrics_printf(b, "# TYPE ceversi_http_requests_total counter\n");
+    for (int r = 0; r < route_count; r++) {
+        for (int c = 0; c < STATUS_CLASSES; c++) {
+            if (!sum->requests[r][c]) continue;
+            cev_metrics_printf(b, "ceversi_http_requests_total{method=\"%s\",route=\"%s\",code=\"%dxx\"} %llu\n",
+                               routes[r].method, routes[r].path, c + 1, (unsigned long long)sum->requests[r][c]);
+        }
+    }
+
+    cev_metrics_printf(b, "# HELP ceversi_http_request_duration_seconds Handler latency, by route.\n");
+    cev_metrics_printf(b, "# TYPE ceversi_http_request_duration_seconds histogram\n");
+    for (int r = 0; r < route_count; r++) {
+        uint64_t cumulative = 0;
+        for (int k = 0; k < CEV_METRICS_BUCKETS - 1; k++) {
+            cumulative += sum->buckets[r][k];
+            cev_metrics_printf(b, "ceversi_http_request_duration_seconds_bucket{method=\"%s\",route=\"%s\",le=\"%.9g\"} %llu\n",
+                               routes[r].method, routes[r].path, (double)bucket_upper(k) / 1e9,
+                               (unsigned long long)cumulative);
+        }
+        cumulative += sum->buckets[r][CEV_METRICS_BUCKETS - 1];
+        cev_metrics_printf(b, "ceversi_http_request_duration_seconds_bucket{method=\"%s\",route=\"%s\",le=\"+Inf\"} %llu\n",
+                           routes[r].method, routes[r].path, (unsigned long long)cumulative);
+        cev_metrics_printf(b, "ceversi_http_request_duration_seconds_sum{method=\"%s\",route=\"%s\"} %.9f\n",
+                           routes[r].method, routes[r].path, (double)sum->sum_ns[r] / 1e9);
+        cev_metrics_printf(b, "ceversi_http_request_duration_seconds_count{method=\"%s\",route=\"%s\"} %llu\n",
+                           routes[r].method, routes[r].path, (unsigned long long)cumulative);
+    }
+
+    cev_metrics_printf(b, "# HELP ceversi_time_seconds_total Time spent inside a subsystem.\n");
+    cev_metrics_printf(b, "# TYPE ceversi_time_seconds_total counter\n");
+    for (int t = 0; t < CEV_TIMER_COUNT; t++) {
+        cev_metrics_printf(b, "ceversi_time_seconds_total{subsystem=\"%s\"} %.9f\n",
+                           timer_names[t], (double)sum->timer_ns[t] / 1e9);
+    }
+    cev_metrics_printf(b, "# HELP ceversi_time_calls_total Calls timed into ceversi_time_seconds_total.\n");
+    cev_metrics_printf(b, "# TYPE ceversi_time_calls_total counter\n");
+    for (int t = 0; t < CEV_TIMER_COUNT; t++) {
+        cev_metrics_printf(b, "ceversi_time_calls_total{subsystem=\"%s\"} %llu\n",
+                           timer_names[t], (unsigned long long)sum->timer_calls[t]);
+    }
+    free(sum);
+}
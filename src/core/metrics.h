@@ -0,0 +1,47 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CEV_METRICS_ROUTES_MAX 32
+/* Latency buckets are log-linear: four per power of two from 2^16 ns (~66 us) to 2^32 ns
+   (~4.3 s), one below that range and one above it. */
+#define CEV_METRICS_BUCKET_MIN_SHIFT 16
+#define CEV_METRICS_BUCKET_MAX_SHIFT 32
+#define CEV_METRICS_BUCKET_SUBS 4
+#define CEV_METRICS_BUCKETS \
+    (2 + (CEV_METRICS_BUCKET_MAX_SHIFT - CEV_METRICS_BUCKET_MIN_SHIFT) * CEV_METRICS_BUCKET_SUBS)
+
+/* Time spent in a subsystem, accumulated across all requests. */
+typedef enum cev_metrics_timer {
+    CEV_TIMER_SQLITE,
+    CEV_TIMER_JSON,
+    CEV_TIMER_COUNT
+} cev_metrics_timer;
+
+uint64_t cev_metrics_now_ns(void);
+
+/* Registers a route at startup and returns its id for cev_metrics_observe (-1 when the table
+   is full, which observe ignores). */
+int cev_metrics_route(const char *method, const char *path);
+
+/* Counters live in per-thread shards, so recording is a few uncontended stores. */
+void cev_metrics_observe(int route, int status, uint64_t elapsed_ns);
+void cev_metrics_add_time(cev_metrics_timer timer, uint64_t elapsed_ns);
+
+/* Growable text buffer for the exposition output. */
+typedef struct cev_metrics_buf {
+    char *data;
+    size_t len;
+    size_t cap;
+    int failed;
+} cev_metrics_buf;
+
+void cev_metrics_printf(cev_metrics_buf *b, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void cev_metrics_buf_free(cev_metrics_buf *b);
+
+/* Appends the route counters, latency histograms and subsystem timers, summed over all threads. */
+void cev_metrics_write(cev_metrics_buf *b);
+
+#endif /* METRICS_H */
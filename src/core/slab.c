@@ -0,0 +1,211 @@
+#define _GNU_SOURCE
+#include "slab.h"
+
+#include "lock.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/mman.h>
+
+/* All slab pages are carved from one reserved range so ownership is a bounds check. */
+#define SLAB_RESERVE (1ULL << 30)
+#define SLAB_PAGE (64 * 1024)
+#define SLAB_PAGE_COUNT (SLAB_RESERVE / SLAB_PAGE)
+/* Objects moved between a thread cache and the depot at a time. */
+#define SLAB_BATCH 64
+
+static const size_t class_size[CEV_SLAB_CLASSES] = { 16, 32, 64, 128, 256, 512 };
+
+/* A free object. The first object of a depot batch also links to the next batch. */
+typedef struct slab_free {
+    struct slab_free *next;
+    struct slab_free *next_batch;
+} slab_free;
+
+typedef struct slab_depot {
+    cev_lock lock;
+    slab_free *batches;
+    uint64_t objects;
+    uint64_t pages;
+    /* Folded in from thread caches; lag behind by at most a batch per thread. */
+    uint64_t allocs;
+    uint64_t frees;
+} slab_depot;
+
+/* allocs/frees count locally and are folded into the depot whenever the cache trades with it,
+   so hot paths write nothing shared. */
+typedef struct slab_cache {
+    slab_free *head;
+    int count;
+    uint64_t allocs;
+    uint64_t frees;
+} slab_cache;
+
+static unsigned char *slab_base;
+static uint64_t slab_pages_used;
+static uint8_t page_class[SLAB_PAGE_COUNT];
+static slab_depot depots[CEV_SLAB_CLASSES] = { [0 ... CEV_SLAB_CLASSES - 1] = { CEV_LOCK_INITIALIZER, NULL, 0, 0, 0, 0 } };
+static pthread_once_t slab_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cache_key;
+
+static __thread slab_cache caches[CEV_SLAB_CLASSES];
+static __thread int cache_registered;
+
+static void flush_cache(void *unused);
+
+static void slab_setup(void) {
+    void *base = mmap(NULL, SLAB_RESERVE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "[ceversi] slab reservation failed; small objects fall back to libttak\n");
+        return;
+    }
+    slab_base = base;
+    pthread_key_create(&cache_key, flush_cache);
+}
+
+static int class_of(size_t size) {
+    for (int c = 0; c < CEV_SLAB_CLASSES; c++) {
+        if (size <= class_size[c]) return c;
+    }
+    return -1;
+}
+
+int cev_slab_owns(const void *ptr) {
+    const unsigned char *p = ptr;
+    return slab_base && p >= slab_base && p < slab_base + SLAB_RESERVE;
+}
+
+/* Caller holds the depot lock. Stats are read without it, hence the atomics. */
+static void fold_counters(slab_depot *d, slab_cache *cache) {
+    __atomic_add_fetch(&d->allocs, cache->allocs, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&d->frees, cache->frees, __ATOMIC_RELAXED);
+    cache->allocs = 0;
+    cache->frees = 0;
+}
+
+/* Parks a NULL-terminated list of count objects in the depot as one batch. */
+static void depot_put(int c, slab_free *batch, int count) {
+    slab_depot *d = &depots[c];
+    cev_lock_acquire(&d->lock);
+    batch->next_batch = d->batches;
+    d->batches = batch;
+    __atomic_add_fetch(&d->objects, (uint64_t)count, __ATOMIC_RELAXED);
+    fold_counters(d, &caches[c]);
+    cev_lock_release(&d->lock);
+}
+
+/* Refills an empty cache: a depot batch if there is one, else a freshly carved page. */
+static int refill(int c) {
+    slab_depot *d = &depots[c];
+    slab_cache *cache = &caches[c];
+
+    cev_lock_acquire(&d->lock);
+    fold_counters(d, cache);
+    slab_free *batch = d->batches;
+    if (batch) {
+        d->batches = batch->next_batch;
+        int n = 0;
+        for (slab_free *o = batch; o; o = o->next) n++;
+        __atomic_sub_fetch(&d->objects, (uint64_t)n, __ATOMIC_RELAXED);
+        cev_lock_release(&d->lock);
+        cache->head = batch;
+        cache->count = n;
+        return 0;
+    }
+    cev_lock_release(&d->lock);
+
+    uint64_t page = __atomic_fetch_add(&slab_pages_used, 1, __ATOMIC_RELAXED);
+    if (page >= SLAB_PAGE_COUNT) return -1;
+    page_class[page] = (uint8_t)c;
+    __atomic_add_fetch(&d->pages, 1, __ATOMIC_RELAXED);
+
+    unsigned char *start = slab_base + page * SLAB_PAGE;
+    size_t size = class_size[c];
+    size_t n = SLAB_PAGE / size;
+    slab_free *head = NULL;
+    for (size_t i = n; i-- > 0;) {
+        slab_free *o = (slab_free *)(start + i * size);
+        o->next = head;
+        head = o;
+    }
+    cache->head = head;
+    cache->count = (int)n;
+    return 0;
+}
+
+void *cev_slab_alloc(size_t size) {
+    int c = size ? class_of(size) : -1;
+    if (c < 0) return NULL;
+    pthread_once(&slab_once, slab_setup);
+    if (!slab_base) return NULL;
+    if (!cache_registered) {
+        pthread_setspecific(cache_key, caches);
+        cache_registered = 1;
+    }
+
+    slab_cache *cache = &caches[c];
+    if (!cache->head && refill(c) != 0) return NULL;
+    slab_free *o = cache->head;
+    cache->head = o->next;
+    cache->count--;
+    cache->allocs++;
+    return o;
+}
+
+void cev_slab_free(void *ptr) {
+    if (!ptr || !cev_slab_owns(ptr)) return;
+    size_t page = (size_t)((unsigned char *)ptr - slab_base) / SLAB_PAGE;
+    int c = page_class[page];
+    if (!cache_registered) {
+        pthread_setspecific(cache_key, caches);
+        cache_registered = 1;
+    }
+
+    slab_cache *cache = &caches[c];
+    slab_free *o = ptr;
+    o->next = cache->head;
+    cache->head = o;
+    cache->count++;
+    cache->frees++;
+
+    /* Keep one batch for the next allocations and hand the older one back. */
+    if (cache->count >= 2 * SLAB_BATCH) {
+        slab_free *keep_tail = cache->head;
+        for (int i = 1; i < SLAB_BATCH; i++) keep_tail = keep_tail->next;
+        slab_free *batch = keep_tail->next;
+        keep_tail->next = NULL;
+        cache->count = SLAB_BATCH;
+        depot_put(c, batch, SLAB_BATCH);
+    }
+}
+
+/* Thread exit: everything still cached goes back to the depot. */
+static void flush_cache(void *unused) {
+    (void)unused;
+    for (int c = 0; c < CEV_SLAB_CLASSES; c++) {
+        if (caches[c].head) {
+            depot_put(c, caches[c].head, caches[c].count);
+        } else {
+            cev_lock_acquire(&depots[c].lock);
+            fold_counters(&depots[c], &caches[c]);
+            cev_lock_release(&depots[c].lock);
+        }
+        caches[c].head = NULL;
+        caches[c].count = 0;
+    }
+}
+
+int cev_slab_stats(cev_slab_stat *rows, int max) {
+    int n = 0;
+    for (int c = 0; c < CEV_SLAB_CLASSES && n < max; c++, n++) {
+        slab_depot *d = &depots[c];
+        rows[n].object_size = class_size[c];
+        rows[n].pages = __atomic_load_n(&d->pages, __ATOMIC_RELAXED);
+        rows[n].allocs = __atomic_load_n(&d->allocs, __ATOMIC_RELAXED);
+        rows[n].frees = __atomic_load_n(&d->frees, __ATOMIC_RELAXED);
+        rows[n].depot_objects = __atomic_load_n(&d->objects, __ATOMIC_RELAXED);
+        rows[n].depot_acquired = cev_lock_acquired(&d->lock);
+        rows[n].depot_contended = cev_lock_contended(&d->lock);
+    }
+    return n;
+}
@@ -0,0 +1,36 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Size-class slab pools for small fixed-size objects. Each thread keeps a free list per class
+   and trades objects with a global depot in batches, so steady-state alloc/free touches no lock.
+   Depot locks are leaves: nothing else is acquired while one is held. */
+
+#define CEV_SLAB_CLASSES 6
+/* Largest object size served; bigger requests return NULL. */
+#define CEV_SLAB_MAX 512
+
+typedef struct cev_slab_stat {
+    size_t object_size;
+    uint64_t pages;         /* slab pages carved for this class */
+    /* Per-thread counts fold in whenever a thread trades a batch, so these lag slightly. */
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t depot_objects; /* free objects parked in the global depot */
+    uint64_t depot_acquired;
+    uint64_t depot_contended;
+} cev_slab_stat;
+
+/* NULL when size is 0 or above CEV_SLAB_MAX, or the slab address range is exhausted. */
+void *cev_slab_alloc(size_t size);
+/* ptr must come from cev_slab_alloc (any thread). */
+void cev_slab_free(void *ptr);
+/* Whether ptr lies inside the slab address range. */
+int cev_slab_owns(const void *ptr);
+
+/* One row per size class; returns the number of rows written. */
+int cev_slab_stats(cev_slab_stat *rows, int max);
+
+#endif /* SLAB_H */
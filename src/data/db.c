@@ -1,7 +1,12 @@
 #include "db.h"
 
 #include "../game/betting_logic.h"
+#include "../game/endgame.h"
 #include "../core/memory.h"
+#include "db_stmt.h"
+#include "../core/lock.h"
+#include "rooms.h"
+#include "leaderboard.h"
 #include <cwist/core/db/sql.h>
 #include <cwist/sys/err/cwist_err.h>
 #include <cjson/cJSON.h>
@@ -12,11 +17,77 @@
 #include <pthread.h>
 #include <time.h>
 #include <limits.h>
+#include <math.h>
+
+#define ROOM_FLUSH_BATCH 128
+#define ROOM_FLUSH_IDLE_MS 1000
+#define PREDICT_CACHE_SLOTS 64
+/* Each compaction batch holds every domain lock; cap the rows and identities it visits and how
+   many batches run per cleanup pass so requests never queue behind a large backlog. */
+#define SESSION_COMPACT_BATCH 256
+#define SESSION_COMPACT_MAX_BATCHES 16
 
 cwist_db *db_conn = NULL;
-static pthread_mutex_t db_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* One lock per data domain; each prepared statement belongs to exactly one of them.
+   Lock order, outermost first: games -> users -> sessions -> betting -> room stripe (rooms.c)
+   -> rooms.c expiry wheel, dirty queue or room watcher (http/room_feed.c's pending queue), never
+   two of the last three. Request paths never nest two domain locks or a stripe and a domain
+   lock: a room stripe is released before any domain lock is taken. Only init_db, session
+   compaction and bet settlement hold several at once, and each holds them all: the latter two
+   may roll back, and the shared connection would otherwise sweep another domain's concurrent
+   write into the transaction and undo it.
+   The slab depot locks (core/slab.c) are leaves below all of these. */
+static cev_lock games_lock = CEV_LOCK_INITIALIZER;
+static cev_lock users_lock = CEV_LOCK_INITIALIZER;
+static cev_lock sessions_lock = CEV_LOCK_INITIALIZER;
+static cev_lock betting_lock = CEV_LOCK_INITIALIZER;
+
+static const struct {
+    const char *name;
+    cev_lock *lock;
+} domain_locks[] = {
+    { "games", &games_lock },
+    { "users", &users_lock },
+    { "sessions", &sessions_lock },
+    { "betting", &betting_lock },
+};
+#define DOMAIN_LOCK_COUNT (int)(sizeof(domain_locks) / sizeof(domain_locks[0]))
+
+static void lock_all_domains(void) {
+    for (int i = 0; i < DOMAIN_LOCK_COUNT; i++) cev_lock_acquire(domain_locks[i].lock);
+}
+
+static void unlock_all_domains(void) {
+    for (int i = DOMAIN_LOCK_COUNT - 1; i >= 0; i--) cev_lock_release(domain_locks[i].lock);
+}
 static int betting_db_ready = 0;
+/* Highest multiplayer bet id inserted so far; a queued settlement pays bets up to it. */
+static long long last_bet_id = 0;
+static int session_keep_single = DB_SESSION_KEEP_DEFAULT;
+static int session_keep_multi = DB_SESSION_KEEP_DEFAULT;
 static int betting_db_warning_logged = 0;
+/* Tops of the two ranking tables, guarded by users_lock and betting_lock respectively. Each
+   keeps twice the rows it serves so a dropping leader rarely forces a reload. */
+static leaderboard user_board;
+static leaderboard betting_board;
+static uint64_t slots_version = 1;
+
+typedef struct settle_job {
+    int room_id;
+    int winner_player;
+    long long max_bet_id;
+} settle_job;
+
+/* Settlements waiting for settler_thread. settle_mutex is a leaf lock. */
+static settle_job *settle_queue = NULL;
+static int settle_count = 0;
+static int settle_cap = 0;
+static int settler_running = 0;
+static pthread_mutex_t settle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t settle_cond = PTHREAD_COND_INITIALIZER;
+
+static void *settler_thread(void *arg);
+
 static int safe_add_points(int base, long long delta) {
     long long sum = (long long)base + delta;
     return betting_clamp_points(sum);
@@ -50,15 +121,6 @@ static void sql_escape(const char *in, char *out, size_t out_sz) {
     out[j] = '\0';
 }
 
-static int json_to_int(cJSON *obj, const char *key, int fallback) {
-    if (!obj || !key) return fallback;
-    cJSON *item = cJSON_GetObjectItem(obj, key);
-    if (!item) return fallback;
-    if (item->valuestring) return atoi(item->valuestring);
-    if (cJSON_IsNumber(item)) return item->valueint;
-    return fallback;
-}
-
 static int betting_db_available(void) {
     if (!betting_db_ready && !betting_db_warning_logged) {
         fprintf(stderr, "betting database is not attached; betting endpoints are unavailable\n");
@@ -161,20 +223,209 @@ static int ensure_betting_db_attached(cwist_db *db) {
     return 1;
 }
 
+/* Parses the pre-BLOB "0,1,2,..." board text (row-major, 64 cells) as leniently as the old
+   reader did: cells past the text stay empty. Only the migration reads it. */
+static void parse_legacy_board(const char *in, bitboard *board) {
+    bitboard_init(board, 0);
+    int sq = 0;
+    while (*in && sq < SIZE * SIZE) {
+        int v = atoi(in);
+        if (v == BLACK) board->black |= BITBOARD_BIT(sq);
+        else if (v == WHITE) board->white |= BITBOARD_BIT(sq);
+        sq++;
+        while (*in && *in != ',') in++;
+        if (*in == ',') in++;
+    }
+}
+
+/* Schema versions, kept in PRAGMA user_version. */
+#define SCHEMA_BOARD_BLOB 1
+#define SCHEMA_VERSION SCHEMA_BOARD_BLOB
+
+static int schema_version(cwist_db *db) {
+    cJSON *rows = NULL;
+    int version = 0;
+    cwist_db_query(db, "PRAGMA user_version;", &rows);
+    if (rows) {
+        cJSON *value = cJSON_GetObjectItem(cJSON_GetArrayItem(rows, 0), "user_version");
+        if (value && cJSON_IsNumber(value)) version = value->valueint;
+        else if (value && cJSON_IsString(value)) version = atoi(value->valuestring);
+        cJSON_Delete(rows);
+    }
+    return version;
+}
+
+typedef struct legacy_board {
+    int room_id;
+    bitboard board;
+} legacy_board;
+
+/* Rewrites every CSV board as a 16-byte BLOB in one transaction. Rows are read first and
+   updated after, so the scan never sees its own writes. */
+static void migrate_board_blobs(cwist_db *db) {
+    legacy_board *boards = NULL;
+    int n = 0;
+    int cap = 0;
+    sqlite3_stmt *rows = db_stmt_get(STMT_GAME_LEGACY_BOARDS);
+    while (db_stmt_row(rows) == 1) {
+        if (n == cap) {
+            int grow = cap ? cap * 2 : 64;
+            legacy_board *tmp = realloc(boards, sizeof(legacy_board) * (size_t)grow);
+            if (!tmp) break;
+            boards = tmp;
+            cap = grow;
+        }
+        char board_str[256];
+        boards[n].room_id = db_col_int(rows, 0);
+        db_col_text(rows, 1, board_str, sizeof(board_str));
+        parse_legacy_board(board_str, &boards[n].board);
+        n++;
+    }
+    db_stmt_done(rows);
+
+    int failed = 0;
+    db_stmt_exec(db_stmt_get(STMT_BEGIN));
+    for (int i = 0; i < n; i++) {
+        uint8_t blob[BITBOARD_BYTES];
+        bitboard_pack(&boards[i].board, blob);
+        sqlite3_stmt *st = db_stmt_get(STMT_GAME_SET_BOARD);
+        db_stmt_bind(st, "bi", blob, BITBOARD_BYTES, boards[i].room_id);
+        if (db_stmt_exec(st) != SQLITE_OK) failed++;
+    }
+    db_stmt_exec(db_stmt_get(failed ? STMT_ROLLBACK : STMT_COMMIT));
+    free(boards);
+
+    if (failed > 0) {
+        /* Left at the old version, so the next start retries. */
+        fprintf(stderr, "Board BLOB migration failed for %d of %d games; rolled back\n", failed, n);
+        return;
+    }
+    if (n > 0) fprintf(stderr, "Migrated %d game boards to BLOB storage\n", n);
+    char sql[64];
+    snprintf(sql, sizeof(sql), "PRAGMA user_version = %d;", SCHEMA_VERSION);
+    cwist_db_exec(db, sql);
+}
+
+/* Truncating copy; dst is always terminated. */
+static void copy_field(char *dst, size_t n, const char *src) {
+    if (n == 0) return;
+    size_t len = 0;
+    if (src) {
+        while (len + 1 < n && src[len]) len++;
+        memcpy(dst, src, len);
+    }
+    dst[len] = '\0';
+}
+
+/* Populates the resident room table from the games table. Runs once, before the flusher starts. */
+static void load_rooms(void) {
+    sqlite3_stmt *st = db_stmt_get(STMT_GAME_LOAD);
+    if (!st) return;
+    while (db_stmt_row(st) == 1) {
+        int room_id = db_col_int(st, 0);
+        rooms_lock(room_id);
+        room_record *room = rooms_create(room_id);
+        if (!room) {
+            rooms_unlock(room_id);
+            continue;
+        }
+        uint8_t blob[BITBOARD_BYTES];
+        if (db_col_blob(st, 1, blob, sizeof(blob)) != 0 || bitboard_unpack(&room->board, blob, sizeof(blob)) != 0) {
+            bitboard_init(&room->board, 0);
+        }
+        room->turn = db_col_int(st, 2);
+        if (room->turn != BLACK && room->turn != WHITE) room->turn = BLACK;
+        db_col_text(st, 3, room->status, sizeof(room->status));
+        if (room->status[0] == '\0') strcpy(room->status, "waiting");
+        room->players = db_col_int(st, 4);
+        db_col_text(st, 5, room->mode, sizeof(room->mode));
+        if (room->mode[0] == '\0') strcpy(room->mode, "othello");
+        room->user1_id = db_col_int(st, 6);
+        room->user2_id = db_col_int(st, 7);
+        long long last_ts = db_col_int64(st, 8);
+        room->last_activity = last_ts > 0 ? (time_t)last_ts : time(NULL);
+        rooms_arm_expiry(room);
+        rooms_unlock(room_id);
+    }
+}
+
+/* Write-behind: mirrors every queued room into the games table in one transaction.
+   A queued id without a resident record means the room was dropped. */
+static void flush_rooms(const int *ids, int n) {
+    room_record snap[ROOM_FLUSH_BATCH];
+    int present[ROOM_FLUSH_BATCH];
+
+    for (int i = 0; i < n; i++) {
+        rooms_lock(ids[i]);
+        room_record *room = rooms_lookup(ids[i]);
+        present[i] = room != NULL;
+        if (room) {
+            snap[i] = *room;
+            room->queued = 0;
+        }
+        rooms_unlock(ids[i]);
+    }
+
+    cev_lock_acquire(&games_lock);
+    db_stmt_exec(db_stmt_get(STMT_BEGIN));
+    for (int i = 0; i < n; i++) {
+        if (present[i]) {
+            uint8_t blob[BITBOARD_BYTES];
+            bitboard_pack(&snap[i].board, blob);
+            sqlite3_stmt *st = db_stmt_get(STMT_GAME_UPSERT);
+            db_stmt_bind(st, "ibisitiil",
+                         snap[i].room_id, blob, BITBOARD_BYTES, snap[i].turn, snap[i].status, snap[i].players,
+                         snap[i].mode, snap[i].user1_id, snap[i].user2_id, (long long)snap[i].last_activity);
+            db_stmt_exec(st);
+        } else {
+            sqlite3_stmt *st = db_stmt_get(STMT_GAME_DELETE);
+            db_stmt_bind(st, "i", ids[i]);
+            db_stmt_exec(st);
+        }
+    }
+    db_stmt_exec(db_stmt_get(STMT_COMMIT));
+    cev_lock_release(&games_lock);
+}
+
+static void *room_flusher_thread(void *arg) {
+    (void)arg;
+    int ids[ROOM_FLUSH_BATCH];
+    while (1) {
+        int n = rooms_take_dirty(ids, ROOM_FLUSH_BATCH, ROOM_FLUSH_IDLE_MS);
+        if (n > 0) flush_rooms(ids, n);
+    }
+    return NULL;
+}
+
 /* Initializes the database schema. Creates 'games' and 'users' tables if they don't exist.
    Also includes rudimentary migrations for adding user-related columns to older DBs. */
 void init_db(cwist_db *db) {
-    pthread_mutex_lock(&db_mutex);
-    cwist_db_exec(db, "CREATE TABLE IF NOT EXISTS games (room_id INTEGER PRIMARY KEY, board TEXT, turn INTEGER, status TEXT, players INTEGER, mode TEXT, user1_id INTEGER DEFAULT 0, user2_id INTEGER DEFAULT 0, session_type TEXT DEFAULT 'multiplayer', last_activity DATETIME DEFAULT CURRENT_TIMESTAMP);");
+    lock_all_domains();
+    db_conn = db;
+    cwist_db_exec(db, "CREATE TABLE IF NOT EXISTS games (room_id INTEGER PRIMARY KEY, board BLOB, turn INTEGER, status TEXT, players INTEGER, mode TEXT, user1_id INTEGER DEFAULT 0, user2_id INTEGER DEFAULT 0, session_type TEXT DEFAULT 'multiplayer', last_activity DATETIME DEFAULT CURRENT_TIMESTAMP);");
     cwist_db_exec(db, "CREATE TABLE IF NOT EXISTS users (id INTEGER PRIMARY KEY AUTOINCREMENT, username TEXT UNIQUE, password_hash TEXT, wins INTEGER DEFAULT 0, losses INTEGER DEFAULT 0, ties INTEGER DEFAULT 0);");
     cwist_db_exec(db, "CREATE TABLE IF NOT EXISTS single_sessions (id INTEGER PRIMARY KEY AUTOINCREMENT, identity TEXT NOT NULL, mode TEXT, difficulty TEXT, room_id INTEGER DEFAULT 0, created_at DATETIME DEFAULT CURRENT_TIMESTAMP);");
     cwist_db_exec(db, "CREATE TABLE IF NOT EXISTS multi_sessions (id INTEGER PRIMARY KEY AUTOINCREMENT, identity TEXT NOT NULL, mode TEXT, room_id INTEGER DEFAULT 0, created_at DATETIME DEFAULT CURRENT_TIMESTAMP);");
+    // Each index serves one access pattern and covers the columns that query reads, so the
+    // lookup never touches the table; --explain verifies that every hot statement uses one.
+    cwist_db_exec(db, "CREATE INDEX IF NOT EXISTS idx_users_rankings ON users (wins DESC, username, losses, ties);");
+    cwist_db_exec(db, "CREATE INDEX IF NOT EXISTS idx_single_sessions_identity ON single_sessions (identity, id, mode, difficulty, room_id, created_at);");
+    cwist_db_exec(db, "CREATE INDEX IF NOT EXISTS idx_single_sessions_room ON single_sessions (room_id);");
+    cwist_db_exec(db, "CREATE INDEX IF NOT EXISTS idx_multi_sessions_identity ON multi_sessions (identity, id, mode, room_id, created_at);");
+    cwist_db_exec(db, "CREATE INDEX IF NOT EXISTS idx_multi_sessions_room ON multi_sessions (room_id);");
+    cwist_db_exec(db, "CREATE TABLE IF NOT EXISTS session_totals (identity TEXT NOT NULL, session_type TEXT NOT NULL, mode TEXT NOT NULL, difficulty TEXT NOT NULL, sessions INTEGER NOT NULL, first_at DATETIME, last_at DATETIME, PRIMARY KEY (identity, session_type, mode, difficulty)) WITHOUT ROWID;");
+    cwist_db_exec(db, "CREATE TEMP TABLE IF NOT EXISTS session_compact (id INTEGER PRIMARY KEY);");
     betting_db_ready = ensure_betting_db_attached(db);
     if (betting_db_ready) betting_db_warning_logged = 0;
     if (betting_db_ready) {
         cwist_db_exec(db, "CREATE TABLE IF NOT EXISTS betting.betting_users (identity TEXT PRIMARY KEY, points INTEGER DEFAULT 1000, created_at DATETIME DEFAULT CURRENT_TIMESTAMP, updated_at DATETIME DEFAULT CURRENT_TIMESTAMP);");
         cwist_db_exec(db, "CREATE TABLE IF NOT EXISTS betting.betting_slots (slot_id INTEGER PRIMARY KEY, difficulty TEXT, odds_win REAL, odds_lose REAL, odds_draw REAL, result TEXT, refresh_mark INTEGER, updated_at DATETIME DEFAULT CURRENT_TIMESTAMP);");
         cwist_db_exec(db, "CREATE TABLE IF NOT EXISTS betting.multiplayer_bets (id INTEGER PRIMARY KEY AUTOINCREMENT, room_id INTEGER NOT NULL, identity TEXT NOT NULL, target_player INTEGER NOT NULL, amount INTEGER NOT NULL, settled INTEGER DEFAULT 0, created_at DATETIME DEFAULT CURRENT_TIMESTAMP);");
+        cwist_db_exec(db, "CREATE INDEX IF NOT EXISTS betting.idx_betting_users_rankings ON betting_users (points DESC, updated_at, identity);");
+        // Partial: settled bets drop out, so settlement only walks the open ones.
+        cwist_db_exec(db, "CREATE INDEX IF NOT EXISTS betting.idx_multiplayer_bets_open ON multiplayer_bets (room_id, id, identity, target_player, amount, settled) WHERE settled = 0;");
+        cwist_db_exec(db, "CREATE INDEX IF NOT EXISTS betting.idx_multiplayer_bets_identity ON multiplayer_bets (identity, id, room_id, target_player, amount, settled, created_at);");
+        cwist_db_exec(db, "CREATE INDEX IF NOT EXISTS betting.idx_multiplayer_bets_identity_room ON multiplayer_bets (identity, room_id, id, target_player, amount, settled, created_at);");
     }
     
     // Migrations for existing DBs
@@ -186,451 +437,679 @@ void init_db(cwist_db *db) {
     
     // Trigger: When status becomes 'dropped', delete the row.
     cwist_db_exec(db, "CREATE TRIGGER IF NOT EXISTS drop_game_on_leave AFTER UPDATE ON games WHEN NEW.status = 'dropped' BEGIN DELETE FROM games WHERE room_id = OLD.room_id; END;");
-    
-    pthread_mutex_unlock(&db_mutex);
+
+    // Schema is final from here on; prepare every runtime statement once.
+    int failed = db_stmt_prepare_all(db, betting_db_ready);
+    if (failed > 0) fprintf(stderr, "%d statements failed to prepare\n", failed);
+    if (schema_version(db) < SCHEMA_BOARD_BLOB) migrate_board_blobs(db);
+
+    if (betting_db_ready) {
+        sqlite3_stmt *st = db_stmt_get(STMT_MP_BET_LAST_ID);
+        if (db_stmt_row(st) == 1) last_bet_id = db_col_int64(st, 0);
+        db_stmt_done(st);
+    }
+
+    leaderboard_init(&user_board, DB_RANKINGS_LIMIT, DB_RANKINGS_LIMIT * 2);
+    leaderboard_init(&betting_board, DB_BETTING_RANKINGS_LIMIT, DB_BETTING_RANKINGS_LIMIT * 2);
+
+    rooms_init();
+    load_rooms();
+    unlock_all_domains();
+
+    static int flusher_started = 0;
+    if (!flusher_started) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, room_flusher_thread, NULL) == 0) {
+            pthread_detach(tid);
+            flusher_started = 1;
+        } else {
+            fprintf(stderr, "Failed to start room flusher thread\n");
+        }
+    }
+
+    pthread_mutex_lock(&settle_mutex);
+    if (!settler_running) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, settler_thread, NULL) == 0) {
+            pthread_detach(tid);
+            settler_running = 1;
+        } else {
+            fprintf(stderr, "Failed to start bet settlement thread; settling on request threads\n");
+        }
+    }
+    pthread_mutex_unlock(&settle_mutex);
+}
+
+/* Runs with no room stripe held, so taking sessions_lock here keeps the lock order. */
+static void drop_room_sessions(int room_id) {
+    cev_lock_acquire(&sessions_lock);
+    sqlite3_stmt *st = db_stmt_get(STMT_SESSION_MULTI_DELETE_ROOM);
+    db_stmt_bind(st, "i", room_id);
+    db_stmt_exec(st);
+    cev_lock_release(&sessions_lock);
 }
 
 void cleanup_stale_rooms(cwist_db *db) {
-    pthread_mutex_lock(&db_mutex);
-    // Mark as timed_out after 10 minutes
-    cwist_db_exec(db, "UPDATE games SET status = 'timed_out' WHERE last_activity < datetime('now', '-10 minutes') AND status != 'timed_out';");
-    // Delete after 11 minutes
-    cwist_db_exec(db, "DELETE FROM games WHERE last_activity < datetime('now', '-11 minutes');");
-    pthread_mutex_unlock(&db_mutex);
-}
-
-static void serialize_board(int board[SIZE][SIZE], char *out) {
-    out[0] = '\0';
-    char buf[16];
-    for (int r=0; r<SIZE; r++) {
-        for (int c=0; c<SIZE; c++) {
-            sprintf(buf, "%d,", board[r][c]);
-            strcat(out, buf);
+    (void)db;
+    // Times out rooms idle for ROOMS_IDLE_TIMEOUT and drops them at ROOMS_IDLE_DROP
+    rooms_expire_due(time(NULL), drop_room_sessions);
+}
+
+static void fill_new_room(room_record *room, const char *requested_mode) {
+    if (requested_mode && strcmp(requested_mode, "reversi") == 0) {
+        strcpy(room->mode, "reversi");
+        bitboard_init(&room->board, 0);
+    } else {
+        strcpy(room->mode, "othello");
+        bitboard_init(&room->board, 1);
+    }
+    room->turn = BLACK;
+    room->players = 0;
+    strcpy(room->status, "waiting");
+    room->last_activity = time(NULL);
+}
+
+void get_game_state(cwist_db *db, int room_id, bitboard *board, int *turn, char *status, int *players, char *mode, const char *requested_mode) {
+    (void)db;
+    rooms_lock(room_id);
+    room_record *room = rooms_lookup(room_id);
+    room_record fresh;
+    if (!room) {
+        if (requested_mode) {
+            room = rooms_create(room_id);
+            if (room) {
+                fill_new_room(room, requested_mode);
+                rooms_mark_dirty(room);
+            }
+        }
+        if (!room) {
+            memset(&fresh, 0, sizeof(fresh));
+            fill_new_room(&fresh, requested_mode);
+            room = &fresh;
         }
     }
-    if(strlen(out) > 0) out[strlen(out)-1] = '\0';
+    *board = room->board;
+    *turn = room->turn;
+    *players = room->players;
+    strcpy(status, room->status);
+    strcpy(mode, room->mode);
+    rooms_unlock(room_id);
 }
 
-static void deserialize_board(const char *in, int board[SIZE][SIZE]) {
-    if (!in) return;
-    char *dup = cev_mem_strdup(in);
-    if (!dup) return;
-    char *token = strtok(dup, ",");
-    int r=0, c=0;
-    while (token) {
-        board[r][c] = atoi(token);
-        c++;
-        if (c >= SIZE) { c=0; r++; }
-        token = strtok(NULL, ",");
+void update_game_state(cwist_db *db, int room_id, const bitboard *board, int turn, const char *status, int players, const char *mode) {
+    (void)db;
+    rooms_lock(room_id);
+    room_record *room = rooms_lookup(room_id);
+    if (room) {
+        room->board = *board;
+        room->turn = turn;
+        room->players = players;
+        copy_field(room->status, sizeof(room->status), status);
+        copy_field(room->mode, sizeof(room->mode), mode);
+        room->last_activity = time(NULL);
+        rooms_mark_dirty(room);
+        rooms_publish(room);
     }
-    cev_mem_free(dup);
+    rooms_unlock(room_id);
 }
 
-void get_game_state(cwist_db *db, int room_id, int board[SIZE][SIZE], int *turn, char *status, int *players, char *mode, const char *requested_mode) {
-    char sql[256];
-    snprintf(sql, sizeof(sql), "SELECT board, turn, status, players, mode FROM games WHERE room_id = %d AND session_type='multiplayer';", room_id);
-    
-    pthread_mutex_lock(&db_mutex);
-    cJSON *res = NULL;
-    cwist_db_query(db, sql, &res);
-    
-    if (cJSON_GetArraySize(res) == 0) {
-        memset(board, 0, sizeof(int)*SIZE*SIZE);
-        if (requested_mode && strcmp(requested_mode, "reversi") == 0) {
-             strcpy(mode, "reversi");
-        } else {
-             strcpy(mode, "othello");
-             board[3][3] = WHITE; board[3][4] = BLACK;
-             board[4][3] = BLACK; board[4][4] = WHITE;
-        }
-        *turn = BLACK;
-        strcpy(status, "waiting");
-        *players = 0;
-        if (requested_mode) {
-            char board_str[1024];
-            serialize_board(board, board_str);
-            char insert[2048];
-            snprintf(insert, sizeof(insert), 
-                "INSERT INTO games (room_id, board, turn, status, players, mode, user1_id, user2_id, session_type, last_activity) VALUES (%d, '%s', %d, '%s', %d, '%s', 0, 0, 'multiplayer', CURRENT_TIMESTAMP);",
-                room_id, board_str, *turn, status, *players, mode);
-            cwist_db_exec(db, insert);
+void db_touch_room(cwist_db *db, int room_id) {
+    (void)db;
+    time_t now = time(NULL);
+    rooms_lock(room_id);
+    room_record *room = rooms_lookup(room_id);
+    // The timer re-arms itself from last_activity when it fires, so the wheel is not touched.
+    if (room && room->last_activity < now && strcmp(room->status, "timed_out") != 0) room->last_activity = now;
+    rooms_unlock(room_id);
+}
+
+uint64_t db_wait_game_state(cwist_db *db, int room_id, uint64_t since, int timeout_ms) {
+    (void)db;
+    return rooms_wait_version(room_id, since, timeout_ms);
+}
+
+void db_set_room_watcher(void (*watcher)(int room_id)) {
+    rooms_set_watch_hook(watcher);
+}
+
+uint64_t db_rooms_version(void) {
+    return rooms_generation();
+}
+
+int db_get_room_view(cwist_db *db, int room_id, db_room_view *out) {
+    (void)db;
+    rooms_lock(room_id);
+    room_record *room = rooms_lookup(room_id);
+    int found = room != NULL;
+    room_record fresh;
+    if (!found) {
+        memset(&fresh, 0, sizeof(fresh));
+        fill_new_room(&fresh, NULL);
+        room = &fresh;
+    }
+    out->version = room->version;
+    out->board = room->board;
+    out->turn = room->turn;
+    out->players = room->players;
+    strcpy(out->status, room->status);
+    strcpy(out->mode, room->mode);
+    rooms_unlock(room_id);
+    return found ? 0 : -1;
+}
+
+int db_play_move(cwist_db *db, int room_id, int player, int r, int c, db_move_result *out) {
+    rooms_lock(room_id);
+    room_record *room = rooms_lookup(room_id);
+    if (!room || strcmp(room->status, "active") != 0 || player != room->turn) {
+        rooms_unlock(room_id);
+        return DB_MOVE_REJECTED;
+    }
+
+    bitboard *board = &room->board;
+    int opponent = BITBOARD_OPPONENT(player);
+    int is_reversi_setup = strcmp(room->mode, "reversi") == 0 && bitboard_count_all(board) < 4;
+    uint64_t flips = 0;
+    if (is_reversi_setup) {
+        if (r < 3 || r > 4 || c < 3 || c > 4 || bitboard_get(board, r, c) != 0) {
+            rooms_unlock(room_id);
+            return DB_MOVE_ILLEGAL;
         }
-    } else {
-        cJSON *row = cJSON_GetArrayItem(res, 0);
-        cJSON *b = cJSON_GetObjectItem(row, "board");
-        memset(board, 0, sizeof(int)*SIZE*SIZE);
-        if(b && b->valuestring) deserialize_board(b->valuestring, board);
-        
-        cJSON *t = cJSON_GetObjectItem(row, "turn");
-        if (t) {
-            if (t->valuestring) *turn = atoi(t->valuestring);
-            else if (cJSON_IsNumber(t)) *turn = t->valueint;
-            else *turn = BLACK;
-        } else *turn = BLACK;
-
-        cJSON *s = cJSON_GetObjectItem(row, "status");
-        if(s && s->valuestring) strcpy(status, s->valuestring);
-        else strcpy(status, "waiting");
-
-        cJSON *p = cJSON_GetObjectItem(row, "players");
-        if (p) {
-            if (p->valuestring) *players = atoi(p->valuestring);
-            else if (cJSON_IsNumber(p)) *players = p->valueint;
-            else *players = 0;
-        } else *players = 0;
-
-        cJSON *m = cJSON_GetObjectItem(row, "mode");
-        if(m && m->valuestring) strcpy(mode, m->valuestring);
-        else strcpy(mode, "othello");
-    }
-    cJSON_Delete(res);
-    pthread_mutex_unlock(&db_mutex);
-}
-
-void update_game_state(cwist_db *db, int room_id, int board[SIZE][SIZE], int turn, const char *status, int players, const char *mode) {
-    char board_str[1024];
-    serialize_board(board, board_str);
-    char sql[2048];
-    snprintf(sql, sizeof(sql), 
-        "UPDATE games SET board='%s', turn=%d, status='%s', players=%d, mode='%s', last_activity=CURRENT_TIMESTAMP WHERE room_id=%d AND session_type='multiplayer';",
-        board_str, turn, status, players, mode, room_id);
-    pthread_mutex_lock(&db_mutex);
-    cwist_db_exec(db, sql);
-    pthread_mutex_unlock(&db_mutex);
+        bitboard_set(board, r, c, player);
+    } else if (r < 0 || r >= SIZE || c < 0 || c >= SIZE ||
+               !(flips = bitboard_apply_move(board, player, BITBOARD_SQ(r, c)))) {
+        rooms_unlock(room_id);
+        return DB_MOVE_ILLEGAL;
+    }
+
+    int finished = 0;
+    int winner = 0;
+    if (is_reversi_setup && bitboard_count_all(board) < 4) {
+        room->turn = opponent;
+    } else if (bitboard_has_moves(board, opponent)) {
+        room->turn = opponent;
+    } else if (!bitboard_has_moves(board, player)) {
+        strcpy(room->status, "finished");
+        int b_cnt = bitboard_count(board, BLACK);
+        int w_cnt = bitboard_count(board, WHITE);
+        winner = (b_cnt > w_cnt) ? 1 : (w_cnt > b_cnt ? 2 : 0);
+        finished = 1;
+    }
+    room->last_activity = time(NULL);
+    rooms_mark_dirty(room);
+    rooms_publish(room);
+    if (out) {
+        out->square = BITBOARD_SQ(r, c);
+        out->flips = flips;
+        out->turn = room->turn;
+        out->winner_player = winner;
+        out->version = room->version;
+        strcpy(out->status, room->status);
+    }
+    rooms_unlock(room_id);
+
+    // Domain locks come after the stripe is released.
+    if (finished) {
+        db_record_result(db, room_id, winner);
+        db_queue_bet_settlement(room_id, winner);
+    }
+    return DB_MOVE_OK;
 }
 
 int db_join_game(cwist_db *db, int room_id, const char *requested_mode, int *player_id, char *mode, int user_id) {
-    pthread_mutex_lock(&db_mutex);
-    char sql[256];
-    snprintf(sql, sizeof(sql), "SELECT board, turn, status, players, mode, user1_id, user2_id FROM games WHERE room_id = %d AND session_type='multiplayer';", room_id);
-    cJSON *res = NULL;
-    cwist_db_query(db, sql, &res);
-    
-    if (cJSON_GetArraySize(res) == 0) {
-        int board[SIZE][SIZE];
-        memset(board, 0, sizeof(int)*SIZE*SIZE);
-        if (requested_mode && strcmp(requested_mode, "reversi") == 0) strcpy(mode, "reversi");
-        else {
-             strcpy(mode, "othello");
-             board[3][3] = WHITE; board[3][4] = BLACK;
-             board[4][3] = BLACK; board[4][4] = WHITE;
+    (void)db;
+    rooms_lock(room_id);
+    room_record *room = rooms_lookup(room_id);
+
+    if (!room) {
+        room = rooms_create(room_id);
+        if (!room) {
+            rooms_unlock(room_id);
+            return -1;
         }
-        int turn = BLACK;
-        const char *status = "waiting";
-        int players = 1;
+        fill_new_room(room, requested_mode);
+        room->players = 1;
+        room->user1_id = user_id;
         *player_id = 1;
-        char board_str[1024];
-        serialize_board(board, board_str);
-        char insert[2048];
-        snprintf(insert, sizeof(insert), 
-            "INSERT INTO games (room_id, board, turn, status, players, mode, user1_id, user2_id, session_type, last_activity) VALUES (%d, '%s', %d, '%s', %d, '%s', %d, 0, 'multiplayer', CURRENT_TIMESTAMP);",
-            room_id, board_str, turn, status, players, mode, user_id);
-        cwist_db_exec(db, insert);
-    } else {
-        cJSON *row = cJSON_GetArrayItem(res, 0);
-        cJSON *p = cJSON_GetObjectItem(row, "players");
-        int current_players = 0;
-        if (p) {
-            if (p->valuestring) current_players = atoi(p->valuestring);
-            else if (cJSON_IsNumber(p)) current_players = p->valueint;
-        }
-        int user1_id = 0;
-        int user2_id = 0;
-        cJSON *u1 = cJSON_GetObjectItem(row, "user1_id");
-        cJSON *u2 = cJSON_GetObjectItem(row, "user2_id");
-        if (u1) {
-            if (u1->valuestring) user1_id = atoi(u1->valuestring);
-            else if (cJSON_IsNumber(u1)) user1_id = u1->valueint;
-        }
-        if (u2) {
-            if (u2->valuestring) user2_id = atoi(u2->valuestring);
-            else if (cJSON_IsNumber(u2)) user2_id = u2->valueint;
-        }
-        if (user_id > 0 && user_id == user1_id) {
-            *player_id = 1;
-            cJSON *m = cJSON_GetObjectItem(row, "mode");
-            if(m && m->valuestring) strcpy(mode, m->valuestring);
-            else strcpy(mode, "othello");
-            char touch[128];
-            snprintf(touch, sizeof(touch), "UPDATE games SET last_activity=CURRENT_TIMESTAMP WHERE room_id=%d AND session_type='multiplayer';", room_id);
-            cwist_db_exec(db, touch);
-            cJSON_Delete(res);
-            pthread_mutex_unlock(&db_mutex);
-            return 0;
-        }
-        if (user_id > 0 && user_id == user2_id) {
-            *player_id = 2;
-            cJSON *m = cJSON_GetObjectItem(row, "mode");
-            if(m && m->valuestring) strcpy(mode, m->valuestring);
-            else strcpy(mode, "othello");
-            char touch[128];
-            snprintf(touch, sizeof(touch), "UPDATE games SET last_activity=CURRENT_TIMESTAMP WHERE room_id=%d AND session_type='multiplayer';", room_id);
-            cwist_db_exec(db, touch);
-            cJSON_Delete(res);
-            pthread_mutex_unlock(&db_mutex);
-            return 0;
-        }
-        if (current_players >= 2) {
-            cJSON_Delete(res);
-            pthread_mutex_unlock(&db_mutex);
+        strcpy(mode, room->mode);
+        rooms_mark_dirty(room);
+        rooms_unlock(room_id);
+        return 0;
+    }
+
+    strcpy(mode, room->mode);
+    if (user_id > 0 && (user_id == room->user1_id || user_id == room->user2_id)) {
+        *player_id = (user_id == room->user1_id) ? 1 : 2;
+        room->last_activity = time(NULL);
+        rooms_mark_dirty(room);
+        rooms_publish(room);
+        rooms_unlock(room_id);
+        return 0;
+    }
+    if (room->players >= 2) {
+        rooms_unlock(room_id);
+        return -1;
+    }
+    int assigned_slot = 0;
+    if (user_id > 0) {
+        if (room->user1_id == 0) assigned_slot = 1;
+        else if (room->user2_id == 0) assigned_slot = 2;
+        else {
+            rooms_unlock(room_id);
             return -1;
         }
-        int assigned_slot = 0;
-        if (user_id > 0) {
-            if (user1_id == 0) assigned_slot = 1;
-            else if (user2_id == 0) assigned_slot = 2;
-            else {
-                cJSON_Delete(res);
-                pthread_mutex_unlock(&db_mutex);
-                return -1;
-            }
-        } else {
-            assigned_slot = current_players + 1;
-        }
-        current_players++;
-        *player_id = assigned_slot;
-        cJSON *m = cJSON_GetObjectItem(row, "mode");
-        if(m && m->valuestring) strcpy(mode, m->valuestring);
-        else strcpy(mode, "othello");
-        int new_players = current_players;
-        if (user_id > 0) {
-            int filled = (user1_id != 0) + (user2_id != 0);
-            if (assigned_slot == 1 && user1_id == 0) filled++;
-            if (assigned_slot == 2 && user2_id == 0) filled++;
-            new_players = filled;
-        }
-        const char *new_status = (new_players == 2) ? "active" : "waiting";
-        char update[256];
-        if (user_id > 0) {
-            snprintf(update, sizeof(update), "UPDATE games SET players=%d, status='%s', user%d_id=%d, last_activity=CURRENT_TIMESTAMP WHERE room_id=%d AND session_type='multiplayer';", 
-                    new_players, new_status, assigned_slot, user_id, room_id);
-        } else {
-            snprintf(update, sizeof(update), "UPDATE games SET players=%d, status='%s', last_activity=CURRENT_TIMESTAMP WHERE room_id=%d AND session_type='multiplayer';", 
-                    new_players, new_status, room_id);
-        }
-        cwist_db_exec(db, update);
+    } else {
+        assigned_slot = room->players + 1;
+    }
+    *player_id = assigned_slot;
+    int new_players = room->players + 1;
+    if (user_id > 0) {
+        int filled = (room->user1_id != 0) + (room->user2_id != 0) + 1;
+        new_players = filled;
+        if (assigned_slot == 1) room->user1_id = user_id;
+        else room->user2_id = user_id;
     }
-    cJSON_Delete(res);
-    pthread_mutex_unlock(&db_mutex);
+    room->players = new_players;
+    strcpy(room->status, (new_players == 2) ? "active" : "waiting");
+    room->last_activity = time(NULL);
+    rooms_mark_dirty(room);
+    rooms_publish(room);
+    rooms_unlock(room_id);
     return 0;
 }
 
 void db_leave_game(cwist_db *db, int room_id, int player_id, int user_id) {
-    pthread_mutex_lock(&db_mutex);
-    char sql[512];
-    
-    // 1. Immediately drop the game from 'games' table
-    snprintf(sql, sizeof(sql), "DELETE FROM games WHERE room_id = %d;", room_id);
-    cwist_db_exec(db, sql);
+    (void)db;
+    (void)player_id;
+    (void)user_id;
+
+    // 1. Immediately drop the room; the flusher deletes the 'games' row
+    rooms_lock(room_id);
+    rooms_delete(room_id);
+    rooms_unlock(room_id);
 
     // 2. Immediately cleanup sessions from BOTH tables for this room
-    snprintf(sql, sizeof(sql), "DELETE FROM multi_sessions WHERE room_id = %d;", room_id);
-    cwist_db_exec(db, sql);
-    snprintf(sql, sizeof(sql), "DELETE FROM single_sessions WHERE room_id = %d;", room_id);
-    cwist_db_exec(db, sql);
-    
-    pthread_mutex_unlock(&db_mutex);
+    cev_lock_acquire(&sessions_lock);
+    sqlite3_stmt *st = db_stmt_get(STMT_SESSION_MULTI_DELETE_ROOM);
+    db_stmt_bind(st, "i", room_id);
+    db_stmt_exec(st);
+    st = db_stmt_get(STMT_SESSION_SINGLE_DELETE_ROOM);
+    db_stmt_bind(st, "i", room_id);
+    db_stmt_exec(st);
+    cev_lock_release(&sessions_lock);
 }
 
 void db_reset_room(cwist_db *db, int room_id) {
-    char sql[256];
-    // Trigger the drop via UPDATE status
-    snprintf(sql, sizeof(sql), "UPDATE games SET status = 'dropped' WHERE room_id = %d AND session_type='multiplayer';", room_id);
-    pthread_mutex_lock(&db_mutex);
-    cwist_db_exec(db, sql);
-    pthread_mutex_unlock(&db_mutex);
+    (void)db;
+    rooms_lock(room_id);
+    rooms_delete(room_id);
+    rooms_unlock(room_id);
+}
+
+static void user_board_row(const db_user_stats *stats, leaderboard_row *row) {
+    memset(row, 0, sizeof(*row));
+    copy_field(row->name, sizeof(row->name), stats->username);
+    row->score = stats->wins;
+    row->extra[0] = stats->losses;
+    row->extra[1] = stats->ties;
+}
+
+static void read_user_stats(sqlite3_stmt *st, db_user_stats *out) {
+    db_col_text(st, 0, out->username, sizeof(out->username));
+    out->wins = db_col_int(st, 1);
+    out->losses = db_col_int(st, 2);
+    out->ties = db_col_int(st, 3);
+}
+
+static void add_user_result(int user_id, int wins, int losses, int ties) {
+    if (user_id <= 0) return;
+    sqlite3_stmt *st = db_stmt_get(STMT_USER_ADD_RESULT);
+    db_stmt_bind(st, "iiii", wins, losses, ties, user_id);
+    if (db_stmt_row(st) == 1) {
+        db_user_stats stats;
+        leaderboard_row row;
+        read_user_stats(st, &stats);
+        user_board_row(&stats, &row);
+        leaderboard_update(&user_board, &row);
+    }
+    db_stmt_done(st);
 }
 
 /* Records game results (wins, losses, ties) for authenticated users.
    Called when a game transitions to the 'finished' state. */
 void db_record_result(cwist_db *db, int room_id, int winner_pid) {
-    pthread_mutex_lock(&db_mutex);
-    char sql[256];
-    snprintf(sql, sizeof(sql), "SELECT user1_id, user2_id FROM games WHERE room_id = %d AND session_type='multiplayer';", room_id);
-    cJSON *res = NULL;
-    cwist_db_query(db, sql, &res);
-    if (cJSON_GetArraySize(res) > 0) {
-        cJSON *row = cJSON_GetArrayItem(res, 0);
-        int u1 = cJSON_GetObjectItem(row, "user1_id")->valueint;
-        int u2 = cJSON_GetObjectItem(row, "user2_id")->valueint;
-        
-        char update1[256], update2[256];
-        if (winner_pid == 0) { // Tie
-            if(u1 > 0) { snprintf(update1, sizeof(update1), "UPDATE users SET ties = ties + 1 WHERE id = %d;", u1); cwist_db_exec(db, update1); }
-            if(u2 > 0) { snprintf(update2, sizeof(update2), "UPDATE users SET ties = ties + 1 WHERE id = %d;", u2); cwist_db_exec(db, update2); }
-        } else if (winner_pid == 1) { // Black wins
-            if(u1 > 0) { snprintf(update1, sizeof(update1), "UPDATE users SET wins = wins + 1 WHERE id = %d;", u1); cwist_db_exec(db, update1); }
-            if(u2 > 0) { snprintf(update2, sizeof(update2), "UPDATE users SET losses = losses + 1 WHERE id = %d;", u2); cwist_db_exec(db, update2); }
-        } else if (winner_pid == 2) { // White wins
-            if(u1 > 0) { snprintf(update1, sizeof(update1), "UPDATE users SET losses = losses + 1 WHERE id = %d;", u1); cwist_db_exec(db, update1); }
-            if(u2 > 0) { snprintf(update2, sizeof(update2), "UPDATE users SET wins = wins + 1 WHERE id = %d;", u2); cwist_db_exec(db, update2); }
-        }
+    (void)db;
+    int u1 = 0;
+    int u2 = 0;
+    rooms_lock(room_id);
+    room_record *room = rooms_lookup(room_id);
+    if (room) {
+        u1 = room->user1_id;
+        u2 = room->user2_id;
     }
-    cJSON_Delete(res);
-    pthread_mutex_unlock(&db_mutex);
+    rooms_unlock(room_id);
+    if (!room) return;
+
+    cev_lock_acquire(&users_lock);
+    if (winner_pid == 0) { // Tie
+        add_user_result(u1, 0, 0, 1);
+        add_user_result(u2, 0, 0, 1);
+    } else if (winner_pid == 1) { // Black wins
+        add_user_result(u1, 1, 0, 0);
+        add_user_result(u2, 0, 1, 0);
+    } else if (winner_pid == 2) { // White wins
+        add_user_result(u1, 0, 1, 0);
+        add_user_result(u2, 1, 0, 0);
+    }
+    cev_lock_release(&users_lock);
 }
 
 /* Registers a new user with a hashed password. */
 int db_register_user(cwist_db *db, const char *username, const char *password_hash) {
-    char sql[512];
-    snprintf(sql, sizeof(sql), "INSERT INTO users (username, password_hash) VALUES ('%s', '%s');", username, password_hash);
-    pthread_mutex_lock(&db_mutex);
-    cwist_error_t err = cwist_db_exec(db, sql);
-    pthread_mutex_unlock(&db_mutex);
-    return err.error.err_i16;
+    (void)db;
+    cev_lock_acquire(&users_lock);
+    sqlite3_stmt *st = db_stmt_get(STMT_USER_REGISTER);
+    db_stmt_bind(st, "tt", username, password_hash);
+    int rc = db_stmt_exec(st);
+    if (rc == SQLITE_OK) {
+        db_user_stats stats = { .wins = 0 };
+        leaderboard_row row;
+        copy_field(stats.username, sizeof(stats.username), username);
+        user_board_row(&stats, &row);
+        leaderboard_update(&user_board, &row);
+    }
+    cev_lock_release(&users_lock);
+    return rc;
 }
 
 /* Validates user credentials and returns user ID if successful. */
 int db_login_user(cwist_db *db, const char *username, const char *password_hash) {
-    char sql[512];
-    snprintf(sql, sizeof(sql), "SELECT id FROM users WHERE username = '%s' AND password_hash = '%s';", username, password_hash);
-    pthread_mutex_lock(&db_mutex);
-    cJSON *res = NULL;
-    cwist_db_query(db, sql, &res);
+    (void)db;
     int id = -1;
-    if (res && cJSON_GetArraySize(res) > 0) {
-        cJSON *row = cJSON_GetArrayItem(res, 0);
-        cJSON *id_item = cJSON_GetObjectItem(row, "id");
-        if (id_item) {
-            if (cJSON_IsNumber(id_item)) id = id_item->valueint;
-            else if (id_item->valuestring) id = atoi(id_item->valuestring);
-        }
-    }
-    cJSON_Delete(res);
-    pthread_mutex_unlock(&db_mutex);
+    cev_lock_acquire(&users_lock);
+    sqlite3_stmt *st = db_stmt_get(STMT_USER_LOGIN);
+    db_stmt_bind(st, "tt", username, password_hash);
+    if (db_stmt_row(st) == 1) id = db_col_int(st, 0);
+    db_stmt_done(st);
+    cev_lock_release(&users_lock);
     return id;
 }
 
-cJSON *db_get_rankings(cwist_db *db) {
-    pthread_mutex_lock(&db_mutex);
-    cJSON *res = NULL;
-    cwist_db_query(db, "SELECT username, wins, losses, ties FROM users ORDER BY wins DESC LIMIT 10;", &res);
-    pthread_mutex_unlock(&db_mutex);
-    if (!res) return cJSON_CreateArray();
-    return res;
-}
-
-cJSON *db_get_user_info(cwist_db *db, int user_id) {
-    char sql[256];
-    snprintf(sql, sizeof(sql), "SELECT username, wins, losses, ties FROM users WHERE id = %d;", user_id);
-    pthread_mutex_lock(&db_mutex);
-    cJSON *res = NULL;
-    cwist_db_query(db, sql, &res);
-    pthread_mutex_unlock(&db_mutex);
-    if (res && cJSON_GetArraySize(res) > 0) {
-        cJSON *row = cJSON_DetachItemFromArray(res, 0);
-        cJSON_Delete(res);
-        return row;
-    }
-    if (res) cJSON_Delete(res);
-    return NULL;
+static void reload_user_board(void) {
+    leaderboard_row loaded[LEADERBOARD_ROWS_MAX];
+    int n = 0;
+    sqlite3_stmt *st = db_stmt_get(STMT_USER_RANKINGS);
+    db_stmt_bind(st, "i", user_board.cap);
+    while (n < user_board.cap && db_stmt_row(st) == 1) {
+        db_user_stats stats;
+        read_user_stats(st, &stats);
+        user_board_row(&stats, &loaded[n++]);
+    }
+    db_stmt_done(st);
+    leaderboard_reload(&user_board, loaded, n);
+}
+
+int db_get_rankings(cwist_db *db, db_user_stats *rows, int max, uint64_t *version) {
+    (void)db;
+    leaderboard_row top[LEADERBOARD_ROWS_MAX];
+    if (max > LEADERBOARD_ROWS_MAX) max = LEADERBOARD_ROWS_MAX;
+    cev_lock_acquire(&users_lock);
+    if (user_board.stale) reload_user_board();
+    int n = leaderboard_copy(&user_board, top, max);
+    if (version) *version = leaderboard_version(&user_board);
+    cev_lock_release(&users_lock);
+    for (int i = 0; i < n; i++) {
+        copy_field(rows[i].username, sizeof(rows[i].username), top[i].name);
+        rows[i].wins = (int)top[i].score;
+        rows[i].losses = top[i].extra[0];
+        rows[i].ties = top[i].extra[1];
+    }
+    return n;
 }
 
-cJSON *db_get_multiplayer_rooms(cwist_db *db) {
-    pthread_mutex_lock(&db_mutex);
-    cJSON *res = NULL;
-    cwist_db_query(db, "SELECT room_id, mode, status, players, last_activity FROM games WHERE session_type='multiplayer' ORDER BY room_id ASC LIMIT 50;", &res);
-    pthread_mutex_unlock(&db_mutex);
-    if (!res) return cJSON_CreateArray();
-    return res;
+uint64_t db_rankings_version(void) {
+    return leaderboard_version(&user_board);
+}
+
+int db_get_user_info(cwist_db *db, int user_id, db_user_stats *out) {
+    (void)db;
+    int rc = -1;
+    cev_lock_acquire(&users_lock);
+    sqlite3_stmt *st = db_stmt_get(STMT_USER_INFO);
+    db_stmt_bind(st, "i", user_id);
+    if (db_stmt_row(st) == 1) {
+        read_user_stats(st, out);
+        rc = 0;
+    }
+    db_stmt_done(st);
+    cev_lock_release(&users_lock);
+    return rc;
+}
+
+int db_get_multiplayer_rooms(cwist_db *db, db_room_summary *rows, int max) {
+    (void)db;
+    if (max > DB_ROOM_LIST_LIMIT) max = DB_ROOM_LIST_LIMIT;
+    room_summary rooms[DB_ROOM_LIST_LIMIT];
+    int n = rooms_snapshot(rooms, max);
+    for (int i = 0; i < n; i++) {
+        rows[i].room_id = rooms[i].room_id;
+        rows[i].players = rooms[i].players;
+        rows[i].last_activity = rooms[i].last_activity;
+        copy_field(rows[i].mode, sizeof(rows[i].mode), rooms[i].mode);
+        copy_field(rows[i].status, sizeof(rows[i].status), rooms[i].status);
+    }
+    return n;
 }
 
 int db_log_game_session(cwist_db *db, const char *identity, const char *session_type, const char *mode, const char *difficulty, int room_id) {
+    (void)db;
     if (!identity || !session_type || strlen(identity) == 0 || strlen(session_type) == 0) return -1;
     const char *safe_mode = (mode && strlen(mode) > 0) ? mode : "othello";
     const char *safe_difficulty = (difficulty && strlen(difficulty) > 0) ? difficulty : "";
-    char esc_identity[256];
-    char esc_mode[64];
-    char esc_difficulty[64];
-    sql_escape(identity, esc_identity, sizeof(esc_identity));
-    sql_escape(safe_mode, esc_mode, sizeof(esc_mode));
-    sql_escape(safe_difficulty, esc_difficulty, sizeof(esc_difficulty));
-    char sql[1024];
-
-    pthread_mutex_lock(&db_mutex);
+    int rc;
+
+    cev_lock_acquire(&sessions_lock);
     if (strcmp(session_type, "multiplayer") == 0) {
-        if (room_id > 0) {
-            snprintf(sql, sizeof(sql),
-                     "DELETE FROM multi_sessions WHERE identity='%s' AND room_id=%d;",
-                     esc_identity, room_id);
-            cwist_db_exec(db, sql);
-            snprintf(sql, sizeof(sql),
-                     "INSERT INTO multi_sessions (identity, mode, room_id, created_at) VALUES ('%s', '%s', %d, CURRENT_TIMESTAMP);",
-                     esc_identity, esc_mode, room_id);
-        } else {
-             pthread_mutex_unlock(&db_mutex);
-             return -1;
+        if (room_id <= 0) {
+            cev_lock_release(&sessions_lock);
+            return -1;
         }
+        sqlite3_stmt *st = db_stmt_get(STMT_SESSION_MULTI_DELETE);
+        db_stmt_bind(st, "ti", identity, room_id);
+        db_stmt_exec(st);
+        st = db_stmt_get(STMT_SESSION_MULTI_INSERT);
+        db_stmt_bind(st, "tti", identity, safe_mode, room_id);
+        rc = db_stmt_exec(st);
     } else {
-        snprintf(sql, sizeof(sql),
-                 "INSERT INTO single_sessions (identity, mode, difficulty, room_id, created_at) VALUES ('%s', '%s', '%s', %d, CURRENT_TIMESTAMP);",
-                 esc_identity, esc_mode, esc_difficulty, room_id);
+        sqlite3_stmt *st = db_stmt_get(STMT_SESSION_SINGLE_INSERT);
+        db_stmt_bind(st, "ttti", identity, safe_mode, safe_difficulty, room_id);
+        rc = db_stmt_exec(st);
     }
-    cwist_error_t err = cwist_db_exec(db, sql);
-    pthread_mutex_unlock(&db_mutex);
-    return err.error.err_i16;
+    cev_lock_release(&sessions_lock);
+    return rc;
 }
 
 int db_remove_multiplayer_session(cwist_db *db, const char *identity, int room_id) {
+    (void)db;
     if (!identity || strlen(identity) == 0 || room_id <= 0) return -1;
-    char esc_identity[256];
-    sql_escape(identity, esc_identity, sizeof(esc_identity));
-    char sql[512];
-    snprintf(sql, sizeof(sql),
-             "DELETE FROM multi_sessions WHERE identity='%s' AND room_id=%d;",
-             esc_identity, room_id);
-    pthread_mutex_lock(&db_mutex);
-    cwist_error_t err = cwist_db_exec(db, sql);
-    pthread_mutex_unlock(&db_mutex);
-    return err.error.err_i16;
-}
-
-cJSON *db_get_recent_sessions(cwist_db *db, const char *identity, const char *session_type, int limit) {
-    if (!identity || !session_type || strlen(identity) == 0 || strlen(session_type) == 0) return cJSON_CreateArray();
-    if (limit <= 0) limit = 8;
-    if (limit > 100) limit = 100;
-    char esc_identity[256];
-    sql_escape(identity, esc_identity, sizeof(esc_identity));
-    char sql[1024];
+    cev_lock_acquire(&sessions_lock);
+    sqlite3_stmt *st = db_stmt_get(STMT_SESSION_MULTI_DELETE);
+    db_stmt_bind(st, "ti", identity, room_id);
+    int rc = db_stmt_exec(st);
+    cev_lock_release(&sessions_lock);
+    return rc;
+}
 
-    pthread_mutex_lock(&db_mutex);
-    if (strcmp(session_type, "multiplayer") == 0) {
-        snprintf(sql, sizeof(sql),
-                 "SELECT id, 'multiplayer' as session_type, mode, '' as difficulty, room_id, created_at FROM multi_sessions WHERE identity='%s' ORDER BY id DESC LIMIT %d;",
-                 esc_identity, limit);
-    } else {
-        snprintf(sql, sizeof(sql),
-                 "SELECT id, 'singleplayer' as session_type, mode, difficulty, room_id, created_at FROM single_sessions WHERE identity='%s' ORDER BY id DESC LIMIT %d;",
-                 esc_identity, limit);
+int db_get_session_totals(cwist_db *db, const char *identity, const char *session_type, db_session_total *rows, int max) {
+    (void)db;
+    if (!identity || !session_type || strlen(identity) == 0 || max <= 0) return 0;
+    int n = 0;
+    cev_lock_acquire(&sessions_lock);
+    sqlite3_stmt *st = db_stmt_get(STMT_SESSION_TOTALS);
+    db_stmt_bind(st, "tt", identity, session_type);
+    while (n < max && db_stmt_row(st) == 1) {
+        db_session_total *row = &rows[n++];
+        db_col_text(st, 0, row->mode, sizeof(row->mode));
+        db_col_text(st, 1, row->difficulty, sizeof(row->difficulty));
+        row->sessions = db_col_int(st, 2);
+        db_col_text(st, 3, row->first_at, sizeof(row->first_at));
+        db_col_text(st, 4, row->last_at, sizeof(row->last_at));
     }
-    cJSON *res = NULL;
-    cwist_db_query(db, sql, &res);
-    pthread_mutex_unlock(&db_mutex);
-    if (!res) return cJSON_CreateArray();
-    return res;
+    db_stmt_done(st);
+    cev_lock_release(&sessions_lock);
+    return n;
+}
+
+void db_set_session_retention(int keep_single, int keep_multi) {
+    cev_lock_acquire(&sessions_lock);
+    session_keep_single = keep_single > 0 ? keep_single : 0;
+    session_keep_multi = keep_multi > 0 ? keep_multi : 0;
+    cev_lock_release(&sessions_lock);
+}
+
+/* A session table's compaction statements and how far its identity walk has got. The cursor is
+   the last identity whose surplus is gone ("" starts over); it only moves on commit. */
+typedef struct session_compactor {
+    db_stmt_id next_identity;
+    db_stmt_id pick;
+    db_stmt_id rollup;
+    db_stmt_id purge;
+    char cursor[128];
+} session_compactor;
+
+static session_compactor single_compactor = {
+    STMT_SESSION_SINGLE_NEXT_IDENTITY, STMT_SESSION_SINGLE_PICK_OLD,
+    STMT_SESSION_SINGLE_ROLLUP, STMT_SESSION_SINGLE_PURGE, "",
+};
+static session_compactor multi_compactor = {
+    STMT_SESSION_MULTI_NEXT_IDENTITY, STMT_SESSION_MULTI_PICK_OLD,
+    STMT_SESSION_MULTI_ROLLUP, STMT_SESSION_MULTI_PURGE, "",
+};
+
+/* Rows queued in temp.session_compact, or -1 on error. */
+static int count_session_compact(void) {
+    sqlite3_stmt *st = db_stmt_get(STMT_SESSION_COMPACT_COUNT);
+    int n = db_stmt_row(st) == 1 ? db_col_int(st, 0) : -1;
+    db_stmt_done(st);
+    return n;
+}
+
+/* One batch: steps identity by identity from the cursor through the (identity, id) index and
+   queues each one's rows beyond its newest keep, so the work follows the rows removed rather
+   than the table. Stops after SESSION_COMPACT_BATCH rows or identities; an identity that fills
+   the batch is revisited next time. Returns the rows compacted, or -1 on error (the
+   transaction is rolled back). *wrapped is set once the walk has passed the last identity. */
+static int compact_session_batch(session_compactor *c, int keep, int *wrapped) {
+    char cursor[sizeof(c->cursor)];
+    int failed = 0;
+    int picked = 0;
+    *wrapped = 0;
+    lock_all_domains();
+    memcpy(cursor, c->cursor, sizeof(cursor));
+    sqlite3_stmt *begin = db_stmt_get(STMT_BEGIN);
+    sqlite3 *conn = sqlite3_db_handle(begin);
+    db_stmt_exec(begin);
+    for (int visited = 0; !failed && picked < SESSION_COMPACT_BATCH && visited < SESSION_COMPACT_BATCH; visited++) {
+        char identity[sizeof(cursor)];
+        sqlite3_stmt *st = db_stmt_get(c->next_identity);
+        db_stmt_bind(st, "t", cursor);
+        int step = db_stmt_row(st);
+        if (step == 1) db_col_text(st, 0, identity, sizeof(identity));
+        db_stmt_done(st);
+        if (step != 1) {
+            failed = step < 0;
+            if (!failed) {
+                cursor[0] = '\0';
+                *wrapped = 1;
+            }
+            break;
+        }
+        st = db_stmt_get(c->pick);
+        db_stmt_bind(st, "tii", identity, SESSION_COMPACT_BATCH - picked, keep);
+        failed = db_stmt_exec(st) != SQLITE_OK;
+        if (!failed) {
+            picked = count_session_compact();
+            failed = picked < 0;
+        }
+        if (!failed && picked < SESSION_COMPACT_BATCH) copy_field(cursor, sizeof(cursor), identity);
+    }
+    if (!failed && picked > 0) {
+        failed = db_stmt_exec(db_stmt_get(c->rollup)) != SQLITE_OK ||
+                 db_stmt_exec(db_stmt_get(c->purge)) != SQLITE_OK;
+    }
+    if (failed) fprintf(stderr, "Session compaction failed: %s\n", sqlite3_errmsg(conn));
+    db_stmt_exec(db_stmt_get(STMT_SESSION_COMPACT_CLEAR));
+    db_stmt_exec(db_stmt_get(failed ? STMT_ROLLBACK : STMT_COMMIT));
+    if (!failed) memcpy(c->cursor, cursor, sizeof(cursor));
+    unlock_all_domains();
+    return failed ? -1 : picked;
+}
+
+/* Resumes the table's walk; a pass ends at the batch limit or once it has wrapped around. */
+static int compact_session_table(session_compactor *c, int keep) {
+    if (keep <= 0) return 0;
+    int total = 0;
+    for (int i = 0; i < SESSION_COMPACT_MAX_BATCHES; i++) {
+        int wrapped = 0;
+        int n = compact_session_batch(c, keep, &wrapped);
+        if (n < 0) break;
+        total += n;
+        if (wrapped) break;
+    }
+    return total;
+}
+
+int db_compact_sessions(cwist_db *db) {
+    (void)db;
+    if (!db_conn) return 0;
+    cev_lock_acquire(&sessions_lock);
+    int keep_single = session_keep_single;
+    int keep_multi = session_keep_multi;
+    cev_lock_release(&sessions_lock);
+    return compact_session_table(&single_compactor, keep_single) +
+           compact_session_table(&multi_compactor, keep_multi);
+}
+
+int db_get_recent_sessions(cwist_db *db, const char *identity, const char *session_type, db_session_row *rows, int limit) {
+    (void)db;
+    if (!identity || !session_type || strlen(identity) == 0 || strlen(session_type) == 0) return 0;
+    if (limit <= 0) limit = 8;
+    if (limit > DB_SESSION_LIMIT_MAX) limit = DB_SESSION_LIMIT_MAX;
+    int multi = strcmp(session_type, "multiplayer") == 0;
+    int n = 0;
+
+    cev_lock_acquire(&sessions_lock);
+    sqlite3_stmt *st = db_stmt_get(multi ? STMT_SESSION_MULTI_RECENT : STMT_SESSION_SINGLE_RECENT);
+    db_stmt_bind(st, "ti", identity, limit);
+    while (n < limit && db_stmt_row(st) == 1) {
+        db_session_row *row = &rows[n++];
+        row->id = db_col_int(st, 0);
+        db_col_text(st, 1, row->mode, sizeof(row->mode));
+        db_col_text(st, 2, row->difficulty, sizeof(row->difficulty));
+        row->room_id = db_col_int(st, 3);
+        db_col_text(st, 4, row->created_at, sizeof(row->created_at));
+    }
+    db_stmt_done(st);
+    cev_lock_release(&sessions_lock);
+    return n;
 }
 
 void db_refresh_betting_slots(cwist_db *db) {
+    (void)db;
     if (!betting_db_available()) return;
-    pthread_mutex_lock(&db_mutex);
-    cJSON *res = NULL;
-    cwist_db_query(db, "SELECT COUNT(*) AS cnt FROM betting.betting_slots;", &res);
+    cev_lock_acquire(&betting_lock);
     int cnt = 0;
-    if (res && cJSON_GetArraySize(res) > 0) {
-        cJSON *row = cJSON_GetArrayItem(res, 0);
-        cJSON *item = cJSON_GetObjectItem(row, "cnt");
-        if (item) cnt = item->valueint;
-    }
-    if (res) cJSON_Delete(res);
+    sqlite3_stmt *st = db_stmt_get(STMT_BET_SLOT_COUNT);
+    if (db_stmt_row(st) == 1) cnt = db_col_int(st, 0);
+    db_stmt_done(st);
 
-    if (cnt == 10) {
-        pthread_mutex_unlock(&db_mutex);
+    if (cnt == DB_BETTING_SLOT_COUNT) {
+        cev_lock_release(&betting_lock);
         return;
     }
 
-    cwist_db_exec(db, "DELETE FROM betting.betting_slots;");
+    db_stmt_exec(db_stmt_get(STMT_BET_SLOT_CLEAR));
 
-    for (int slot = 1; slot <= 10; slot++) {
+    for (int slot = 1; slot <= DB_BETTING_SLOT_COUNT; slot++) {
         const char *difficulty = (slot <= 4) ? "easy" : (slot <= 7 ? "medium" : "hard");
         double p_win = 0.50;
         double p_lose = 0.28;
@@ -648,312 +1127,472 @@ void db_refresh_betting_slots(cwist_db *db) {
             p_lose = 0.38;
             p_draw = 0.24;
         }
-        double odds_win = 1.0 / p_win;
-        double odds_lose = 1.0 / p_lose;
-        double odds_draw = 1.0 / p_draw;
+        // Odds are stored rounded to 3 decimals, matching what clients see.
+        double odds_win = round(1000.0 / p_win) / 1000.0;
+        double odds_lose = round(1000.0 / p_lose) / 1000.0;
+        double odds_draw = round(1000.0 / p_draw) / 1000.0;
 
         int roll = rand() % 1000;
         const char *result = "draw";
         if (roll < (int)(p_win * 1000.0)) result = "win";
         else if (roll < (int)((p_win + p_lose) * 1000.0)) result = "lose";
 
-        char ins[512];
-        snprintf(ins, sizeof(ins),
-            "INSERT INTO betting.betting_slots (slot_id, difficulty, odds_win, odds_lose, odds_draw, result, refresh_mark, updated_at) VALUES (%d, '%s', %.3f, %.3f, %.3f, '%s', 0, CURRENT_TIMESTAMP);",
-            slot, difficulty, odds_win, odds_lose, odds_draw, result);
-        cwist_db_exec(db, ins);
+        st = db_stmt_get(STMT_BET_SLOT_INSERT);
+        db_stmt_bind(st, "itddds", slot, difficulty, odds_win, odds_lose, odds_draw, result);
+        db_stmt_exec(st);
     }
-    pthread_mutex_unlock(&db_mutex);
+    __atomic_add_fetch(&slots_version, 1, __ATOMIC_RELEASE);
+    cev_lock_release(&betting_lock);
+}
+
+uint64_t db_betting_slots_version(void) {
+    return __atomic_load_n(&slots_version, __ATOMIC_ACQUIRE);
 }
 
-cJSON *db_get_betting_slots(cwist_db *db) {
-    if (!betting_db_available()) return cJSON_CreateArray();
+int db_get_betting_slots(cwist_db *db, db_betting_slot *rows, int max) {
+    if (!betting_db_available()) return 0;
     db_refresh_betting_slots(db);
-    pthread_mutex_lock(&db_mutex);
-    cJSON *res = NULL;
-    cwist_db_query(db, "SELECT slot_id, difficulty, odds_win, odds_lose, odds_draw, updated_at FROM betting.betting_slots ORDER BY slot_id ASC;", &res);
-    pthread_mutex_unlock(&db_mutex);
-    if (!res) return cJSON_CreateArray();
-    return res;
+    int n = 0;
+    cev_lock_acquire(&betting_lock);
+    sqlite3_stmt *st = db_stmt_get(STMT_BET_SLOT_LIST);
+    while (n < max && db_stmt_row(st) == 1) {
+        db_betting_slot *slot = &rows[n++];
+        slot->slot_id = db_col_int(st, 0);
+        db_col_text(st, 1, slot->difficulty, sizeof(slot->difficulty));
+        slot->odds_win = db_col_double(st, 2);
+        slot->odds_lose = db_col_double(st, 3);
+        slot->odds_draw = db_col_double(st, 4);
+        db_col_text(st, 5, slot->updated_at, sizeof(slot->updated_at));
+    }
+    db_stmt_done(st);
+    cev_lock_release(&betting_lock);
+    return n;
+}
+
+/* Runs a bound betting_users write that returns updated_at and mirrors the row into
+   betting_board. Returns SQLITE_OK, or SQLITE_ERROR if the write failed. */
+static int update_betting_board(sqlite3_stmt *st, const char *identity, int points) {
+    int step = db_stmt_row(st);
+    if (step == 1) {
+        leaderboard_row row;
+        memset(&row, 0, sizeof(row));
+        copy_field(row.name, sizeof(row.name), identity);
+        row.score = points;
+        db_col_text(st, 0, row.stamp, sizeof(row.stamp));
+        leaderboard_update(&betting_board, &row);
+    }
+    db_stmt_done(st);
+    return step == 1 ? SQLITE_OK : SQLITE_ERROR;
+}
+
+/* Reads a bettor's balance, creating the row with starting points if absent.
+   Caller holds betting_lock. Returns 1 if the row already existed. */
+static int load_betting_points(const char *identity, int *points) {
+    int found = 0;
+    sqlite3_stmt *st = db_stmt_get(STMT_BET_USER_POINTS);
+    db_stmt_bind(st, "t", identity);
+    if (db_stmt_row(st) == 1) {
+        *points = db_col_int(st, 0);
+        found = 1;
+    }
+    db_stmt_done(st);
+    if (!found) {
+        st = db_stmt_get(STMT_BET_USER_INSERT);
+        db_stmt_bind(st, "ti", identity, BETTING_START_POINTS);
+        update_betting_board(st, identity, BETTING_START_POINTS);
+        *points = BETTING_START_POINTS;
+    }
+    return found;
+}
+
+/* Returns SQLITE_OK, or SQLITE_ERROR if the balance was not written. */
+static int store_betting_points(const char *identity, int points) {
+    sqlite3_stmt *st = db_stmt_get(STMT_BET_USER_SET_POINTS);
+    db_stmt_bind(st, "it", points, identity);
+    return update_betting_board(st, identity, points);
 }
 
 int db_get_betting_points(cwist_db *db, const char *identity, int *points) {
+    (void)db;
     if (!betting_db_available()) return -1;
     if (!identity || strlen(identity) == 0) return -1;
-    char esc_identity[256];
-    sql_escape(identity, esc_identity, sizeof(esc_identity));
-    pthread_mutex_lock(&db_mutex);
-    char sql[512];
-    snprintf(sql, sizeof(sql), "SELECT points FROM betting.betting_users WHERE identity = '%s';", esc_identity);
-    cJSON *res = NULL;
-    cwist_db_query(db, sql, &res);
-    if (res && cJSON_GetArraySize(res) > 0) {
-        cJSON *row = cJSON_GetArrayItem(res, 0);
-        *points = json_to_int(row, "points", BETTING_START_POINTS);
+    cev_lock_acquire(&betting_lock);
+    if (load_betting_points(identity, points)) {
         int normalized = betting_reset_if_needed(*points);
         if (normalized != *points) {
-            char upd[512];
-            snprintf(upd, sizeof(upd), "UPDATE betting.betting_users SET points = %d, updated_at=CURRENT_TIMESTAMP WHERE identity='%s';", normalized, esc_identity);
-            cwist_db_exec(db, upd);
+            store_betting_points(identity, normalized);
             *points = normalized;
         }
-    } else {
-        char ins[512];
-        snprintf(ins, sizeof(ins), "INSERT INTO betting.betting_users (identity, points, updated_at) VALUES ('%s', %d, CURRENT_TIMESTAMP);", esc_identity, BETTING_START_POINTS);
-        cwist_db_exec(db, ins);
-        *points = BETTING_START_POINTS;
     }
-    if (res) cJSON_Delete(res);
-    pthread_mutex_unlock(&db_mutex);
+    cev_lock_release(&betting_lock);
     return 0;
 }
 
-int db_apply_bet(cwist_db *db, const char *identity, int slot_id, const char *outcome, int amount, cJSON **result_json) {
+int db_apply_bet(cwist_db *db, const char *identity, int slot_id, const char *outcome, int amount, db_bet_result *result) {
     if (!betting_db_available()) return -1;
     if (!identity || !outcome || amount <= 0) return -1;
     db_refresh_betting_slots(db);
-    char esc_identity[256];
-    sql_escape(identity, esc_identity, sizeof(esc_identity));
-    pthread_mutex_lock(&db_mutex);
+    cev_lock_acquire(&betting_lock);
 
     int points = 0;
-    char q_user[512];
-    snprintf(q_user, sizeof(q_user), "SELECT points FROM betting.betting_users WHERE identity = '%s';", esc_identity);
-    cJSON *user_res = NULL;
-    cwist_db_query(db, q_user, &user_res);
-    if (user_res && cJSON_GetArraySize(user_res) > 0) {
-        cJSON *row = cJSON_GetArrayItem(user_res, 0);
-        points = json_to_int(row, "points", BETTING_START_POINTS);
-    } else {
-        char ins[512];
-        snprintf(ins, sizeof(ins), "INSERT INTO betting.betting_users (identity, points, updated_at) VALUES ('%s', %d, CURRENT_TIMESTAMP);", esc_identity, BETTING_START_POINTS);
-        cwist_db_exec(db, ins);
-        points = BETTING_START_POINTS;
-    }
-    if (user_res) cJSON_Delete(user_res);
+    load_betting_points(identity, &points);
     points = betting_reset_if_needed(points);
 
-    char q_slot[256];
-    snprintf(q_slot, sizeof(q_slot), "SELECT odds_win, odds_lose, odds_draw, result FROM betting.betting_slots WHERE slot_id = %d;", slot_id);
-    cJSON *slot_res = NULL;
-    cwist_db_query(db, q_slot, &slot_res);
-    if (!slot_res || cJSON_GetArraySize(slot_res) == 0) {
-        if (slot_res) cJSON_Delete(slot_res);
-        pthread_mutex_unlock(&db_mutex);
+    double odds_win = 0.0, odds_lose = 0.0, odds_draw = 0.0;
+    char actual_raw[16];
+    sqlite3_stmt *st = db_stmt_get(STMT_BET_SLOT_GET);
+    db_stmt_bind(st, "i", slot_id);
+    if (db_stmt_row(st) != 1) {
+        db_stmt_done(st);
+        cev_lock_release(&betting_lock);
         return -2;
     }
+    odds_win = db_col_double(st, 0);
+    odds_lose = db_col_double(st, 1);
+    odds_draw = db_col_double(st, 2);
+    db_col_text(st, 3, actual_raw, sizeof(actual_raw));
+    db_stmt_done(st);
 
-    cJSON *slot = cJSON_GetArrayItem(slot_res, 0);
-    cJSON *result_item = cJSON_GetObjectItem(slot, "result");
-    const char *actual_raw = (result_item && cJSON_IsString(result_item)) ? result_item->valuestring : NULL;
     const char *actual_result = canonical_bet_outcome(actual_raw);
     const char *picked_outcome = canonical_bet_outcome(outcome);
     if (!actual_result || !picked_outcome) {
-        cJSON_Delete(slot_res);
-        pthread_mutex_unlock(&db_mutex);
+        cev_lock_release(&betting_lock);
         return -4;
     }
 
     double odds = 1.0;
-    if (strcmp(picked_outcome, "win") == 0) odds = cJSON_GetObjectItem(slot, "odds_win")->valuedouble;
-    else if (strcmp(picked_outcome, "lose") == 0) odds = cJSON_GetObjectItem(slot, "odds_lose")->valuedouble;
-    else if (strcmp(picked_outcome, "draw") == 0) odds = cJSON_GetObjectItem(slot, "odds_draw")->valuedouble;
+    if (strcmp(picked_outcome, "win") == 0) odds = odds_win;
+    else if (strcmp(picked_outcome, "lose") == 0) odds = odds_lose;
+    else if (strcmp(picked_outcome, "draw") == 0) odds = odds_draw;
 
     if (!betting_can_wager(points, amount)) {
-        cJSON_Delete(slot_res);
-        pthread_mutex_unlock(&db_mutex);
+        cev_lock_release(&betting_lock);
         return -3;
     }
 
     int success = strcmp(picked_outcome, actual_result) == 0;
     int delta = betting_single_delta(amount, odds, success);
     points = safe_add_points(points, delta);
+    store_betting_points(identity, points);
 
-    char upd[512];
-    snprintf(upd, sizeof(upd), "UPDATE betting.betting_users SET points = %d, updated_at=CURRENT_TIMESTAMP WHERE identity='%s';", points, esc_identity);
-    cwist_db_exec(db, upd);
-
-    cJSON *result = cJSON_CreateObject();
-    cJSON_AddBoolToObject(result, "success", success);
-    cJSON_AddNumberToObject(result, "delta", delta);
-    cJSON_AddNumberToObject(result, "points", points);
-    cJSON_AddStringToObject(result, "result", actual_result);
-    cJSON_AddNumberToObject(result, "odds", odds);
-    *result_json = result;
+    result->success = success;
+    result->delta = delta;
+    result->points = points;
+    result->odds = odds;
+    copy_field(result->result, sizeof(result->result), actual_result);
 
-    cJSON_Delete(slot_res);
-    pthread_mutex_unlock(&db_mutex);
+    cev_lock_release(&betting_lock);
     return 0;
 }
 
-cJSON *db_get_betting_rankings(cwist_db *db) {
-    if (!betting_db_available()) return cJSON_CreateArray();
-    pthread_mutex_lock(&db_mutex);
-    cJSON *res = NULL;
-    cwist_db_query(db, "SELECT identity, points, updated_at FROM betting.betting_users ORDER BY points DESC, updated_at ASC LIMIT 20;", &res);
-    pthread_mutex_unlock(&db_mutex);
-    if (!res) return cJSON_CreateArray();
-    return res;
+static void reload_betting_board(void) {
+    leaderboard_row loaded[LEADERBOARD_ROWS_MAX];
+    int n = 0;
+    sqlite3_stmt *st = db_stmt_get(STMT_BET_RANKINGS);
+    db_stmt_bind(st, "i", betting_board.cap);
+    while (n < betting_board.cap && db_stmt_row(st) == 1) {
+        leaderboard_row *row = &loaded[n++];
+        memset(row, 0, sizeof(*row));
+        db_col_text(st, 0, row->name, sizeof(row->name));
+        row->score = db_col_int(st, 1);
+        db_col_text(st, 2, row->stamp, sizeof(row->stamp));
+    }
+    db_stmt_done(st);
+    leaderboard_reload(&betting_board, loaded, n);
 }
 
-int db_place_multiplayer_bet(cwist_db *db, const char *identity, int room_id, int target_player, int amount, cJSON **result_json) {
+int db_get_betting_rankings(cwist_db *db, db_betting_rank *rows, int max, uint64_t *version) {
+    (void)db;
+    if (version) *version = 0;
+    if (!betting_db_available()) return 0;
+    leaderboard_row top[LEADERBOARD_ROWS_MAX];
+    if (max > LEADERBOARD_ROWS_MAX) max = LEADERBOARD_ROWS_MAX;
+    cev_lock_acquire(&betting_lock);
+    if (betting_board.stale) reload_betting_board();
+    int n = leaderboard_copy(&betting_board, top, max);
+    if (version) *version = leaderboard_version(&betting_board);
+    cev_lock_release(&betting_lock);
+    for (int i = 0; i < n; i++) {
+        copy_field(rows[i].identity, sizeof(rows[i].identity), top[i].name);
+        rows[i].points = (int)top[i].score;
+        copy_field(rows[i].updated_at, sizeof(rows[i].updated_at), top[i].stamp);
+    }
+    return n;
+}
+
+uint64_t db_betting_rankings_version(void) {
+    return leaderboard_version(&betting_board);
+}
+
+int db_place_multiplayer_bet(cwist_db *db, const char *identity, int room_id, int target_player, int amount, int *points_out) {
+    (void)db;
     if (!betting_db_available()) return -1;
     if (!identity || room_id <= 0 || amount <= 0) return -1;
     if (target_player != 1 && target_player != 2) return -1;
-    char esc_identity[256];
-    sql_escape(identity, esc_identity, sizeof(esc_identity));
-    pthread_mutex_lock(&db_mutex);
+    cev_lock_acquire(&betting_lock);
 
     int points = BETTING_START_POINTS;
-    char q_user[512];
-    snprintf(q_user, sizeof(q_user), "SELECT points FROM betting.betting_users WHERE identity = '%s';", esc_identity);
-    cJSON *user_res = NULL;
-    cwist_db_query(db, q_user, &user_res);
-    if (user_res && cJSON_GetArraySize(user_res) > 0) {
-        cJSON *row = cJSON_GetArrayItem(user_res, 0);
-        points = json_to_int(row, "points", BETTING_START_POINTS);
-    } else {
-        char ins[512];
-        snprintf(ins, sizeof(ins), "INSERT INTO betting.betting_users (identity, points, updated_at) VALUES ('%s', %d, CURRENT_TIMESTAMP);", esc_identity, BETTING_START_POINTS);
-        cwist_db_exec(db, ins);
-    }
-    if (user_res) cJSON_Delete(user_res);
+    load_betting_points(identity, &points);
     points = betting_reset_if_needed(points);
 
     if (!betting_can_wager(points, amount)) {
-        pthread_mutex_unlock(&db_mutex);
+        cev_lock_release(&betting_lock);
         return -3;
     }
 
     points = safe_add_points(points, -((long long)amount));
-    char upd[512];
-    snprintf(upd, sizeof(upd), "UPDATE betting.betting_users SET points = %d, updated_at=CURRENT_TIMESTAMP WHERE identity='%s';", points, esc_identity);
-    cwist_db_exec(db, upd);
-
-    char ins_bet[512];
-    snprintf(ins_bet, sizeof(ins_bet),
-             "INSERT INTO betting.multiplayer_bets (room_id, identity, target_player, amount, settled, created_at) VALUES (%d, '%s', %d, %d, 0, CURRENT_TIMESTAMP);",
-             room_id, esc_identity, target_player, amount);
-    cwist_db_exec(db, ins_bet);
-
-    cJSON *result = cJSON_CreateObject();
-    cJSON_AddStringToObject(result, "identity", identity);
-    cJSON_AddNumberToObject(result, "room_id", room_id);
-    cJSON_AddNumberToObject(result, "target_player", target_player);
-    cJSON_AddNumberToObject(result, "amount", amount);
-    cJSON_AddNumberToObject(result, "points", points);
-    *result_json = result;
-
-    pthread_mutex_unlock(&db_mutex);
+    store_betting_points(identity, points);
+
+    sqlite3_stmt *st = db_stmt_get(STMT_MP_BET_INSERT);
+    db_stmt_bind(st, "itii", room_id, identity, target_player, amount);
+    if (db_stmt_row(st) == 1) {
+        __atomic_store_n(&last_bet_id, db_col_int64(st, 0), __ATOMIC_RELEASE);
+    }
+    db_stmt_done(st);
+
+    if (points_out) *points_out = points;
+    cev_lock_release(&betting_lock);
     return 0;
 }
 
-int db_settle_multiplayer_bets(cwist_db *db, int room_id, int winner_player, cJSON **settle_json) {
+typedef struct open_bet {
+    int id;
+    int target_player;
+    int amount;
+    long long reward;
+    char identity[128];
+} open_bet;
+
+static int compare_bet_identity(const void *a, const void *b) {
+    return strcmp(((const open_bet *)a)->identity, ((const open_bet *)b)->identity);
+}
+
+/* Reads the open bets once, credits each bettor's summed reward with one read and one write,
+   and marks the bets settled with a single UPDATE, all in one transaction. Rewards are never
+   negative, so clamping the sum matches clamping bet by bet. Every domain lock is held from
+   BEGIN to COMMIT: on the shared connection a write from any other domain would otherwise join
+   the transaction and be undone by its ROLLBACK. */
+static int settle_bets(int room_id, int winner_player, long long max_bet_id, db_settlement_summary *summary) {
     if (!betting_db_available()) return -1;
     if (room_id <= 0) return -1;
-    pthread_mutex_lock(&db_mutex);
-
-    char q_bets[256];
-    snprintf(q_bets, sizeof(q_bets), "SELECT id, identity, target_player, amount FROM betting.multiplayer_bets WHERE room_id=%d AND settled=0 ORDER BY id ASC;", room_id);
-    cJSON *bets = NULL;
-    cwist_db_query(db, q_bets, &bets);
-    if (!bets || cJSON_GetArraySize(bets) == 0) {
-        if (bets) cJSON_Delete(bets);
-        pthread_mutex_unlock(&db_mutex);
-        return 0;
-    }
+    lock_all_domains();
+    db_stmt_exec(db_stmt_get(STMT_BEGIN));
 
+    open_bet *bets = NULL;
+    int n = 0;
+    int cap = 0;
+    int failed = 0;
     long long total_pool = 0;
     long long total_winner_bet = 0;
-    int n = cJSON_GetArraySize(bets);
-    for (int i = 0; i < n; i++) {
-        cJSON *row = cJSON_GetArrayItem(bets, i);
-        int amount = json_to_int(row, "amount", 0);
-        int target = json_to_int(row, "target_player", 0);
-        total_pool += amount;
-        if (winner_player != 0 && target == winner_player) total_winner_bet += amount;
+    sqlite3_stmt *st = db_stmt_get(STMT_MP_BET_OPEN_FOR_ROOM);
+    db_stmt_bind(st, "il", room_id, max_bet_id);
+    while (db_stmt_row(st) == 1) {
+        if (n == cap) {
+            int grow = cap ? cap * 2 : 32;
+            open_bet *tmp = realloc(bets, sizeof(open_bet) * (size_t)grow);
+            if (!tmp) {
+                failed = 1;
+                break;
+            }
+            bets = tmp;
+            cap = grow;
+        }
+        open_bet *bet = &bets[n++];
+        bet->id = db_col_int(st, 0);
+        db_col_text(st, 1, bet->identity, sizeof(bet->identity));
+        bet->target_player = db_col_int(st, 2);
+        bet->amount = db_col_int(st, 3);
+        total_pool += bet->amount;
+        if (winner_player != 0 && bet->target_player == winner_player) total_winner_bet += bet->amount;
     }
+    db_stmt_done(st);
 
-    cJSON *payouts = cJSON_CreateArray();
-    for (int i = 0; i < n; i++) {
-        cJSON *row = cJSON_GetArrayItem(bets, i);
-        int bet_id = json_to_int(row, "id", 0);
-        const char *identity = cJSON_GetObjectItem(row, "identity")->valuestring;
-        int amount = json_to_int(row, "amount", 0);
-        int target = json_to_int(row, "target_player", 0);
-
-        long long reward = betting_multiplayer_reward(winner_player, target, amount, total_pool, total_winner_bet);
-
-        char esc_identity[256];
-        sql_escape(identity, esc_identity, sizeof(esc_identity));
-        int points = BETTING_START_POINTS;
-        char q_user[512];
-        snprintf(q_user, sizeof(q_user), "SELECT points FROM betting.betting_users WHERE identity='%s';", esc_identity);
-        cJSON *u = NULL;
-        cwist_db_query(db, q_user, &u);
-        if (u && cJSON_GetArraySize(u) > 0) {
-            cJSON *urow = cJSON_GetArrayItem(u, 0);
-            points = json_to_int(urow, "points", BETTING_START_POINTS);
-        } else {
-            char ins_u[512];
-            snprintf(ins_u, sizeof(ins_u), "INSERT INTO betting.betting_users (identity, points, updated_at) VALUES ('%s', %d, CURRENT_TIMESTAMP);", esc_identity, BETTING_START_POINTS);
-            cwist_db_exec(db, ins_u);
+    long long total_paid = 0;
+    if (!failed && n > 0) {
+        for (int i = 0; i < n; i++) {
+            bets[i].reward = betting_multiplayer_reward(winner_player, bets[i].target_player, bets[i].amount,
+                                                        total_pool, total_winner_bet);
+            total_paid += bets[i].reward;
+        }
+        qsort(bets, (size_t)n, sizeof(open_bet), compare_bet_identity);
+        for (int i = 0; i < n;) {
+            long long reward = 0;
+            int j = i;
+            while (j < n && strcmp(bets[j].identity, bets[i].identity) == 0) reward += bets[j++].reward;
+            int points = BETTING_START_POINTS;
+            load_betting_points(bets[i].identity, &points);
+            if (store_betting_points(bets[i].identity, safe_add_points(points, reward)) != SQLITE_OK) {
+                failed = 1;
+                break;
+            }
+            i = j;
+        }
+        if (!failed) {
+            st = db_stmt_get(STMT_MP_BET_SETTLE_ROOM);
+            db_stmt_bind(st, "il", room_id, max_bet_id);
+            failed = db_stmt_exec(st) != SQLITE_OK;
         }
-        if (u) cJSON_Delete(u);
-
-        points = safe_add_points(points, reward);
-        char upd[512];
-        snprintf(upd, sizeof(upd), "UPDATE betting.betting_users SET points=%d, updated_at=CURRENT_TIMESTAMP WHERE identity='%s';", points, esc_identity);
-        cwist_db_exec(db, upd);
-
-        char mark[128];
-        snprintf(mark, sizeof(mark), "UPDATE betting.multiplayer_bets SET settled=1 WHERE id=%d;", bet_id);
-        cwist_db_exec(db, mark);
-
-        cJSON *entry = cJSON_CreateObject();
-        cJSON_AddStringToObject(entry, "identity", identity);
-        cJSON_AddNumberToObject(entry, "reward", (double)reward);
-        cJSON_AddNumberToObject(entry, "points", points);
-        cJSON_AddItemToArray(payouts, entry);
-    }
-
-    cJSON *summary = cJSON_CreateObject();
-    cJSON_AddNumberToObject(summary, "room_id", room_id);
-    cJSON_AddNumberToObject(summary, "winner_player", winner_player);
-    cJSON_AddNumberToObject(summary, "total_pool", (double)total_pool);
-    cJSON_AddItemToObject(summary, "payouts", payouts);
-    if (settle_json) *settle_json = summary;
-    else cJSON_Delete(summary);
-
-    cJSON_Delete(bets);
-    pthread_mutex_unlock(&db_mutex);
+    }
+    db_stmt_exec(db_stmt_get(failed ? STMT_ROLLBACK : STMT_COMMIT));
+    /* The board already holds the rolled-back balances. */
+    if (failed) leaderboard_invalidate(&betting_board);
+
+    if (summary && !failed) {
+        summary->bets = n;
+        summary->winner_player = winner_player;
+        summary->total_pool = total_pool;
+        summary->total_paid = total_paid;
+    }
+
+    free(bets);
+    unlock_all_domains();
+    return failed ? -1 : 0;
+}
+
+int db_settle_multiplayer_bets(cwist_db *db, int room_id, int winner_player, db_settlement_summary *summary) {
+    (void)db;
+    return settle_bets(room_id, winner_player, LLONG_MAX, summary);
+}
+
+void db_queue_bet_settlement(int room_id, int winner_player) {
+    settle_job job = { room_id, winner_player, __atomic_load_n(&last_bet_id, __ATOMIC_ACQUIRE) };
+    pthread_mutex_lock(&settle_mutex);
+    if (settler_running && settle_count == settle_cap) {
+        int cap = settle_cap ? settle_cap * 2 : 16;
+        settle_job *grown = realloc(settle_queue, sizeof(settle_job) * (size_t)cap);
+        if (grown) {
+            settle_queue = grown;
+            settle_cap = cap;
+        }
+    }
+    if (settler_running && settle_count < settle_cap) {
+        settle_queue[settle_count++] = job;
+        pthread_cond_signal(&settle_cond);
+        pthread_mutex_unlock(&settle_mutex);
+        return;
+    }
+    pthread_mutex_unlock(&settle_mutex);
+    /* No settler thread (or no memory to queue): settle on the caller's thread. */
+    if (settle_bets(job.room_id, job.winner_player, job.max_bet_id, NULL) != 0) {
+        fprintf(stderr, "Bet settlement for room %d failed\n", job.room_id);
+    }
+}
+
+static void *settler_thread(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&settle_mutex);
+    while (1) {
+        while (settle_count == 0) pthread_cond_wait(&settle_cond, &settle_mutex);
+        settle_job job = settle_queue[0];
+        memmove(settle_queue, settle_queue + 1, sizeof(settle_job) * (size_t)(settle_count - 1));
+        settle_count--;
+        pthread_mutex_unlock(&settle_mutex);
+        if (settle_bets(job.room_id, job.winner_player, job.max_bet_id, NULL) != 0) {
+            fprintf(stderr, "Bet settlement for room %d failed\n", job.room_id);
+        }
+        pthread_mutex_lock(&settle_mutex);
+    }
+    return NULL;
+}
+
+/* Last prediction per slot (room_id % slots); a hit needs the same room at the same version.
+   predict_mutex is a leaf lock: nothing else is taken while it is held. */
+static db_prediction predict_cache[PREDICT_CACHE_SLOTS];
+static pthread_mutex_t predict_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+int db_predict_multiplayer_result(cwist_db *db, int room_id, db_prediction *out) {
+    (void)db;
+    if (room_id <= 0 || !out) return -1;
+
+    bitboard board;
+    int active;
+    memset(out, 0, sizeof(*out));
+    rooms_lock(room_id);
+    room_record *room = rooms_lookup(room_id);
+    if (!room) {
+        rooms_unlock(room_id);
+        return -1;
+    }
+    board = room->board;
+    out->room_id = room_id;
+    out->version = room->version;
+    out->turn = room->turn;
+    active = strcmp(room->status, "active") == 0;
+    rooms_unlock(room_id);
+    out->empties = 64 - bitboard_count_all(&board);
+
+    db_prediction *slot = &predict_cache[room_id % PREDICT_CACHE_SLOTS];
+    pthread_mutex_lock(&predict_mutex);
+    if (slot->room_id == room_id && slot->version == out->version) {
+        *out = *slot;
+        pthread_mutex_unlock(&predict_mutex);
+        return 0;
+    }
+    pthread_mutex_unlock(&predict_mutex);
+
+    /* Solved outside every lock; two requests racing on a new version just both solve it. */
+    endgame_result eg;
+    if (active && out->empties <= DB_PREDICT_MAX_EMPTIES &&
+        endgame_solve(&board, out->turn, DB_PREDICT_TIME_MS, 0, &eg) == 0) {
+        out->solved = 1;
+        out->winner_player = eg.score > 0 ? out->turn : eg.score < 0 ? BITBOARD_OPPONENT(out->turn) : 0;
+        out->margin = eg.score < 0 ? -eg.score : eg.score;
+    }
+
+    pthread_mutex_lock(&predict_mutex);
+    *slot = *out;
+    pthread_mutex_unlock(&predict_mutex);
     return 0;
 }
 
-cJSON *db_get_multiplayer_bet_history(cwist_db *db, const char *identity, int room_id) {
-    if (!betting_db_available()) return cJSON_CreateArray();
-    if (!identity || strlen(identity) == 0) return cJSON_CreateArray();
-    char esc_identity[256];
-    sql_escape(identity, esc_identity, sizeof(esc_identity));
+int db_get_multiplayer_bet_history(cwist_db *db, const char *identity, int room_id, db_mp_bet_row *rows, int max) {
+    (void)db;
+    if (!betting_db_available()) return 0;
+    if (!identity || strlen(identity) == 0) return 0;
+    if (max > DB_BET_HISTORY_LIMIT) max = DB_BET_HISTORY_LIMIT;
+    int n = 0;
 
-    pthread_mutex_lock(&db_mutex);
-    cJSON *res = NULL;
-    char sql[768];
+    cev_lock_acquire(&betting_lock);
+    sqlite3_stmt *st;
     if (room_id > 0) {
-        snprintf(sql, sizeof(sql),
-                 "SELECT id, room_id, target_player, amount, settled, created_at "
-                 "FROM betting.multiplayer_bets WHERE identity='%s' AND room_id=%d "
-                 "ORDER BY id DESC LIMIT 30;",
-                 esc_identity, room_id);
+        st = db_stmt_get(STMT_MP_BET_HISTORY_ROOM);
+        db_stmt_bind(st, "tii", identity, room_id, max);
     } else {
-        snprintf(sql, sizeof(sql),
-                 "SELECT id, room_id, target_player, amount, settled, created_at "
-                 "FROM betting.multiplayer_bets WHERE identity='%s' "
-                 "ORDER BY id DESC LIMIT 30;",
-                 esc_identity);
-    }
-    cwist_db_query(db, sql, &res);
-    pthread_mutex_unlock(&db_mutex);
-    if (!res) return cJSON_CreateArray();
-    return res;
+        st = db_stmt_get(STMT_MP_BET_HISTORY_ALL);
+        db_stmt_bind(st, "ti", identity, max);
+    }
+    while (n < max && db_stmt_row(st) == 1) {
+        db_mp_bet_row *row = &rows[n++];
+        row->id = db_col_int(st, 0);
+        row->room_id = db_col_int(st, 1);
+        row->target_player = db_col_int(st, 2);
+        row->amount = db_col_int(st, 3);
+        row->settled = db_col_int(st, 4);
+        db_col_text(st, 5, row->created_at, sizeof(row->created_at));
+    }
+    db_stmt_done(st);
+    cev_lock_release(&betting_lock);
+    return n;
+}
+
+int db_explain_queries(void) {
+    lock_all_domains();
+    int offenders = db_stmt_explain(db_conn);
+    unlock_all_domains();
+    return offenders;
+}
+
+int db_get_lock_stats(db_lock_stat *rows, int max) {
+    int n = 0;
+    for (int i = 0; i < DOMAIN_LOCK_COUNT && n < max; i++, n++) {
+        copy_field(rows[n].name, sizeof(rows[n].name), domain_locks[i].name);
+        rows[n].acquired = cev_lock_acquired(domain_locks[i].lock);
+        rows[n].contended = cev_lock_contended(domain_locks[i].lock);
+        rows[n].waited_ns = cev_lock_waited_ns(domain_locks[i].lock);
+    }
+    for (int i = 0; i < ROOMS_STRIPES && n < max; i++, n++) {
+        snprintf(rows[n].name, sizeof(rows[n].name), "rooms.%d", i);
+        rooms_stripe_stats(i, &rows[n].acquired, &rows[n].contended, &rows[n].waited_ns);
+    }
+    return n;
 }
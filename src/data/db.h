@@ -2,37 +2,213 @@
 #define DB_H
 
 #include <cwist/core/db/sql.h>
-#include <cjson/cJSON.h>
+#include <stdint.h>
+#include <time.h>
 
 #include "../core/common.h"
+#include "../game/bitboard.h"
+
+#define DB_RANKINGS_LIMIT 10
+#define DB_ROOM_LIST_LIMIT 50
+#define DB_SESSION_LIMIT_MAX 100
+/* Session rows kept per identity and type by default: as many as one request can read. */
+#define DB_SESSION_KEEP_DEFAULT DB_SESSION_LIMIT_MAX
+#define DB_SESSION_TOTALS_MAX 16
+#define DB_BETTING_SLOT_COUNT 10
+#define DB_BETTING_RANKINGS_LIMIT 20
+#define DB_BET_HISTORY_LIMIT 30
+#define DB_LOCK_STATS_MAX 96
+/* Live rooms are only solved this close to the end, within DB_PREDICT_TIME_MS. */
+#define DB_PREDICT_MAX_EMPTIES 16
+#define DB_PREDICT_TIME_MS 250
+
+typedef struct db_user_stats {
+    char username[64];
+    int wins;
+    int losses;
+    int ties;
+} db_user_stats;
+
+typedef struct db_room_summary {
+    int room_id;
+    int players;
+    time_t last_activity;
+    char mode[16];
+    char status[16];
+} db_room_summary;
+
+typedef struct db_session_row {
+    int id;
+    int room_id;
+    char mode[16];
+    char difficulty[16];
+    char created_at[32];
+} db_session_row;
+
+/* Sessions rolled out of the history tables, per mode and difficulty. */
+typedef struct db_session_total {
+    char mode[16];
+    char difficulty[16];
+    int sessions;
+    char first_at[32];
+    char last_at[32];
+} db_session_total;
+
+typedef struct db_betting_slot {
+    int slot_id;
+    double odds_win;
+    double odds_lose;
+    double odds_draw;
+    char difficulty[16];
+    char updated_at[32];
+} db_betting_slot;
+
+typedef struct db_betting_rank {
+    int points;
+    char identity[128];
+    char updated_at[32];
+} db_betting_rank;
+
+typedef struct db_bet_result {
+    int success;
+    int delta;
+    int points;
+    double odds;
+    char result[8];
+} db_bet_result;
+
+typedef struct db_mp_bet_row {
+    int id;
+    int room_id;
+    int target_player;
+    int amount;
+    int settled;
+    char created_at[32];
+} db_mp_bet_row;
+
+typedef struct db_settlement_summary {
+    int bets;
+    int winner_player;
+    long long total_pool;
+    long long total_paid;
+} db_settlement_summary;
+
+/* Perfect-play outcome of a live room as of version. solved is 0 when the room is not active,
+   has too many empties, or the solver ran out of time. */
+typedef struct db_prediction {
+    int room_id;
+    uint64_t version;
+    int empties;
+    int turn;
+    int solved;
+    int winner_player;  /* 0 = draw */
+    int margin;         /* winner's disc margin */
+} db_prediction;
+
+typedef struct db_lock_stat {
+    char name[24];
+    uint64_t acquired;
+    uint64_t contended;
+    uint64_t waited_ns;
+} db_lock_stat;
 
 extern cwist_db *db_conn;
 
 void init_db(cwist_db *db);
+/* Expires the rooms whose idle deadline has passed, and their multiplayer sessions. Cheap
+   when nothing is due; call once a second. */
 void cleanup_stale_rooms(cwist_db *db);
-void get_game_state(cwist_db *db, int room_id, int board[SIZE][SIZE], int *turn, char *status, int *players, char *mode, const char *requested_mode);
-void update_game_state(cwist_db *db, int room_id, int board[SIZE][SIZE], int turn, const char *status, int players, const char *mode);
+void get_game_state(cwist_db *db, int room_id, bitboard *board, int *turn, char *status, int *players, char *mode, const char *requested_mode);
+void update_game_state(cwist_db *db, int room_id, const bitboard *board, int turn, const char *status, int players, const char *mode);
+/* A room's state as of version. */
+typedef struct db_room_view {
+    uint64_t version;
+    bitboard board;
+    int turn;
+    int players;
+    char status[16];
+    char mode[16];
+} db_room_view;
+
+/* Result of db_play_move: the disc placed and the discs it flipped, and the room afterwards. */
+typedef struct db_move_result {
+    int square;
+    uint64_t flips;
+    int turn;
+    int winner_player;  /* valid once status is 'finished'; 0 = draw */
+    uint64_t version;
+    char status[16];
+} db_move_result;
+
+#define DB_MOVE_OK 0
+#define DB_MOVE_REJECTED -1  /* room not active or not the player's turn */
+#define DB_MOVE_ILLEGAL -2
+
+/* Fills out with one consistent snapshot of the room and returns 0. A missing room reads as a
+   new, empty one at version 0 and returns -1. */
+int db_get_room_view(cwist_db *db, int room_id, db_room_view *out);
+/* Validates and applies player's move at (r, c) under the room's lock, so two moves can't
+   interleave. Records the result and queues bet settlement when the game ends. out may be NULL. */
+int db_play_move(cwist_db *db, int room_id, int player, int r, int c, db_move_result *out);
+/* Counts a /state poll as activity, so a room its players only watch does not idle out. Writes
+   last_activity at most once a second, the expiry wheel's tick; a timed-out room still drops. */
+void db_touch_room(cwist_db *db, int room_id);
+/* Long-poll support: waits until the room changes past version since. Returns the current version. */
+uint64_t db_wait_game_state(cwist_db *db, int room_id, uint64_t since, int timeout_ms);
+/* watcher(room_id) runs after every visible change to a room, including its removal, with
+   the room locked: it must only note the id and wake someone, without calling back into db. */
+void db_set_room_watcher(void (*watcher)(int room_id));
+/* Moves whenever db_get_multiplayer_rooms' output may have changed. */
+uint64_t db_rooms_version(void);
 int db_join_game(cwist_db *db, int room_id, const char *requested_mode, int *player_id, char *mode, int user_id);
 void db_leave_game(cwist_db *db, int room_id, int player_id, int user_id);
 void db_reset_room(cwist_db *db, int room_id);
 void db_record_result(cwist_db *db, int room_id, int winner_pid);
 
+/* Row readers fill caller-owned arrays and return the row count (or -1 on error). */
 int db_register_user(cwist_db *db, const char *username, const char *password_hash);
 int db_login_user(cwist_db *db, const char *username, const char *password_hash);
-cJSON *db_get_rankings(cwist_db *db);
-cJSON *db_get_user_info(cwist_db *db, int user_id);
-cJSON *db_get_multiplayer_rooms(cwist_db *db);
+/* Both leaderboards are served from memory. *version (may be NULL) identifies the rows returned
+   and changes only when they do; the *_version calls read it without a lock. */
+int db_get_rankings(cwist_db *db, db_user_stats *rows, int max, uint64_t *version);
+uint64_t db_rankings_version(void);
+/* Returns 0 and fills out when the user exists, -1 otherwise. */
+int db_get_user_info(cwist_db *db, int user_id, db_user_stats *out);
+int db_get_multiplayer_rooms(cwist_db *db, db_room_summary *rows, int max);
 int db_log_game_session(cwist_db *db, const char *identity, const char *session_type, const char *mode, const char *difficulty, int room_id);
-cJSON *db_get_recent_sessions(cwist_db *db, const char *identity, const char *session_type, int limit);
+int db_get_recent_sessions(cwist_db *db, const char *identity, const char *session_type, db_session_row *rows, int limit);
 int db_remove_multiplayer_session(cwist_db *db, const char *identity, int room_id);
+int db_get_session_totals(cwist_db *db, const char *identity, const char *session_type, db_session_total *rows, int max);
+/* Rows kept per identity in single_sessions / multi_sessions; 0 keeps everything. */
+void db_set_session_retention(int keep_single, int keep_multi);
+/* Folds rows beyond the retention limit into session_totals and deletes them, in bounded
+   batches. Returns the number of rows compacted. Called from the cleanup thread. */
+int db_compact_sessions(cwist_db *db);
 
 void db_refresh_betting_slots(cwist_db *db);
-cJSON *db_get_betting_slots(cwist_db *db);
+int db_get_betting_slots(cwist_db *db, db_betting_slot *rows, int max);
+/* Bumped each time the slots are regenerated. */
+uint64_t db_betting_slots_version(void);
 int db_get_betting_points(cwist_db *db, const char *identity, int *points);
-int db_apply_bet(cwist_db *db, const char *identity, int slot_id, const char *outcome, int amount, cJSON **result_json);
-cJSON *db_get_betting_rankings(cwist_db *db);
-int db_place_multiplayer_bet(cwist_db *db, const char *identity, int room_id, int target_player, int amount, cJSON **result_json);
-int db_settle_multiplayer_bets(cwist_db *db, int room_id, int winner_player, cJSON **settle_json);
-cJSON *db_get_multiplayer_bet_history(cwist_db *db, const char *identity, int room_id);
+int db_apply_bet(cwist_db *db, const char *identity, int slot_id, const char *outcome, int amount, db_bet_result *result);
+int db_get_betting_rankings(cwist_db *db, db_betting_rank *rows, int max, uint64_t *version);
+uint64_t db_betting_rankings_version(void);
+/* On success *points holds the bettor's balance after the stake is taken. */
+int db_place_multiplayer_bet(cwist_db *db, const char *identity, int room_id, int target_player, int amount, int *points);
+/* Pays out every open bet on the room in one transaction. */
+int db_settle_multiplayer_bets(cwist_db *db, int room_id, int winner_player, db_settlement_summary *summary);
+/* Queues the settlement for the background settler and returns at once. Only bets placed
+   before this call are paid; later ones stay open. */
+void db_queue_bet_settlement(int room_id, int winner_player);
+/* Returns 0 and fills out for an existing room, -1 otherwise. Cached per room version. */
+int db_predict_multiplayer_result(cwist_db *db, int room_id, db_prediction *out);
+int db_get_multiplayer_bet_history(cwist_db *db, const char *identity, int room_id, db_mp_bet_row *rows, int max);
+
+/* Startup self-check behind --explain: prints every statement's query plan and returns the
+   number of hot statements that fall back to a full table scan. */
+int db_explain_queries(void);
+
+/* Counters of the domain locks followed by every room stripe. */
+int db_get_lock_stats(db_lock_stat *rows, int max);
 
 #endif
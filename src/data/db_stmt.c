@@ -0,0 +1,286 @@
+#include "db_stmt.h"
+
+#include "../core/metrics.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *stmt_sql[STMT_COUNT] = {
+    [STMT_BEGIN] = "BEGIN;",
+    [STMT_COMMIT] = "COMMIT;",
+    [STMT_ROLLBACK] = "ROLLBACK;",
+
+    [STMT_GAME_LOAD] =
+        "SELECT room_id, board, turn, status, players, mode, user1_id, user2_id, "
+        "CAST(strftime('%s', last_activity) AS INTEGER) FROM games WHERE session_type='multiplayer';",
+    [STMT_GAME_UPSERT] =
+        "INSERT OR REPLACE INTO games (room_id, board, turn, status, players, mode, user1_id, user2_id, session_type, last_activity) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, 'multiplayer', datetime(?, 'unixepoch'));",
+    [STMT_GAME_DELETE] = "DELETE FROM games WHERE room_id = ?;",
+    [STMT_GAME_LEGACY_BOARDS] = "SELECT room_id, board FROM games WHERE typeof(board) = 'text';",
+    [STMT_GAME_SET_BOARD] = "UPDATE games SET board = ? WHERE room_id = ?;",
+
+    [STMT_USER_REGISTER] = "INSERT INTO users (username, password_hash) VALUES (?, ?);",
+    [STMT_USER_LOGIN] = "SELECT id FROM users WHERE username = ? AND password_hash = ?;",
+    [STMT_USER_INFO] = "SELECT username, wins, losses, ties FROM users WHERE id = ?;",
+    [STMT_USER_RANKINGS] = "SELECT username, wins, losses, ties FROM users ORDER BY wins DESC, username LIMIT ?;",
+    [STMT_USER_ADD_RESULT] =
+        "UPDATE users SET wins = wins + ?, losses = losses + ?, ties = ties + ? WHERE id = ? "
+        "RETURNING username, wins, losses, ties;",
+
+    [STMT_SESSION_MULTI_INSERT] =
+        "INSERT INTO multi_sessions (identity, mode, room_id, created_at) VALUES (?, ?, ?, CURRENT_TIMESTAMP);",
+    [STMT_SESSION_MULTI_DELETE] = "DELETE FROM multi_sessions WHERE identity = ? AND room_id = ?;",
+    [STMT_SESSION_MULTI_DELETE_ROOM] = "DELETE FROM multi_sessions WHERE room_id = ?;",
+    [STMT_SESSION_MULTI_RECENT] =
+        "SELECT id, mode, '', room_id, created_at FROM multi_sessions WHERE identity = ? ORDER BY id DESC LIMIT ?;",
+    [STMT_SESSION_SINGLE_INSERT] =
+        "INSERT INTO single_sessions (identity, mode, difficulty, room_id, created_at) VALUES (?, ?, ?, ?, CURRENT_TIMESTAMP);",
+    [STMT_SESSION_SINGLE_DELETE_ROOM] = "DELETE FROM single_sessions WHERE room_id = ?;",
+    [STMT_SESSION_SINGLE_RECENT] =
+        "SELECT id, mode, difficulty, room_id, created_at FROM single_sessions WHERE identity = ? ORDER BY id DESC LIMIT ?;",
+    /* Compaction walks identities in index order from a cursor, queues up to ? of one identity's
+       rows beyond its newest ?, folds the queue into session_totals, then deletes it. */
+    [STMT_SESSION_SINGLE_NEXT_IDENTITY] =
+        "SELECT identity FROM single_sessions WHERE identity > ? ORDER BY identity LIMIT 1;",
+    [STMT_SESSION_SINGLE_PICK_OLD] =
+        "INSERT INTO temp.session_compact (id) SELECT id FROM single_sessions "
+        "WHERE identity = ? ORDER BY id DESC LIMIT ? OFFSET ?;",
+    [STMT_SESSION_SINGLE_ROLLUP] =
+        "INSERT INTO session_totals (identity, session_type, mode, difficulty, sessions, first_at, last_at) "
+        "SELECT identity, 'singleplayer', COALESCE(mode, ''), COALESCE(difficulty, ''), COUNT(*), MIN(created_at), MAX(created_at) "
+        "FROM single_sessions WHERE id IN (SELECT id FROM temp.session_compact) "
+        "GROUP BY identity, COALESCE(mode, ''), COALESCE(difficulty, '') "
+        "ON CONFLICT (identity, session_type, mode, difficulty) DO UPDATE SET sessions = sessions + excluded.sessions, "
+        "first_at = MIN(first_at, excluded.first_at), last_at = MAX(last_at, excluded.last_at);",
+    [STMT_SESSION_SINGLE_PURGE] = "DELETE FROM single_sessions WHERE id IN (SELECT id FROM temp.session_compact);",
+    [STMT_SESSION_MULTI_NEXT_IDENTITY] =
+        "SELECT identity FROM multi_sessions WHERE identity > ? ORDER BY identity LIMIT 1;",
+    [STMT_SESSION_MULTI_PICK_OLD] =
+        "INSERT INTO temp.session_compact (id) SELECT id FROM multi_sessions "
+        "WHERE identity = ? ORDER BY id DESC LIMIT ? OFFSET ?;",
+    [STMT_SESSION_MULTI_ROLLUP] =
+        "INSERT INTO session_totals (identity, session_type, mode, difficulty, sessions, first_at, last_at) "
+        "SELECT identity, 'multiplayer', COALESCE(mode, ''), '', COUNT(*), MIN(created_at), MAX(created_at) "
+        "FROM multi_sessions WHERE id IN (SELECT id FROM temp.session_compact) "
+        "GROUP BY identity, COALESCE(mode, '') "
+        "ON CONFLICT (identity, session_type, mode, difficulty) DO UPDATE SET sessions = sessions + excluded.sessions, "
+        "first_at = MIN(first_at, excluded.first_at), last_at = MAX(last_at, excluded.last_at);",
+    [STMT_SESSION_MULTI_PURGE] = "DELETE FROM multi_sessions WHERE id IN (SELECT id FROM temp.session_compact);",
+    [STMT_SESSION_COMPACT_COUNT] = "SELECT COUNT(*) FROM temp.session_compact;",
+    [STMT_SESSION_COMPACT_CLEAR] = "DELETE FROM temp.session_compact;",
+    [STMT_SESSION_TOTALS] =
+        "SELECT mode, difficulty, sessions, first_at, last_at FROM session_totals "
+        "WHERE identity = ? AND session_type = ? ORDER BY mode, difficulty;",
+
+    [STMT_BET_USER_POINTS] = "SELECT points FROM betting.betting_users WHERE identity = ?;",
+    [STMT_BET_USER_INSERT] =
+        "INSERT INTO betting.betting_users (identity, points, updated_at) VALUES (?, ?, CURRENT_TIMESTAMP) "
+        "RETURNING updated_at;",
+    [STMT_BET_USER_SET_POINTS] =
+        "UPDATE betting.betting_users SET points = ?, updated_at = CURRENT_TIMESTAMP WHERE identity = ? "
+        "RETURNING updated_at;",
+    [STMT_BET_RANKINGS] =
+        "SELECT identity, points, updated_at FROM betting.betting_users "
+        "ORDER BY points DESC, updated_at ASC, identity ASC LIMIT ?;",
+    [STMT_BET_SLOT_COUNT] = "SELECT COUNT(*) FROM betting.betting_slots;",
+    [STMT_BET_SLOT_CLEAR] = "DELETE FROM betting.betting_slots;",
+    [STMT_BET_SLOT_INSERT] =
+        "INSERT INTO betting.betting_slots (slot_id, difficulty, odds_win, odds_lose, odds_draw, result, refresh_mark, updated_at) "
+        "VALUES (?, ?, ?, ?, ?, ?, 0, CURRENT_TIMESTAMP);",
+    [STMT_BET_SLOT_LIST] =
+        "SELECT slot_id, difficulty, odds_win, odds_lose, odds_draw, updated_at FROM betting.betting_slots ORDER BY slot_id ASC;",
+    [STMT_BET_SLOT_GET] = "SELECT odds_win, odds_lose, odds_draw, result FROM betting.betting_slots WHERE slot_id = ?;",
+    [STMT_MP_BET_INSERT] =
+        "INSERT INTO betting.multiplayer_bets (room_id, identity, target_player, amount, settled, created_at) "
+        "VALUES (?, ?, ?, ?, 0, CURRENT_TIMESTAMP) RETURNING id;",
+    /* Settlement only covers bets up to the id that was current when the game finished. */
+    [STMT_MP_BET_OPEN_FOR_ROOM] =
+        "SELECT id, identity, target_player, amount FROM betting.multiplayer_bets "
+        "WHERE room_id = ? AND settled = 0 AND id <= ? ORDER BY id ASC;",
+    [STMT_MP_BET_SETTLE_ROOM] =
+        "UPDATE betting.multiplayer_bets SET settled = 1 WHERE room_id = ? AND settled = 0 AND id <= ?;",
+    [STMT_MP_BET_LAST_ID] = "SELECT COALESCE(MAX(id), 0) FROM betting.multiplayer_bets;",
+    [STMT_MP_BET_HISTORY_ROOM] =
+        "SELECT id, room_id, target_player, amount, settled, created_at FROM betting.multiplayer_bets "
+        "WHERE identity = ? AND room_id = ? ORDER BY id DESC LIMIT ?;",
+    [STMT_MP_BET_HISTORY_ALL] =
+        "SELECT id, room_id, target_player, amount, settled, created_at FROM betting.multiplayer_bets "
+        "WHERE identity = ? ORDER BY id DESC LIMIT ?;",
+};
+
+/* Statements that read a whole table on purpose (startup load, migration, the compaction queue,
+   which holds one batch, the handful of betting slots). db_stmt_explain flags a scan anywhere
+   else. */
+static const unsigned char stmt_scans_ok[STMT_COUNT] = {
+    [STMT_GAME_LOAD] = 1,
+    [STMT_GAME_LEGACY_BOARDS] = 1,
+    [STMT_SESSION_SINGLE_ROLLUP] = 1,
+    [STMT_SESSION_MULTI_ROLLUP] = 1,
+    [STMT_SESSION_COMPACT_COUNT] = 1,
+    [STMT_BET_SLOT_COUNT] = 1,
+    [STMT_BET_SLOT_CLEAR] = 1,
+    [STMT_BET_SLOT_LIST] = 1,
+};
+
+static sqlite3_stmt *stmts[STMT_COUNT];
+
+/* cwist keeps the SQLite connection inside cwist_db; this is the only place that reaches into it. */
+static sqlite3 *db_native_handle(cwist_db *db) {
+    return db ? db->conn : NULL;
+}
+
+int db_stmt_prepare_all(cwist_db *db, int with_betting) {
+    sqlite3 *conn = db_native_handle(db);
+    int failures = 0;
+    for (int i = 0; i < STMT_COUNT; i++) {
+        if (stmts[i]) {
+            sqlite3_finalize(stmts[i]);
+            stmts[i] = NULL;
+        }
+        if (!with_betting && i >= STMT_BETTING_FIRST) continue;
+        if (!conn || sqlite3_prepare_v3(conn, stmt_sql[i], -1, SQLITE_PREPARE_PERSISTENT, &stmts[i], NULL) != SQLITE_OK) {
+            fprintf(stderr, "Failed to prepare statement %d: %s\n", i, conn ? sqlite3_errmsg(conn) : "no connection");
+            stmts[i] = NULL;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+/* A plan step that reads every row: "SCAN t" without an index, or a sort SQLite had to build. */
+static int plan_is_full_scan(const char *detail) {
+    if (strncmp(detail, "SCAN ", 5) == 0 && !strstr(detail, " INDEX ")) return 1;
+    return strstr(detail, "USE TEMP B-TREE") != NULL;
+}
+
+int db_stmt_explain(cwist_db *db) {
+    sqlite3 *conn = db_native_handle(db);
+    if (!conn) return -1;
+    int offenders = 0;
+    for (int i = 0; i < STMT_COUNT; i++) {
+        if (!stmts[i]) continue;
+        char sql[1024];
+        int n = snprintf(sql, sizeof(sql), "EXPLAIN QUERY PLAN %s", stmt_sql[i]);
+        sqlite3_stmt *plan = NULL;
+        if (n < 0 || (size_t)n >= sizeof(sql) ||
+            sqlite3_prepare_v2(conn, sql, -1, &plan, NULL) != SQLITE_OK) {
+            fprintf(stderr, "[explain] could not plan statement %d: %s\n", i, sqlite3_errmsg(conn));
+            sqlite3_finalize(plan);
+            offenders++;
+            continue;
+        }
+        int scans = 0;
+        printf("[explain] %s\n", stmt_sql[i]);
+        while (sqlite3_step(plan) == SQLITE_ROW) {
+            const char *detail = (const char *)sqlite3_column_text(plan, 3);
+            if (!detail) continue;
+            printf("[explain]     %s\n", detail);
+            if (!stmt_scans_ok[i] && plan_is_full_scan(detail)) scans = 1;
+        }
+        sqlite3_finalize(plan);
+        if (scans) {
+            fprintf(stderr, "[explain] FULL SCAN in hot statement %d: %s\n", i, stmt_sql[i]);
+            offenders++;
+        }
+    }
+    return offenders;
+}
+
+sqlite3_stmt *db_stmt_get(db_stmt_id id) {
+    if (id < 0 || id >= STMT_COUNT) return NULL;
+    sqlite3_stmt *st = stmts[id];
+    if (!st) return NULL;
+    sqlite3_reset(st);
+    sqlite3_clear_bindings(st);
+    return st;
+}
+
+int db_stmt_bind(sqlite3_stmt *st, const char *types, ...) {
+    if (!st || !types) return SQLITE_MISUSE;
+    va_list ap;
+    va_start(ap, types);
+    int rc = SQLITE_OK;
+    for (int i = 0; types[i] && rc == SQLITE_OK; i++) {
+        int idx = i + 1;
+        switch (types[i]) {
+        case 'i':
+            rc = sqlite3_bind_int(st, idx, va_arg(ap, int));
+            break;
+        case 'l':
+            rc = sqlite3_bind_int64(st, idx, (sqlite3_int64)va_arg(ap, long long));
+            break;
+        case 'd':
+            rc = sqlite3_bind_double(st, idx, va_arg(ap, double));
+            break;
+        case 't': {
+            const char *text = va_arg(ap, const char *);
+            rc = text ? sqlite3_bind_text(st, idx, text, -1, SQLITE_TRANSIENT) : sqlite3_bind_null(st, idx);
+            break;
+        }
+        case 'b': {
+            const void *blob = va_arg(ap, const void *);
+            int len = va_arg(ap, int);
+            rc = sqlite3_bind_blob(st, idx, blob, len, SQLITE_TRANSIENT);
+            break;
+        }
+        default:
+            rc = SQLITE_MISUSE;
+            break;
+        }
+    }
+    va_end(ap);
+    return rc;
+}
+
+int db_stmt_exec(sqlite3_stmt *st) {
+    if (!st) return SQLITE_MISUSE;
+    uint64_t start = cev_metrics_now_ns();
+    int rc;
+    while ((rc = sqlite3_step(st)) == SQLITE_ROW) {
+    }
+    sqlite3_reset(st);
+    cev_metrics_add_time(CEV_TIMER_SQLITE, cev_metrics_now_ns() - start);
+    return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+int db_stmt_row(sqlite3_stmt *st) {
+    if (!st) return -1;
+    uint64_t start = cev_metrics_now_ns();
+    int rc = sqlite3_step(st);
+    cev_metrics_add_time(CEV_TIMER_SQLITE, cev_metrics_now_ns() - start);
+    if (rc == SQLITE_ROW) return 1;
+    sqlite3_reset(st);
+    return rc == SQLITE_DONE ? 0 : -1;
+}
+
+void db_stmt_done(sqlite3_stmt *st) {
+    if (st) sqlite3_reset(st);
+}
+
+void db_col_text(sqlite3_stmt *st, int col, char *out, size_t n) {
+    if (!out || n == 0) return;
+    const unsigned char *text = sqlite3_column_text(st, col);
+    snprintf(out, n, "%s", text ? (const char *)text : "");
+}
+
+int db_col_int(sqlite3_stmt *st, int col) {
+    return sqlite3_column_int(st, col);
+}
+
+long long db_col_int64(sqlite3_stmt *st, int col) {
+    return (long long)sqlite3_column_int64(st, col);
+}
+
+double db_col_double(sqlite3_stmt *st, int col) {
+    return sqlite3_column_double(st, col);
+}
+
+int db_col_blob(sqlite3_stmt *st, int col, void *out, size_t n) {
+    if (sqlite3_column_type(st, col) != SQLITE_BLOB) return -1;
+    const void *blob = sqlite3_column_blob(st, col);
+    if (!blob || (size_t)sqlite3_column_bytes(st, col) != n) return -1;
+    memcpy(out, blob, n);
+    return 0;
+}
@@ -0,0 +1,96 @@
+#ifndef DB_STMT_H
+#define DB_STMT_H
+
+#include <cwist/core/db/sql.h>
+#include <sqlite3.h>
+#include <stddef.h>
+
+/* Every statement db.c runs after startup. Prepared once by db_stmt_prepare_all(). */
+typedef enum db_stmt_id {
+    STMT_BEGIN,
+    STMT_COMMIT,
+    STMT_ROLLBACK,
+
+    STMT_GAME_LOAD,
+    STMT_GAME_UPSERT,
+    STMT_GAME_DELETE,
+    STMT_GAME_LEGACY_BOARDS,
+    STMT_GAME_SET_BOARD,
+
+    STMT_USER_REGISTER,
+    STMT_USER_LOGIN,
+    STMT_USER_INFO,
+    STMT_USER_RANKINGS,
+    STMT_USER_ADD_RESULT,
+
+    STMT_SESSION_MULTI_INSERT,
+    STMT_SESSION_MULTI_DELETE,
+    STMT_SESSION_MULTI_DELETE_ROOM,
+    STMT_SESSION_MULTI_RECENT,
+    STMT_SESSION_SINGLE_INSERT,
+    STMT_SESSION_SINGLE_DELETE_ROOM,
+    STMT_SESSION_SINGLE_RECENT,
+    STMT_SESSION_SINGLE_NEXT_IDENTITY,
+    STMT_SESSION_SINGLE_PICK_OLD,
+    STMT_SESSION_SINGLE_ROLLUP,
+    STMT_SESSION_SINGLE_PURGE,
+    STMT_SESSION_MULTI_NEXT_IDENTITY,
+    STMT_SESSION_MULTI_PICK_OLD,
+    STMT_SESSION_MULTI_ROLLUP,
+    STMT_SESSION_MULTI_PURGE,
+    STMT_SESSION_COMPACT_COUNT,
+    STMT_SESSION_COMPACT_CLEAR,
+    STMT_SESSION_TOTALS,
+
+    /* Statements below need the attached betting database. */
+    STMT_BETTING_FIRST,
+    STMT_BET_USER_POINTS = STMT_BETTING_FIRST,
+    STMT_BET_USER_INSERT,
+    STMT_BET_USER_SET_POINTS,
+    STMT_BET_RANKINGS,
+    STMT_BET_SLOT_COUNT,
+    STMT_BET_SLOT_CLEAR,
+    STMT_BET_SLOT_INSERT,
+    STMT_BET_SLOT_LIST,
+    STMT_BET_SLOT_GET,
+    STMT_MP_BET_INSERT,
+    STMT_MP_BET_OPEN_FOR_ROOM,
+    STMT_MP_BET_SETTLE_ROOM,
+    STMT_MP_BET_LAST_ID,
+    STMT_MP_BET_HISTORY_ROOM,
+    STMT_MP_BET_HISTORY_ALL,
+
+    STMT_COUNT
+} db_stmt_id;
+
+/* Prepares the registry against db. Returns the number of statements that failed to prepare. */
+int db_stmt_prepare_all(cwist_db *db, int with_betting);
+
+/* Prints the EXPLAIN QUERY PLAN of every prepared statement. Returns how many scan a whole
+   table (or sort without an index) where an index lookup was expected, -1 without a connection. */
+int db_stmt_explain(cwist_db *db);
+
+/* Returns the statement reset and with cleared bindings, or NULL if it was never prepared.
+   Callers must hold the lock of the domain the statement belongs to. */
+sqlite3_stmt *db_stmt_get(db_stmt_id id);
+
+/* Binds positional parameters from a type string: i = int, l = long long, d = double,
+   t = NUL-terminated text, b = blob (pointer, int length). Returns SQLITE_OK on success. */
+int db_stmt_bind(sqlite3_stmt *st, const char *types, ...);
+
+/* Runs a statement that returns no rows. Returns SQLITE_OK or the SQLite error code. */
+int db_stmt_exec(sqlite3_stmt *st);
+/* Steps once: 1 = row available, 0 = done, -1 = error. */
+int db_stmt_row(sqlite3_stmt *st);
+/* Releases a statement that was not stepped to completion (ends its read transaction). */
+void db_stmt_done(sqlite3_stmt *st);
+
+/* Column readers that never return NULL strings. */
+void db_col_text(sqlite3_stmt *st, int col, char *out, size_t n);
+int db_col_int(sqlite3_stmt *st, int col);
+long long db_col_int64(sqlite3_stmt *st, int col);
+double db_col_double(sqlite3_stmt *st, int col);
+/* Copies a BLOB column of exactly n bytes into out. Returns 0, or -1 for any other type or size. */
+int db_col_blob(sqlite3_stmt *st, int col, void *out, size_t n);
+
+#endif
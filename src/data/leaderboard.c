@@ -0,0 +1,93 @@
+#include "leaderboard.h"
+
+#include <string.h>
+
+static int compare_rows(const leaderboard_row *a, const leaderboard_row *b) {
+    if (a->score != b->score) return a->score > b->score ? -1 : 1;
+    int c = strcmp(a->stamp, b->stamp);
+    if (c) return c;
+    return strcmp(a->name, b->name);
+}
+
+static int rows_equal(const leaderboard_row *a, const leaderboard_row *b) {
+    return a->score == b->score && a->extra[0] == b->extra[0] && a->extra[1] == b->extra[1] &&
+           strcmp(a->name, b->name) == 0 && strcmp(a->stamp, b->stamp) == 0;
+}
+
+static void bump_version(leaderboard *lb) {
+    __atomic_store_n(&lb->version, lb->version + 1, __ATOMIC_RELEASE);
+}
+
+void leaderboard_init(leaderboard *lb, int shown, int cap) {
+    memset(lb, 0, sizeof(*lb));
+    if (cap > LEADERBOARD_ROWS_MAX) cap = LEADERBOARD_ROWS_MAX;
+    if (shown > cap) shown = cap;
+    lb->shown = shown;
+    lb->cap = cap;
+    lb->truncated = 1;
+    lb->stale = 1;
+    lb->version = 1;
+}
+
+void leaderboard_reload(leaderboard *lb, const leaderboard_row *rows, int n) {
+    if (n > lb->cap) n = lb->cap;
+    int changed = 0;
+    int before = lb->count < lb->shown ? lb->count : lb->shown;
+    int after = n < lb->shown ? n : lb->shown;
+    if (before != after) changed = 1;
+    for (int i = 0; i < after && !changed; i++) {
+        if (!rows_equal(&lb->rows[i], &rows[i])) changed = 1;
+    }
+    memcpy(lb->rows, rows, sizeof(leaderboard_row) * (size_t)n);
+    lb->count = n;
+    lb->truncated = n == lb->cap;
+    lb->stale = 0;
+    if (changed) bump_version(lb);
+}
+
+void leaderboard_update(leaderboard *lb, const leaderboard_row *row) {
+    if (lb->stale) return;
+    int old = -1;
+    for (int i = 0; i < lb->count; i++) {
+        if (strcmp(lb->rows[i].name, row->name) == 0) {
+            old = i;
+            break;
+        }
+    }
+    if (old >= 0) {
+        memmove(&lb->rows[old], &lb->rows[old + 1], sizeof(leaderboard_row) * (size_t)(lb->count - old - 1));
+        lb->count--;
+    }
+
+    int pos = 0;
+    while (pos < lb->count && compare_rows(&lb->rows[pos], row) < 0) pos++;
+    /* Ranked below every known row of a truncated board: unknown rows may sit in between. */
+    if (pos == lb->count && lb->truncated) pos = -1;
+    if (pos >= 0) {
+        if (lb->count == lb->cap) {
+            lb->count--;
+            lb->truncated = 1;
+        }
+        memmove(&lb->rows[pos + 1], &lb->rows[pos], sizeof(leaderboard_row) * (size_t)(lb->count - pos));
+        lb->rows[pos] = *row;
+        lb->count++;
+    }
+
+    if ((old >= 0 && old < lb->shown) || (pos >= 0 && pos < lb->shown)) bump_version(lb);
+    if (lb->truncated && lb->count < lb->shown) lb->stale = 1;
+}
+
+void leaderboard_invalidate(leaderboard *lb) {
+    lb->stale = 1;
+}
+
+uint64_t leaderboard_version(const leaderboard *lb) {
+    return __atomic_load_n(&lb->version, __ATOMIC_ACQUIRE);
+}
+
+int leaderboard_copy(const leaderboard *lb, leaderboard_row *out, int max) {
+    int n = lb->count < lb->shown ? lb->count : lb->shown;
+    if (n > max) n = max;
+    memcpy(out, lb->rows, sizeof(leaderboard_row) * (size_t)n);
+    return n;
+}
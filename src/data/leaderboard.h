@@ -0,0 +1,50 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <stdint.h>
+
+#define LEADERBOARD_ROWS_MAX 64
+
+/* Ranked by score descending, then stamp and name ascending, matching the ORDER BY of the
+   table the board mirrors. */
+typedef struct leaderboard_row {
+    char name[128];
+    long long score;
+    char stamp[32];
+    int extra[2];   /* carried along unranked (losses and ties on the users board) */
+} leaderboard_row;
+
+/* In-memory copy of the top of a ranking table. It keeps more rows than it serves, so a
+   served row that drops can usually be replaced without a query. Once fewer than 'shown'
+   known rows remain, the board goes stale and the owner reloads it from the table.
+   Not locked: the owner guards it with the lock of the table it mirrors. */
+typedef struct leaderboard {
+    leaderboard_row rows[LEADERBOARD_ROWS_MAX];
+    int count;
+    int shown;
+    int cap;
+    int truncated;  /* the table may hold rows ranked below rows[count - 1] */
+    int stale;
+    /* Bumped whenever the served rows change; read without the owner's lock. */
+    uint64_t version;
+} leaderboard;
+
+/* Serves the top 'shown' rows and keeps up to 'cap' (at most LEADERBOARD_ROWS_MAX). Starts
+   stale. */
+void leaderboard_init(leaderboard *lb, int shown, int cap);
+
+/* Replaces the board with the table's first rows in rank order; n < lb->cap means the table
+   holds no more. */
+void leaderboard_reload(leaderboard *lb, const leaderboard_row *rows, int n);
+
+/* Applies a row's new values after its table row was written; a new name is inserted. */
+void leaderboard_update(leaderboard *lb, const leaderboard_row *row);
+/* Forces a reload, e.g. after a rolled-back transaction. */
+void leaderboard_invalidate(leaderboard *lb);
+
+uint64_t leaderboard_version(const leaderboard *lb);
+
+/* Copies up to max served rows and returns the count. */
+int leaderboard_copy(const leaderboard *lb, leaderboard_row *out, int max);
+
+#endif
@@ -0,0 +1,424 @@
+#include "rooms.h"
+
+#include "../core/lock.h"
+#include "../core/slab.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define ROOMS_BUCKETS 1024
+/* Two-level expiry wheel at one-second resolution: level 0 holds the next 64 seconds, level 1
+   64-second spans out to ~68 minutes. Later deadlines park in level 1's farthest slot and are
+   re-filed when it cascades. */
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+
+/* Bucket b is guarded by stripe b % ROOMS_STRIPES. */
+static room_record *buckets[ROOMS_BUCKETS];
+static cev_lock stripes[ROOMS_STRIPES] = { [0 ... ROOMS_STRIPES - 1] = CEV_LOCK_INITIALIZER };
+static uint64_t rooms_version_seq = 0;
+/* Set once before serving; see rooms_set_watch_hook. */
+static void (*watch_hook)(int room_id) = NULL;
+
+/* Rooms armed for expiry, by deadline. Lock order: room stripe -> wheel_lock. wheel_now is
+   the next second still to be processed. */
+static room_record *wheel[2][WHEEL_SLOTS];
+static time_t wheel_now;
+static cev_lock wheel_lock = CEV_LOCK_INITIALIZER;
+/* Ids of due rooms, copied out under wheel_lock; only the expiry caller touches it. */
+static int *due_ids = NULL;
+static int due_cap = 0;
+
+/* Write-behind queue of room ids; a room appears at most once while 'queued' is set. */
+static int *dirty_ids = NULL;
+static int dirty_count = 0;
+static int dirty_cap = 0;
+static pthread_mutex_t dirty_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dirty_cond = PTHREAD_COND_INITIALIZER;
+
+static unsigned bucket_of(int room_id) {
+    return ((unsigned)room_id * 2654435761u) % ROOMS_BUCKETS;
+}
+
+static cev_lock *stripe_of(int room_id) {
+    return &stripes[bucket_of(room_id) % ROOMS_STRIPES];
+}
+
+static uint64_t next_version(void) {
+    return __atomic_add_fetch(&rooms_version_seq, 1, __ATOMIC_RELAXED);
+}
+
+static void deadline_after_ms(struct timespec *deadline, int timeout_ms) {
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += timeout_ms / 1000;
+    deadline->tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/* Records come from the slab pools (calloc if they are unavailable). */
+static room_record *alloc_record(void) {
+    room_record *room = cev_slab_alloc(sizeof(room_record));
+    if (!room) return calloc(1, sizeof(room_record));
+    memset(room, 0, sizeof(*room));
+    return room;
+}
+
+static void free_record(room_record *room) {
+    if (cev_slab_owns(room)) cev_slab_free(room);
+    else free(room);
+}
+
+/* Frees a record that is already unlinked, unless long-poll waiters still reference it;
+   the last waiter to leave frees it instead. */
+static void release_room(room_record *room) {
+    uint64_t version = next_version();
+    if (watch_hook) watch_hook(room->room_id);
+    if (room->waiters > 0) {
+        room->removed = 1;
+        room->version = version;
+        pthread_cond_broadcast(&room->changed);
+        return;
+    }
+    pthread_cond_destroy(&room->changed);
+    free_record(room);
+}
+
+/* Call with wheel_lock held. */
+static void wheel_unlink(room_record *room) {
+    if (room->timer_slot < 0) return;
+    if (room->timer_prev) room->timer_prev->timer_next = room->timer_next;
+    else wheel[room->timer_level][room->timer_slot] = room->timer_next;
+    if (room->timer_next) room->timer_next->timer_prev = room->timer_prev;
+    room->timer_prev = NULL;
+    room->timer_next = NULL;
+    room->timer_slot = -1;
+}
+
+/* Call with wheel_lock held. Deadlines already behind the wheel fire on the next tick. */
+static void wheel_link(room_record *room, time_t deadline) {
+    if (deadline < wheel_now) deadline = wheel_now;
+    int level = 0;
+    int slot = (int)(deadline & WHEEL_MASK);
+    if (deadline - wheel_now >= WHEEL_SLOTS) {
+        level = 1;
+        time_t span = deadline >> WHEEL_BITS;
+        time_t last = (wheel_now >> WHEEL_BITS) + WHEEL_MASK;
+        slot = (int)((span < last ? span : last) & WHEEL_MASK);
+    }
+    room->timer_level = level;
+    room->timer_slot = slot;
+    room->timer_prev = NULL;
+    room->timer_next = wheel[level][slot];
+    if (room->timer_next) room->timer_next->timer_prev = room;
+    wheel[level][slot] = room;
+}
+
+static time_t expiry_deadline(const room_record *room) {
+    int timed_out = strcmp(room->status, "timed_out") == 0;
+    return room->last_activity + (timed_out ? ROOMS_IDLE_DROP : ROOMS_IDLE_TIMEOUT);
+}
+
+static void enqueue_dirty(int room_id) {
+    pthread_mutex_lock(&dirty_mutex);
+    if (dirty_count == dirty_cap) {
+        int cap = dirty_cap ? dirty_cap * 2 : 64;
+        int *grown = realloc(dirty_ids, sizeof(int) * (size_t)cap);
+        if (!grown) {
+            pthread_mutex_unlock(&dirty_mutex);
+            return;
+        }
+        dirty_ids = grown;
+        dirty_cap = cap;
+    }
+    dirty_ids[dirty_count++] = room_id;
+    pthread_cond_signal(&dirty_cond);
+    pthread_mutex_unlock(&dirty_mutex);
+}
+
+void rooms_init(void) {
+    for (int s = 0; s < ROOMS_STRIPES; s++) {
+        cev_lock_acquire(&stripes[s]);
+        for (int i = s; i < ROOMS_BUCKETS; i += ROOMS_STRIPES) {
+            room_record *room = buckets[i];
+            while (room) {
+                room_record *next = room->next;
+                cev_lock_acquire(&wheel_lock);
+                wheel_unlink(room);
+                cev_lock_release(&wheel_lock);
+                release_room(room);
+                room = next;
+            }
+            buckets[i] = NULL;
+        }
+        cev_lock_release(&stripes[s]);
+    }
+    cev_lock_acquire(&wheel_lock);
+    if (wheel_now == 0) wheel_now = time(NULL);
+    cev_lock_release(&wheel_lock);
+}
+
+void rooms_lock(int room_id) {
+    cev_lock_acquire(stripe_of(room_id));
+}
+
+void rooms_unlock(int room_id) {
+    cev_lock_release(stripe_of(room_id));
+}
+
+room_record *rooms_lookup(int room_id) {
+    room_record *room = buckets[bucket_of(room_id)];
+    while (room && room->room_id != room_id) room = room->next;
+    return room;
+}
+
+room_record *rooms_create(int room_id) {
+    room_record *room = rooms_lookup(room_id);
+    if (room) return room;
+    room = alloc_record();
+    if (!room) return NULL;
+    room->room_id = room_id;
+    room->version = next_version();
+    pthread_cond_init(&room->changed, NULL);
+    room->turn = BLACK;
+    room->last_activity = time(NULL);
+    strcpy(room->status, "waiting");
+    strcpy(room->mode, "othello");
+    bitboard_init(&room->board, 1);
+    unsigned b = bucket_of(room_id);
+    room->next = buckets[b];
+    buckets[b] = room;
+    room->timer_slot = -1;
+    rooms_arm_expiry(room);
+    return room;
+}
+
+void rooms_arm_expiry(room_record *room) {
+    cev_lock_acquire(&wheel_lock);
+    wheel_unlink(room);
+    wheel_link(room, expiry_deadline(room));
+    cev_lock_release(&wheel_lock);
+}
+
+void rooms_delete(int room_id) {
+    room_record **link = &buckets[bucket_of(room_id)];
+    while (*link && (*link)->room_id != room_id) link = &(*link)->next;
+    if (!*link) return;
+    room_record *room = *link;
+    *link = room->next;
+    cev_lock_acquire(&wheel_lock);
+    wheel_unlink(room);
+    cev_lock_release(&wheel_lock);
+    release_room(room);
+    /* The flusher sees the id without a record and issues the DELETE. */
+    enqueue_dirty(room_id);
+}
+
+void rooms_mark_dirty(room_record *room) {
+    if (!room || room->queued) return;
+    room->queued = 1;
+    enqueue_dirty(room->room_id);
+}
+
+void rooms_publish(room_record *room) {
+    if (!room) return;
+    room->version = next_version();
+    if (room->waiters > 0) pthread_cond_broadcast(&room->changed);
+    if (watch_hook) watch_hook(room->room_id);
+}
+
+void rooms_set_watch_hook(void (*hook)(int room_id)) {
+    watch_hook = hook;
+}
+
+uint64_t rooms_generation(void) {
+    return __atomic_load_n(&rooms_version_seq, __ATOMIC_RELAXED);
+}
+
+uint64_t rooms_wait_version(int room_id, uint64_t since, int timeout_ms) {
+    cev_lock *stripe = stripe_of(room_id);
+    cev_lock_acquire(stripe);
+    room_record *room = rooms_lookup(room_id);
+    if (!room) {
+        cev_lock_release(stripe);
+        return 0;
+    }
+    if (room->version <= since && timeout_ms > 0) {
+        struct timespec deadline;
+        deadline_after_ms(&deadline, timeout_ms);
+        room->waiters++;
+        while (room->version <= since && !room->removed) {
+            if (pthread_cond_timedwait(&room->changed, &stripe->mutex, &deadline) == ETIMEDOUT) break;
+        }
+        room->waiters--;
+        if (room->removed) {
+            if (room->waiters == 0) {
+                pthread_cond_destroy(&room->changed);
+                free_record(room);
+            }
+            cev_lock_release(stripe);
+            return 0;
+        }
+    }
+    uint64_t version = room->version;
+    cev_lock_release(stripe);
+    return version;
+}
+
+/* Keeps out[0..n) the n lowest room ids seen so far, in order; n stops growing at max. */
+static int keep_lowest(room_summary *out, int n, int max, const room_record *room) {
+    int at = n;
+    while (at > 0 && out[at - 1].room_id > room->room_id) at--;
+    if (at == max) return n;
+    if (n == max) n--;
+    memmove(&out[at + 1], &out[at], sizeof(room_summary) * (size_t)(n - at));
+    room_summary *row = &out[at];
+    row->room_id = room->room_id;
+    row->players = room->players;
+    row->last_activity = room->last_activity;
+    memcpy(row->status, room->status, sizeof(row->status));
+    memcpy(row->mode, room->mode, sizeof(row->mode));
+    return n + 1;
+}
+
+int rooms_snapshot(room_summary *out, int max) {
+    int n = 0;
+    if (max <= 0) return 0;
+    for (int s = 0; s < ROOMS_STRIPES; s++) {
+        cev_lock_acquire(&stripes[s]);
+        for (int i = s; i < ROOMS_BUCKETS; i += ROOMS_STRIPES) {
+            for (room_record *room = buckets[i]; room; room = room->next) n = keep_lowest(out, n, max, room);
+        }
+        cev_lock_release(&stripes[s]);
+    }
+    return n;
+}
+
+/* Call with wheel_lock held. Moves a due slot's rooms into due_ids, leaving them unarmed. */
+static int collect_due(room_record **slot, int n) {
+    while (*slot) {
+        if (n == due_cap) {
+            int cap = due_cap ? due_cap * 2 : 64;
+            int *grown = realloc(due_ids, sizeof(int) * (size_t)cap);
+            if (!grown) {
+                /* Retry the rest of the slot next tick rather than a wheel revolution later. */
+                while (*slot) {
+                    room_record *room = *slot;
+                    wheel_unlink(room);
+                    wheel_link(room, wheel_now + 1);
+                }
+                break;
+            }
+            due_ids = grown;
+            due_cap = cap;
+        }
+        room_record *room = *slot;
+        wheel_unlink(room);
+        due_ids[n++] = room->room_id;
+    }
+    return n;
+}
+
+int rooms_expire_due(time_t now, void (*on_drop)(int room_id)) {
+    int n = 0;
+    cev_lock_acquire(&wheel_lock);
+    if (wheel_now == 0) wheel_now = now;
+    while (wheel_now <= now) {
+        if ((wheel_now & WHEEL_MASK) == 0) {
+            room_record **span = &wheel[1][(wheel_now >> WHEEL_BITS) & WHEEL_MASK];
+            room_record *room = *span;
+            *span = NULL;
+            while (room) {
+                room_record *next = room->timer_next;
+                room->timer_slot = -1;
+                wheel_link(room, expiry_deadline(room));
+                room = next;
+            }
+        }
+        n = collect_due(&wheel[0][wheel_now & WHEEL_MASK], n);
+        wheel_now++;
+    }
+    cev_lock_release(&wheel_lock);
+
+    /* A due room may have seen activity since it was armed; it is then just re-armed. */
+    int dropped = 0;
+    for (int i = 0; i < n; i++) {
+        int room_id = due_ids[i];
+        cev_lock *stripe = stripe_of(room_id);
+        cev_lock_acquire(stripe);
+        room_record **link = &buckets[bucket_of(room_id)];
+        while (*link && (*link)->room_id != room_id) link = &(*link)->next;
+        room_record *room = *link;
+        int drop = room && now >= room->last_activity + ROOMS_IDLE_DROP;
+        if (drop) {
+            *link = room->next;
+            cev_lock_acquire(&wheel_lock);
+            wheel_unlink(room);
+            cev_lock_release(&wheel_lock);
+            enqueue_dirty(room_id);
+            release_room(room);
+        } else if (room) {
+            if (now >= room->last_activity + ROOMS_IDLE_TIMEOUT && strcmp(room->status, "timed_out") != 0) {
+                strcpy(room->status, "timed_out");
+                rooms_mark_dirty(room);
+                rooms_publish(room);
+            }
+            rooms_arm_expiry(room);
+        }
+        cev_lock_release(stripe);
+        if (drop) {
+            dropped++;
+            if (on_drop) on_drop(room_id);
+        }
+    }
+    return dropped;
+}
+
+int rooms_take_dirty(int *ids, int max, int timeout_ms) {
+    pthread_mutex_lock(&dirty_mutex);
+    if (dirty_count == 0 && timeout_ms > 0) {
+        struct timespec deadline;
+        deadline_after_ms(&deadline, timeout_ms);
+        while (dirty_count == 0) {
+            if (pthread_cond_timedwait(&dirty_cond, &dirty_mutex, &deadline) == ETIMEDOUT) break;
+        }
+    }
+    int n = dirty_count < max ? dirty_count : max;
+    memcpy(ids, dirty_ids, sizeof(int) * (size_t)n);
+    memmove(dirty_ids, dirty_ids + n, sizeof(int) * (size_t)(dirty_count - n));
+    dirty_count -= n;
+    pthread_mutex_unlock(&dirty_mutex);
+    return n;
+}
+
+void rooms_stripe_stats(int stripe, uint64_t *acquired, uint64_t *contended, uint64_t *waited_ns) {
+    if (stripe < 0 || stripe >= ROOMS_STRIPES) {
+        *acquired = 0;
+        *contended = 0;
+        *waited_ns = 0;
+        return;
+    }
+    *acquired = cev_lock_acquired(&stripes[stripe]);
+    *contended = cev_lock_contended(&stripes[stripe]);
+    *waited_ns = cev_lock_waited_ns(&stripes[stripe]);
+}
+
+void rooms_count(int *rooms, int *players) {
+    *rooms = 0;
+    *players = 0;
+    for (int s = 0; s < ROOMS_STRIPES; s++) {
+        cev_lock_acquire(&stripes[s]);
+        for (int i = s; i < ROOMS_BUCKETS; i += ROOMS_STRIPES) {
+            for (room_record *room = buckets[i]; room; room = room->next) {
+                (*rooms)++;
+                *players += room->players;
+            }
+        }
+        cev_lock_release(&stripes[s]);
+    }
+}
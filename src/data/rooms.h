@@ -0,0 +1,100 @@
+#ifndef ROOMS_H
+#define ROOMS_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../game/bitboard.h"
+
+/* Authoritative in-memory copy of a multiplayer room. The games table is
+   only a write-behind mirror of these records. */
+typedef struct room_record {
+    int room_id;
+    int turn;
+    int players;
+    int user1_id;
+    int user2_id;
+    bitboard board;
+    time_t last_activity;
+    char status[16];
+    char mode[16];
+    /* Drawn from a table-wide counter, so a recreated room never reuses an old version. */
+    uint64_t version;
+    int queued;
+    int waiters;
+    int removed;
+    pthread_cond_t changed;
+    struct room_record *next;
+    /* Expiry timer-wheel links, guarded by the wheel lock rather than the stripe. */
+    struct room_record *timer_prev;
+    struct room_record *timer_next;
+    int timer_level;
+    int timer_slot; /* -1 while unarmed */
+} room_record;
+
+/* What a room listing shows of a record. */
+typedef struct room_summary {
+    int room_id;
+    int players;
+    time_t last_activity;
+    char status[16];
+    char mode[16];
+} room_summary;
+
+#define ROOMS_STRIPES 64
+/* An idle room turns 'timed_out' after ROOMS_IDLE_TIMEOUT seconds and is dropped after
+   ROOMS_IDLE_DROP. */
+#define ROOMS_IDLE_TIMEOUT (10 * 60)
+#define ROOMS_IDLE_DROP (11 * 60)
+
+void rooms_init(void);
+
+/* The table is lock-striped by room_id. Every lookup/modify below needs the stripe of the
+   room it touches; hold at most one stripe at a time. */
+void rooms_lock(int room_id);
+void rooms_unlock(int room_id);
+
+room_record *rooms_lookup(int room_id);
+/* Inserts a zeroed record (status 'waiting', othello mode) or returns the existing one.
+   New records are armed for expiry. */
+room_record *rooms_create(int room_id);
+/* Re-arms the expiry timer from last_activity. Activity only ever pushes last_activity
+   forward, and a timer that fires early re-arms itself, so this is needed only when
+   last_activity moves backwards (rooms loaded from disk). */
+void rooms_arm_expiry(room_record *room);
+void rooms_delete(int room_id);
+/* Queues the room for the write-behind flusher; call after modifying a record. */
+void rooms_mark_dirty(room_record *room);
+/* Gives the room a new version and wakes its long-poll waiters; call after a visible state change. */
+void rooms_publish(room_record *room);
+
+/* hook(room_id) runs whenever a room is published or removed, with its stripe held; it must
+   not take a stripe or any domain lock. Set once before serving. */
+void rooms_set_watch_hook(void (*hook)(int room_id));
+
+/* Blocks until room_id's version exceeds since, the room disappears, or timeout_ms passes.
+   Takes the stripe itself; returns the current version (0 if the room does not exist). */
+uint64_t rooms_wait_version(int room_id, uint64_t since, int timeout_ms);
+
+/* Moves whenever any room is created, published or removed, so it versions rooms_snapshot's
+   output. Lock-free. */
+uint64_t rooms_generation(void);
+/* Fills out with the summaries of the max lowest-numbered rooms, ordered by room_id. Takes
+   each stripe in turn and copies only the listed fields. */
+int rooms_snapshot(room_summary *out, int max);
+/* Advances the expiry wheel to now and handles only the rooms whose deadline passed: times
+   them out, or drops them and calls on_drop(room_id) with no lock held. Returns the number of
+   dropped rooms. Call about once a second. */
+int rooms_expire_due(time_t now, void (*on_drop)(int room_id));
+
+/* Flusher side: blocks until dirty ids exist (or timeout_ms passes) and moves up to max of them into ids. */
+int rooms_take_dirty(int *ids, int max, int timeout_ms);
+
+/* Acquisition, contention and wait-time counters of one stripe, for /admin/locks. */
+void rooms_stripe_stats(int stripe, uint64_t *acquired, uint64_t *contended, uint64_t *waited_ns);
+
+/* Resident rooms and the players seated in them. Takes each stripe in turn. */
+void rooms_count(int *rooms, int *players);
+
+#endif
@@ -0,0 +1,388 @@
+#include "ai.h"
+
+#include "ai_pool.h"
+#include "endgame.h"
+#include "tt.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define AI_INF 1000000
+/* Finished games score beyond any heuristic value, by disc margin. */
+#define AI_WIN_SCORE 100000
+#define AI_MOBILITY_WEIGHT 4
+/* Check the clock this often (in nodes); must be a power of two. */
+#define AI_CLOCK_INTERVAL 1024
+/* /ai/move searches client-supplied boards, so a move list must hold any 64-bit move mask. */
+#define AI_MAX_MOVES 64
+
+/* Positional square weights, same table the browser bot used for its "hard" level. */
+static const int square_weight[64] = {
+    100, -25,  10,   5,   5,  10, -25, 100,
+    -25, -40,  -3,  -3,  -3,  -3, -40, -25,
+     10,  -3,   2,   2,   2,   2,  -3,  10,
+      5,  -3,   2,   1,   1,   2,  -3,   5,
+      5,  -3,   2,   1,   1,   2,  -3,   5,
+     10,  -3,   2,   2,   2,   2,  -3,  10,
+    -25, -40,  -3,  -3,  -3,  -3, -40, -25,
+    100, -25,  10,   5,   5,  10, -25, 100,
+};
+
+typedef struct ai_ctx {
+    uint64_t deadline_ns;
+    /* Set by any task of the same search that ran out of time; NULL for none. */
+    const int *stop;
+    uint64_t nodes;
+    int aborted;
+    tt_counters tt;
+} ai_ctx;
+
+typedef struct root_search root_search;
+
+/* A younger brother at the root: searched on whichever worker steals it. */
+typedef struct root_sibling {
+    ai_task task;
+    root_search *root;
+    int move;
+} root_sibling;
+
+/* One /ai/move request. Young Brothers Wait at the root: every iteration searches the eldest
+   (best-ordered) move alone to get a bound, then its siblings in parallel against that bound. */
+struct root_search {
+    ai_task task;
+    bitboard board;
+    int player;
+    uint64_t key;
+    uint64_t mask;
+    int max_depth;
+    int solve_empties;
+    uint64_t deadline_ns;
+    ai_result *out;
+
+    /* Shared by the siblings of the current iteration. */
+    pthread_mutex_t lock;
+    int depth;
+    int alpha;
+    int best_move;
+    int pending;
+    int stop;
+    uint64_t nodes;
+    root_sibling siblings[AI_MAX_MOVES];
+
+    /* Handshake with the request thread when the search runs on the pool. */
+    pthread_cond_t done_cond;
+    int done;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t own_of(const bitboard *b, int p) {
+    return p == BLACK ? b->black : b->white;
+}
+
+static int positional(uint64_t discs) {
+    int score = 0;
+    while (discs) {
+        score += square_weight[__builtin_ctzll(discs)];
+        discs &= discs - 1;
+    }
+    return score;
+}
+
+static int evaluate(const bitboard *b, int p) {
+    int opp = BITBOARD_OPPONENT(p);
+    int score = positional(own_of(b, p)) - positional(own_of(b, opp));
+    int mobility = __builtin_popcountll(bitboard_legal_moves(b, p)) -
+                   __builtin_popcountll(bitboard_legal_moves(b, opp));
+    return score + AI_MOBILITY_WEIGHT * mobility;
+}
+
+static int final_score(const bitboard *b, int p) {
+    int diff = bitboard_count(b, p) - bitboard_count(b, BITBOARD_OPPONENT(p));
+    if (diff > 0) return AI_WIN_SCORE + diff;
+    if (diff < 0) return -AI_WIN_SCORE + diff;
+    return 0;
+}
+
+/* Expands a move mask into squares, best static square first, with hint (if legal) in front. */
+static int order_moves(uint64_t mask, int hint, int *moves) {
+    int n = 0;
+    while (mask) {
+        int sq = __builtin_ctzll(mask);
+        mask &= mask - 1;
+        int key = (sq == hint) ? AI_INF : square_weight[sq];
+        int i = n++;
+        while (i > 0) {
+            int prev = moves[i - 1];
+            int prev_key = (prev == hint) ? AI_INF : square_weight[prev];
+            if (prev_key >= key) break;
+            moves[i] = prev;
+            i--;
+        }
+        moves[i] = sq;
+    }
+    return n;
+}
+
+static int negamax(ai_ctx *ctx, const bitboard *b, uint64_t key, int p, int depth, int alpha, int beta) {
+    ctx->nodes++;
+    if ((ctx->nodes & (AI_CLOCK_INTERVAL - 1)) == 0 &&
+        (now_ns() >= ctx->deadline_ns || (ctx->stop && __atomic_load_n(ctx->stop, __ATOMIC_RELAXED)))) {
+        ctx->aborted = 1;
+    }
+    if (ctx->aborted) return 0;
+
+    int opp = BITBOARD_OPPONENT(p);
+    uint64_t mask = bitboard_legal_moves(b, p);
+    if (!mask) {
+        if (!bitboard_has_moves(b, opp)) return final_score(b, p);
+        if (depth == 0) return evaluate(b, p);
+        /* A pass does not use up a ply: the opponent is guaranteed a move. */
+        return -negamax(ctx, b, tt_hash_pass(key), opp, depth, -beta, -alpha);
+    }
+    if (depth == 0) return evaluate(b, p);
+
+    int hint = -1;
+    tt_entry hit;
+    if (tt_probe(key, &hit, &ctx->tt)) {
+        hint = hit.move;
+        if (hit.depth >= depth) {
+            if (hit.bound == TT_EXACT) return hit.score;
+            if (hit.bound == TT_LOWER && hit.score > alpha) alpha = hit.score;
+            else if (hit.bound == TT_UPPER && hit.score < beta) beta = hit.score;
+            if (alpha >= beta) return hit.score;
+        }
+    }
+
+    int alpha_orig = alpha;
+    int moves[AI_MAX_MOVES];
+    int n = order_moves(mask, hint, moves);
+    int best = -AI_INF;
+    int best_move = moves[0];
+    for (int i = 0; i < n; i++) {
+        bitboard child = *b;
+        uint64_t flips = bitboard_apply_move(&child, p, moves[i]);
+        int score = -negamax(ctx, &child, tt_hash_move(key, p, moves[i], flips), opp, depth - 1, -beta, -alpha);
+        if (ctx->aborted) return 0;
+        if (score > best) {
+            best = score;
+            best_move = moves[i];
+        }
+        if (best > alpha) alpha = best;
+        if (alpha >= beta) break;
+    }
+
+    int bound = best <= alpha_orig ? TT_UPPER : (best >= beta ? TT_LOWER : TT_EXACT);
+    tt_store(key, depth, bound, best, best_move, &ctx->tt);
+    return best;
+}
+
+static const char *difficulty_names[] = { "easy", "medium", "hard" };
+
+int ai_parse_difficulty(const char *name, ai_difficulty *out) {
+    if (!name) return -1;
+    for (int i = 0; i <= AI_HARD; i++) {
+        if (strcmp(name, difficulty_names[i]) == 0) {
+            *out = (ai_difficulty)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *ai_difficulty_name(ai_difficulty d) {
+    return (d >= AI_EASY && d <= AI_HARD) ? difficulty_names[d] : "medium";
+}
+
+void ai_limits_for(ai_difficulty d, ai_limits *out) {
+    switch (d) {
+    case AI_EASY:
+        out->max_depth = 2;
+        out->time_ms = 50;
+        out->random_pct = 20;
+        out->solve_empties = 0;
+        break;
+    case AI_HARD:
+        out->max_depth = 12;
+        out->time_ms = 800;
+        out->random_pct = 0;
+        out->solve_empties = 16;
+        break;
+    case AI_MEDIUM:
+    default:
+        out->max_depth = 4;
+        out->time_ms = 150;
+        out->random_pct = 0;
+        out->solve_empties = 10;
+        break;
+    }
+}
+
+static int search_child(ai_ctx *ctx, const root_search *rs, int move, int depth, int alpha) {
+    bitboard child = rs->board;
+    uint64_t flips = bitboard_apply_move(&child, rs->player, move);
+    uint64_t key = tt_hash_move(rs->key, rs->player, move, flips);
+    return -negamax(ctx, &child, key, BITBOARD_OPPONENT(rs->player), depth - 1, -AI_INF, -alpha);
+}
+
+static void run_sibling(ai_task *task) {
+    root_sibling *sib = (root_sibling *)task;
+    root_search *rs = sib->root;
+    ai_ctx ctx = { .deadline_ns = rs->deadline_ns, .stop = &rs->stop };
+    int alpha = __atomic_load_n(&rs->alpha, __ATOMIC_RELAXED);
+    int score = search_child(&ctx, rs, sib->move, rs->depth, alpha);
+
+    if (ctx.aborted) {
+        __atomic_store_n(&rs->stop, 1, __ATOMIC_RELAXED);
+    } else {
+        pthread_mutex_lock(&rs->lock);
+        if (score > rs->alpha) {
+            __atomic_store_n(&rs->alpha, score, __ATOMIC_RELAXED);
+            rs->best_move = sib->move;
+        }
+        pthread_mutex_unlock(&rs->lock);
+    }
+    tt_add_counters(&ctx.tt);
+    __atomic_add_fetch(&rs->nodes, ctx.nodes, __ATOMIC_RELAXED);
+    ai_pool_task_done(&rs->pending);
+}
+
+/* Solves the position exactly when it is close enough to the end. The solver gets three quarters
+   of the remaining time; if it runs out, the heuristic search below uses the rest. */
+static int solve_endgame(root_search *rs) {
+    if (64 - bitboard_count_all(&rs->board) > rs->solve_empties) return 0;
+    uint64_t now = now_ns();
+    if (now >= rs->deadline_ns) return 0;
+
+    endgame_result eg;
+    int budget_ms = (int)((rs->deadline_ns - now) / 1000000ULL * 3 / 4);
+    int rc = endgame_solve(&rs->board, rs->player, budget_ms, 0, &eg);
+    __atomic_add_fetch(&rs->nodes, eg.nodes, __ATOMIC_RELAXED);
+    if (rc != 0 || eg.move < 0) return 0;
+
+    ai_result *out = rs->out;
+    out->move = eg.move;
+    out->score = eg.score > 0 ? AI_WIN_SCORE + eg.score : eg.score < 0 ? -AI_WIN_SCORE + eg.score : 0;
+    out->depth = eg.empties;
+    out->solved = 1;
+    return 1;
+}
+
+/* Iterative deepening over the root moves. With parallel set (only on a pool worker) the younger
+   brothers of each iteration are spawned for other workers to steal. */
+static void search_root(root_search *rs, int parallel) {
+    ai_ctx ctx = { .deadline_ns = rs->deadline_ns, .stop = &rs->stop };
+    ai_result *out = rs->out;
+    int moves[AI_MAX_MOVES];
+
+    if (solve_endgame(rs)) return;
+
+    for (int depth = 1; depth <= rs->max_depth; depth++) {
+        int n = order_moves(rs->mask, out->move, moves);
+        int score = search_child(&ctx, rs, moves[0], depth, -AI_INF);
+        if (ctx.aborted) break;
+        rs->depth = depth;
+        rs->alpha = score;
+        rs->best_move = moves[0];
+
+        if (parallel) {
+            rs->pending = n - 1;
+            for (int i = 1; i < n; i++) {
+                root_sibling *sib = &rs->siblings[i];
+                sib->task.run = run_sibling;
+                sib->root = rs;
+                sib->move = moves[i];
+                if (ai_pool_spawn(&sib->task) != 0) run_sibling(&sib->task);
+            }
+            ai_pool_help_until_zero(&rs->pending);
+            if (__atomic_load_n(&rs->stop, __ATOMIC_RELAXED)) break;
+        } else {
+            for (int i = 1; i < n; i++) {
+                score = search_child(&ctx, rs, moves[i], depth, rs->alpha);
+                if (ctx.aborted) break;
+                if (score > rs->alpha) {
+                    rs->alpha = score;
+                    rs->best_move = moves[i];
+                }
+            }
+            if (ctx.aborted) break;
+        }
+
+        out->move = rs->best_move;
+        out->score = rs->alpha;
+        out->depth = depth;
+        /* A proven result cannot change with more depth. */
+        if (rs->alpha >= AI_WIN_SCORE || rs->alpha <= -AI_WIN_SCORE) break;
+    }
+
+    tt_add_counters(&ctx.tt);
+    __atomic_add_fetch(&rs->nodes, ctx.nodes, __ATOMIC_RELAXED);
+}
+
+static void run_root(ai_task *task) {
+    root_search *rs = (root_search *)task;
+    /* A job that waited in the queue past its deadline answers with the best-ordered move. */
+    if (now_ns() < rs->deadline_ns) search_root(rs, 1);
+    pthread_mutex_lock(&rs->lock);
+    rs->done = 1;
+    pthread_cond_signal(&rs->done_cond);
+    pthread_mutex_unlock(&rs->lock);
+}
+
+void ai_search(const bitboard *b, int player, const ai_limits *limits, ai_result *out) {
+    uint64_t start = now_ns();
+    memset(out, 0, sizeof(*out));
+    out->move = -1;
+
+    uint64_t mask = bitboard_legal_moves(b, player);
+    if (!mask) return;
+
+    int moves[AI_MAX_MOVES];
+    int n = order_moves(mask, -1, moves);
+    out->move = moves[0];
+    if (n == 1) return;
+    if (limits->random_pct > 0 && rand() % 100 < limits->random_pct) {
+        out->move = moves[rand() % n];
+        return;
+    }
+
+    root_search rs;
+    memset(&rs, 0, sizeof(rs));
+    rs.board = *b;
+    rs.player = player;
+    rs.key = tt_hash(b, player);
+    rs.mask = mask;
+    int empties = 64 - bitboard_count_all(b);
+    rs.max_depth = limits->max_depth < empties ? limits->max_depth : empties;
+    rs.solve_empties = limits->solve_empties;
+    rs.deadline_ns = start + (uint64_t)limits->time_ms * 1000000ULL;
+    rs.out = out;
+    pthread_mutex_init(&rs.lock, NULL);
+    pthread_cond_init(&rs.done_cond, NULL);
+    tt_new_search();
+
+    if (ai_pool_size() > 0 && !ai_pool_in_worker()) {
+        rs.task.run = run_root;
+        rs.task.deadline_ns = rs.deadline_ns;
+        if (ai_pool_submit(&rs.task) == 0) {
+            pthread_mutex_lock(&rs.lock);
+            while (!rs.done) pthread_cond_wait(&rs.done_cond, &rs.lock);
+            pthread_mutex_unlock(&rs.lock);
+        } else {
+            search_root(&rs, 0);
+        }
+    } else {
+        search_root(&rs, ai_pool_in_worker());
+    }
+
+    pthread_cond_destroy(&rs.done_cond);
+    pthread_mutex_destroy(&rs.lock);
+    out->nodes = rs.nodes;
+    out->elapsed_ms = (int)((now_ns() - start) / 1000000ULL);
+}
@@ -0,0 +1,42 @@
+#ifndef AI_H
+#define AI_H
+
+#include <stdint.h>
+
+#include "bitboard.h"
+
+typedef enum ai_difficulty {
+    AI_EASY,
+    AI_MEDIUM,
+    AI_HARD
+} ai_difficulty;
+
+/* Search budget. The search stops at max_depth or when time_ms runs out, whichever comes first. */
+typedef struct ai_limits {
+    int max_depth;
+    int time_ms;
+    /* Percent chance of playing a random legal move instead of searching. */
+    int random_pct;
+    /* At this many empties or fewer the position is solved exactly first (0 = never). */
+    int solve_empties;
+} ai_limits;
+
+typedef struct ai_result {
+    int move;           /* square index, or -1 when the side to move must pass */
+    int score;          /* from the mover's point of view */
+    int depth;          /* deepest fully searched iteration (the empties when solved) */
+    int solved;         /* score is the exact final margin, reported on the search scale */
+    uint64_t nodes;
+    int elapsed_ms;
+} ai_result;
+
+/* Accepts "easy", "medium" or "hard". Returns 0 on success, -1 for anything else. */
+int ai_parse_difficulty(const char *name, ai_difficulty *out);
+const char *ai_difficulty_name(ai_difficulty d);
+void ai_limits_for(ai_difficulty d, ai_limits *out);
+
+/* Iterative-deepening alpha-beta for player on b. Uses the bitboard rules, so every move it
+   returns is one move_handler accepts. */
+void ai_search(const bitboard *b, int player, const ai_limits *limits, ai_result *out);
+
+#endif
@@ -0,0 +1,243 @@
+#include "ai_pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#define AI_POOL_MAX_WORKERS 256
+/* Per-worker deque capacity; a root split pushes at most one task per legal move. */
+#define AI_DEQUE_CAP 256
+#define AI_SUBMIT_CAP 1024
+
+/* Owner pushes and pops at tail (LIFO, cache-warm); thieves take from head (oldest, largest). */
+typedef struct ai_deque {
+    pthread_mutex_t lock;
+    unsigned head;
+    unsigned tail;
+    ai_task *slots[AI_DEQUE_CAP];
+} __attribute__((aligned(64))) ai_deque;
+
+typedef struct ai_worker {
+    pthread_t tid;
+    unsigned rng;
+    ai_deque deque;
+} ai_worker;
+
+static ai_worker *workers = NULL;
+static int worker_count = 0;
+static int running = 0;
+static int idle_workers = 0;
+/* Bumped under pool_lock whenever a task is queued anywhere. An idle worker reads it before
+   looking for work and sleeps only while it is unchanged, so no wakeup can be missed. */
+static unsigned long work_seq = 0;
+
+/* Root jobs from request threads: a binary min-heap on deadline_ns. */
+static ai_task *submit_heap[AI_SUBMIT_CAP];
+static int submit_count = 0;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+/* Workers blocked in ai_pool_help_until_zero wait here for a task group to drain. */
+static pthread_mutex_t group_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t group_cond = PTHREAD_COND_INITIALIZER;
+
+static __thread int self_index = -1;
+
+static void heap_push(ai_task *task) {
+    int i = submit_count++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (submit_heap[parent]->deadline_ns <= task->deadline_ns) break;
+        submit_heap[i] = submit_heap[parent];
+        i = parent;
+    }
+    submit_heap[i] = task;
+}
+
+static ai_task *heap_pop(void) {
+    if (submit_count == 0) return NULL;
+    ai_task *top = submit_heap[0];
+    ai_task *last = submit_heap[--submit_count];
+    int i = 0;
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= submit_count) break;
+        if (child + 1 < submit_count && submit_heap[child + 1]->deadline_ns < submit_heap[child]->deadline_ns) child++;
+        if (last->deadline_ns <= submit_heap[child]->deadline_ns) break;
+        submit_heap[i] = submit_heap[child];
+        i = child;
+    }
+    if (submit_count > 0) submit_heap[i] = last;
+    return top;
+}
+
+static int deque_push(ai_deque *dq, ai_task *task) {
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail - dq->head == AI_DEQUE_CAP) {
+        pthread_mutex_unlock(&dq->lock);
+        return -1;
+    }
+    dq->slots[dq->tail % AI_DEQUE_CAP] = task;
+    __atomic_store_n(&dq->tail, dq->tail + 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&dq->lock);
+    return 0;
+}
+
+static ai_task *deque_pop(ai_deque *dq) {
+    ai_task *task = NULL;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail != dq->head) {
+        __atomic_store_n(&dq->tail, dq->tail - 1, __ATOMIC_RELAXED);
+        task = dq->slots[dq->tail % AI_DEQUE_CAP];
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return task;
+}
+
+static ai_task *deque_steal(ai_deque *dq) {
+    ai_task *task = NULL;
+    if (__atomic_load_n(&dq->tail, __ATOMIC_RELAXED) == __atomic_load_n(&dq->head, __ATOMIC_RELAXED)) return NULL;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail != dq->head) {
+        task = dq->slots[dq->head % AI_DEQUE_CAP];
+        __atomic_store_n(&dq->head, dq->head + 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return task;
+}
+
+/* Own deque first, then every other worker starting from a random victim. */
+static ai_task *find_subtask(int self) {
+    ai_worker *me = &workers[self];
+    ai_task *task = deque_pop(&me->deque);
+    if (task || worker_count < 2) return task;
+    me->rng = me->rng * 1103515245u + 12345u;
+    int start = (int)((me->rng >> 16) % (unsigned)worker_count);
+    for (int i = 0; i < worker_count; i++) {
+        int victim = (start + i) % worker_count;
+        if (victim == self) continue;
+        task = deque_steal(&workers[victim].deque);
+        if (task) return task;
+    }
+    return NULL;
+}
+
+/* Caller holds pool_lock. */
+static void work_queued(void) {
+    __atomic_store_n(&work_seq, work_seq + 1, __ATOMIC_RELEASE);
+    if (idle_workers > 0) pthread_cond_signal(&pool_cond);
+}
+
+static void *worker_main(void *arg) {
+    self_index = (int)(intptr_t)arg;
+    while (1) {
+        unsigned long seen = __atomic_load_n(&work_seq, __ATOMIC_ACQUIRE);
+        ai_task *task = find_subtask(self_index);
+        if (!task) {
+            pthread_mutex_lock(&pool_lock);
+            task = heap_pop();
+            idle_workers++;
+            while (!task && running && work_seq == seen) {
+                pthread_cond_wait(&pool_cond, &pool_lock);
+                task = heap_pop();
+            }
+            idle_workers--;
+            int stop = !running;
+            pthread_mutex_unlock(&pool_lock);
+            if (stop) break;
+        }
+        if (task) task->run(task);
+    }
+    return NULL;
+}
+
+int ai_pool_start(int threads) {
+    if (threads <= 0 || workers) return worker_count;
+    if (threads > AI_POOL_MAX_WORKERS) threads = AI_POOL_MAX_WORKERS;
+    workers = calloc((size_t)threads, sizeof(ai_worker));
+    if (!workers) return 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_mutex_init(&workers[i].deque.lock, NULL);
+        workers[i].rng = 0x9e3779b9u * (unsigned)(i + 1);
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    running = 1;
+    worker_count = threads;
+    pthread_mutex_unlock(&pool_lock);
+
+    int started = 0;
+    for (; started < threads; started++) {
+        if (pthread_create(&workers[started].tid, NULL, worker_main, (void *)(intptr_t)started) != 0) break;
+    }
+    if (started < threads) {
+        /* Workers index the array by worker_count, so shrink only after the rest are gone. */
+        ai_pool_stop();
+        return 0;
+    }
+    return started;
+}
+
+void ai_pool_stop(void) {
+    if (!workers) return;
+    pthread_mutex_lock(&pool_lock);
+    running = 0;
+    pthread_cond_broadcast(&pool_cond);
+    pthread_mutex_unlock(&pool_lock);
+    for (int i = 0; i < worker_count; i++) {
+        if (workers[i].tid) pthread_join(workers[i].tid, NULL);
+        pthread_mutex_destroy(&workers[i].deque.lock);
+    }
+    free(workers);
+    workers = NULL;
+    worker_count = 0;
+    submit_count = 0;
+}
+
+int ai_pool_size(void) {
+    return worker_count;
+}
+
+int ai_pool_in_worker(void) {
+    return self_index >= 0;
+}
+
+int ai_pool_submit(ai_task *task) {
+    pthread_mutex_lock(&pool_lock);
+    if (!running || submit_count == AI_SUBMIT_CAP) {
+        pthread_mutex_unlock(&pool_lock);
+        return -1;
+    }
+    heap_push(task);
+    work_queued();
+    pthread_mutex_unlock(&pool_lock);
+    return 0;
+}
+
+int ai_pool_spawn(ai_task *task) {
+    if (self_index < 0 || deque_push(&workers[self_index].deque, task) != 0) return -1;
+    pthread_mutex_lock(&pool_lock);
+    work_queued();
+    pthread_mutex_unlock(&pool_lock);
+    return 0;
+}
+
+void ai_pool_task_done(int *pending) {
+    if (__atomic_sub_fetch(pending, 1, __ATOMIC_RELEASE) > 0) return;
+    pthread_mutex_lock(&group_lock);
+    pthread_cond_broadcast(&group_cond);
+    pthread_mutex_unlock(&group_lock);
+}
+
+/* Only the caller pushes its group's tasks, so once its own deque is empty and nothing else is
+   stealable, every task left in the group is running elsewhere: sleep until the last one is done. */
+void ai_pool_help_until_zero(int *pending) {
+    while (__atomic_load_n(pending, __ATOMIC_ACQUIRE) > 0) {
+        ai_task *task = find_subtask(self_index);
+        if (task) {
+            task->run(task);
+            continue;
+        }
+        pthread_mutex_lock(&group_lock);
+        while (__atomic_load_n(pending, __ATOMIC_ACQUIRE) > 0) pthread_cond_wait(&group_cond, &group_lock);
+        pthread_mutex_unlock(&group_lock);
+    }
+}
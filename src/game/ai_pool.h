@@ -0,0 +1,34 @@
+#ifndef AI_POOL_H
+#define AI_POOL_H
+
+#include <stdint.h>
+
+/* Unit of work. The pool never allocates tasks; callers embed them in their own structs
+   and keep them alive until run() has returned. */
+typedef struct ai_task {
+    void (*run)(struct ai_task *task);
+    /* Root jobs only: absolute CLOCK_MONOTONIC deadline used to order the submit queue. */
+    uint64_t deadline_ns;
+} ai_task;
+
+/* Starts threads workers (0 leaves the pool off; searches then run on the caller's thread).
+   Returns the number of workers started. */
+int ai_pool_start(int threads);
+/* Stops and joins every worker. Tasks still queued are dropped, so only call it while idle. */
+void ai_pool_stop(void);
+int ai_pool_size(void);
+/* 1 when called from one of the pool's worker threads. */
+int ai_pool_in_worker(void);
+
+/* From any thread: queues a root job. Jobs are taken earliest deadline first. Returns -1 if the pool is off or full. */
+int ai_pool_submit(ai_task *task);
+/* From a worker: pushes a subtask on this worker's deque where idle workers can steal it.
+   Returns -1 when the deque is full; the caller should run the task itself. */
+int ai_pool_spawn(ai_task *task);
+/* From a worker: runs own and stolen subtasks until *pending drops to zero, then sleeps until
+   the rest of the group finishes. Every task of the group must end with ai_pool_task_done. */
+void ai_pool_help_until_zero(int *pending);
+/* Counts one task of a group as finished and wakes the worker waiting on it at zero. */
+void ai_pool_task_done(int *pending);
+
+#endif
@@ -0,0 +1,151 @@
+#include "bitboard.h"
+
+/* Masks that drop discs which wrapped around a row edge after a horizontal shift. */
+#define NOT_A_FILE 0xfefefefefefefefeULL
+#define NOT_H_FILE 0x7f7f7f7f7f7f7f7fULL
+#define ALL_FILES 0xffffffffffffffffULL
+
+/* The eight directions as four shift amounts, each walked both ways. */
+static const int dir_shift[4] = {1, 8, 9, 7};
+static const uint64_t dir_mask_left[4] = {NOT_A_FILE, ALL_FILES, NOT_A_FILE, NOT_H_FILE};
+static const uint64_t dir_mask_right[4] = {NOT_H_FILE, ALL_FILES, NOT_H_FILE, NOT_A_FILE};
+
+static int popcount64(uint64_t x) {
+    return __builtin_popcountll(x);
+}
+
+static uint64_t *own_bits(bitboard *b, int p) {
+    return p == BLACK ? &b->black : &b->white;
+}
+
+static uint64_t *other_bits(bitboard *b, int p) {
+    return p == BLACK ? &b->white : &b->black;
+}
+
+void bitboard_init(bitboard *b, int othello_setup) {
+    b->black = 0;
+    b->white = 0;
+    if (othello_setup) {
+        bitboard_set(b, 3, 3, WHITE);
+        bitboard_set(b, 3, 4, BLACK);
+        bitboard_set(b, 4, 3, BLACK);
+        bitboard_set(b, 4, 4, WHITE);
+    }
+}
+
+int bitboard_get(const bitboard *b, int r, int c) {
+    if (r < 0 || r >= SIZE || c < 0 || c >= SIZE) return 0;
+    uint64_t bit = BITBOARD_BIT(BITBOARD_SQ(r, c));
+    if (b->black & bit) return BLACK;
+    if (b->white & bit) return WHITE;
+    return 0;
+}
+
+void bitboard_set(bitboard *b, int r, int c, int p) {
+    if (r < 0 || r >= SIZE || c < 0 || c >= SIZE) return;
+    uint64_t bit = BITBOARD_BIT(BITBOARD_SQ(r, c));
+    b->black &= ~bit;
+    b->white &= ~bit;
+    if (p == BLACK) b->black |= bit;
+    else if (p == WHITE) b->white |= bit;
+}
+
+uint64_t bitboard_legal_moves(const bitboard *b, int p) {
+    uint64_t own = (p == BLACK) ? b->black : b->white;
+    uint64_t opp = (p == BLACK) ? b->white : b->black;
+    uint64_t empty = ~(own | opp);
+    uint64_t moves = 0;
+
+    for (int i = 0; i < 4; i++) {
+        int s = dir_shift[i];
+        uint64_t ol = opp & dir_mask_left[i];
+        uint64_t orr = opp & dir_mask_right[i];
+
+        /* A run of opponent discs is at most six long on an 8x8 board. */
+        uint64_t xl = (own << s) & ol;
+        uint64_t xr = (own >> s) & orr;
+        for (int k = 0; k < 5; k++) {
+            xl |= (xl << s) & ol;
+            xr |= (xr >> s) & orr;
+        }
+        moves |= (xl << s) & dir_mask_left[i] & empty;
+        moves |= (xr >> s) & dir_mask_right[i] & empty;
+    }
+    return moves;
+}
+
+uint64_t bitboard_flips(const bitboard *b, int p, int sq) {
+    if (sq < 0 || sq >= SIZE * SIZE) return 0;
+    uint64_t own = (p == BLACK) ? b->black : b->white;
+    uint64_t opp = (p == BLACK) ? b->white : b->black;
+    uint64_t m = BITBOARD_BIT(sq);
+    if ((own | opp) & m) return 0;
+
+    uint64_t flips = 0;
+    for (int i = 0; i < 4; i++) {
+        int s = dir_shift[i];
+        uint64_t f = 0;
+        uint64_t x = (m << s) & dir_mask_left[i];
+        while (x & opp) {
+            f |= x;
+            x = (x << s) & dir_mask_left[i];
+        }
+        if (x & own) flips |= f;
+
+        f = 0;
+        x = (m >> s) & dir_mask_right[i];
+        while (x & opp) {
+            f |= x;
+            x = (x >> s) & dir_mask_right[i];
+        }
+        if (x & own) flips |= f;
+    }
+    return flips;
+}
+
+int bitboard_is_valid_move(const bitboard *b, int r, int c, int p) {
+    if (r < 0 || r >= SIZE || c < 0 || c >= SIZE) return 0;
+    return bitboard_flips(b, p, BITBOARD_SQ(r, c)) != 0;
+}
+
+int bitboard_has_moves(const bitboard *b, int p) {
+    return bitboard_legal_moves(b, p) != 0;
+}
+
+uint64_t bitboard_apply_move(bitboard *b, int p, int sq) {
+    uint64_t flips = bitboard_flips(b, p, sq);
+    if (!flips) return 0;
+    *own_bits(b, p) |= flips | BITBOARD_BIT(sq);
+    *other_bits(b, p) &= ~flips;
+    return flips;
+}
+
+void bitboard_pack(const bitboard *b, uint8_t out[BITBOARD_BYTES]) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = (uint8_t)(b->black >> (8 * i));
+        out[8 + i] = (uint8_t)(b->white >> (8 * i));
+    }
+}
+
+int bitboard_unpack(bitboard *b, const void *data, size_t len) {
+    if (!data || len != BITBOARD_BYTES) return -1;
+    const uint8_t *in = data;
+    uint64_t black = 0;
+    uint64_t white = 0;
+    for (int i = 0; i < 8; i++) {
+        black |= (uint64_t)in[i] << (8 * i);
+        white |= (uint64_t)in[8 + i] << (8 * i);
+    }
+    if (black & white) return -1;
+    b->black = black;
+    b->white = white;
+    return 0;
+}
+
+int bitboard_count(const bitboard *b, int p) {
+    return popcount64(p == BLACK ? b->black : b->white);
+}
+
+int bitboard_count_all(const bitboard *b) {
+    return popcount64(b->black | b->white);
+}
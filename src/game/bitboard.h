@@ -0,0 +1,46 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../core/common.h"
+
+/* One bit per square, square index = r * SIZE + c (a1 = bit 0, h8 = bit 63). */
+typedef struct bitboard {
+    uint64_t black;
+    uint64_t white;
+} bitboard;
+
+#define BITBOARD_SQ(r, c) ((r) * SIZE + (c))
+#define BITBOARD_BIT(sq) (1ULL << (sq))
+#define BITBOARD_OPPONENT(p) ((p) == BLACK ? WHITE : BLACK)
+
+/* Empty board, or the standard four-disc Othello opening when othello_setup is set. */
+void bitboard_init(bitboard *b, int othello_setup);
+
+/* Returns 0, BLACK or WHITE for the given cell. Out-of-range cells read as 0. */
+int bitboard_get(const bitboard *b, int r, int c);
+void bitboard_set(bitboard *b, int r, int c, int p);
+
+/* Mask of every square where p may legally play. */
+uint64_t bitboard_legal_moves(const bitboard *b, int p);
+/* Mask of discs that flip if p plays sq; 0 means the move is illegal. */
+uint64_t bitboard_flips(const bitboard *b, int p, int sq);
+
+int bitboard_is_valid_move(const bitboard *b, int r, int c, int p);
+int bitboard_has_moves(const bitboard *b, int p);
+
+/* Places p at sq and flips captured discs. Returns the flip mask (0 = rejected, board untouched). */
+uint64_t bitboard_apply_move(bitboard *b, int p, int sq);
+
+/* Storage form (games.board): black then white, each 8 bytes little-endian. */
+#define BITBOARD_BYTES 16
+void bitboard_pack(const bitboard *b, uint8_t out[BITBOARD_BYTES]);
+/* Returns 0 on success, -1 if len is not BITBOARD_BYTES or a square holds both colours. */
+int bitboard_unpack(bitboard *b, const void *data, size_t len);
+
+int bitboard_count(const bitboard *b, int p);
+int bitboard_count_all(const bitboard *b);
+
+#endif
@@ -0,0 +1,223 @@
+#include "endgame.h"
+
+#include <string.h>
+#include <time.h>
+
+#define EG_INF 127
+/* Above this many empties, order moves fastest-first (fewest replies); below it parity alone is cheaper. */
+#define EG_FASTEST_FIRST_EMPTIES 7
+#define EG_CLOCK_INTERVAL 4096
+#define EG_MAX_MOVES 32
+
+/* Empties are grouped by 4x4 quadrant; playing into a quadrant with an odd number of empties
+   first tends to leave the opponent the worse parity. */
+static const uint64_t quadrant_mask[4] = {
+    0x000000000f0f0f0fULL, 0x00000000f0f0f0f0ULL,
+    0x0f0f0f0f00000000ULL, 0xf0f0f0f000000000ULL,
+};
+
+typedef struct eg_ctx {
+    uint64_t nodes;
+    uint64_t deadline_ns;
+    int aborted;
+} eg_ctx;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* The solver works on (mover, opponent) pairs; as a bitboard the mover is always BLACK. */
+static uint64_t flips_of(uint64_t me, uint64_t opp, int sq) {
+    bitboard b = { me, opp };
+    return bitboard_flips(&b, BLACK, sq);
+}
+
+static uint64_t moves_of(uint64_t me, uint64_t opp) {
+    bitboard b = { me, opp };
+    return bitboard_legal_moves(&b, BLACK);
+}
+
+static int disc_diff(uint64_t me, uint64_t opp) {
+    return __builtin_popcountll(me) - __builtin_popcountll(opp);
+}
+
+static uint64_t odd_quadrants(uint64_t empty) {
+    uint64_t odd = 0;
+    for (int q = 0; q < 4; q++) {
+        if (__builtin_popcountll(empty & quadrant_mask[q]) & 1) odd |= quadrant_mask[q];
+    }
+    return odd;
+}
+
+static int solve_last1(eg_ctx *ctx, uint64_t me, uint64_t opp, int sq) {
+    ctx->nodes++;
+    uint64_t bit = BITBOARD_BIT(sq);
+    uint64_t f = flips_of(me, opp, sq);
+    if (f) return disc_diff(me | f | bit, opp & ~f);
+    f = flips_of(opp, me, sq);
+    if (f) return disc_diff(me & ~f, opp | f | bit);
+    return disc_diff(me, opp);
+}
+
+static int solve_last2(eg_ctx *ctx, uint64_t me, uint64_t opp, int alpha, int beta, int x1, int x2, int passed) {
+    ctx->nodes++;
+    int best = -EG_INF;
+    uint64_t f = flips_of(me, opp, x1);
+    if (f) {
+        best = -solve_last1(ctx, opp & ~f, me | f | BITBOARD_BIT(x1), x2);
+        if (best >= beta) return best;
+        if (best > alpha) alpha = best;
+    }
+    f = flips_of(me, opp, x2);
+    if (f) {
+        int v = -solve_last1(ctx, opp & ~f, me | f | BITBOARD_BIT(x2), x1);
+        if (v > best) best = v;
+    }
+    if (best == -EG_INF) {
+        if (passed) return disc_diff(me, opp);
+        return -solve_last2(ctx, opp, me, -beta, -alpha, x1, x2, 1);
+    }
+    return best;
+}
+
+static int solve_last3(eg_ctx *ctx, uint64_t me, uint64_t opp, int alpha, int beta, int x1, int x2, int x3, int passed) {
+    ctx->nodes++;
+    /* Parity: a square alone in its quadrant goes first. */
+    uint64_t empty = BITBOARD_BIT(x1) | BITBOARD_BIT(x2) | BITBOARD_BIT(x3);
+    uint64_t odd = odd_quadrants(empty);
+    int sq[3] = { x1, x2, x3 };
+    if (!(odd & BITBOARD_BIT(sq[0]))) {
+        if (odd & BITBOARD_BIT(sq[1])) { int t = sq[0]; sq[0] = sq[1]; sq[1] = t; }
+        else if (odd & BITBOARD_BIT(sq[2])) { int t = sq[0]; sq[0] = sq[2]; sq[2] = t; }
+    }
+
+    int best = -EG_INF;
+    for (int i = 0; i < 3; i++) {
+        uint64_t f = flips_of(me, opp, sq[i]);
+        if (!f) continue;
+        int a = sq[(i + 1) % 3];
+        int b = sq[(i + 2) % 3];
+        int v = -solve_last2(ctx, opp & ~f, me | f | BITBOARD_BIT(sq[i]), -beta, -alpha, a, b, 0);
+        if (v > best) {
+            best = v;
+            if (best >= beta) return best;
+            if (best > alpha) alpha = best;
+        }
+    }
+    if (best == -EG_INF) {
+        if (passed) return disc_diff(me, opp);
+        return -solve_last3(ctx, opp, me, -beta, -alpha, x1, x2, x3, 1);
+    }
+    return best;
+}
+
+/* Orders moves: parity first; with many empties, fewest opponent replies (fastest-first) ahead of that. */
+static int order_moves(uint64_t me, uint64_t opp, uint64_t moves, int empties, int *out) {
+    uint64_t odd = odd_quadrants(~(me | opp));
+    int keys[EG_MAX_MOVES];
+    int n = 0;
+    while (moves) {
+        int sq = __builtin_ctzll(moves);
+        moves &= moves - 1;
+        int key = (odd & BITBOARD_BIT(sq)) ? 0 : 1;
+        if (empties > EG_FASTEST_FIRST_EMPTIES) {
+            uint64_t f = flips_of(me, opp, sq);
+            uint64_t replies = moves_of(opp & ~f, me | f | BITBOARD_BIT(sq));
+            key += 2 * __builtin_popcountll(replies);
+        }
+        int i = n++;
+        while (i > 0 && keys[i - 1] > key) {
+            keys[i] = keys[i - 1];
+            out[i] = out[i - 1];
+            i--;
+        }
+        keys[i] = key;
+        out[i] = sq;
+    }
+    return n;
+}
+
+static int solve(eg_ctx *ctx, uint64_t me, uint64_t opp, int alpha, int beta, int passed) {
+    uint64_t empty = ~(me | opp);
+    int empties = __builtin_popcountll(empty);
+    if (empties <= 3) {
+        int x1 = empties > 0 ? __builtin_ctzll(empty) : 0;
+        empty &= empty - 1;
+        int x2 = empties > 1 ? __builtin_ctzll(empty) : 0;
+        empty &= empty - 1;
+        int x3 = empties > 2 ? __builtin_ctzll(empty) : 0;
+        switch (empties) {
+        case 3: return solve_last3(ctx, me, opp, alpha, beta, x1, x2, x3, passed);
+        case 2: return solve_last2(ctx, me, opp, alpha, beta, x1, x2, passed);
+        case 1: return solve_last1(ctx, me, opp, x1);
+        default: return disc_diff(me, opp);
+        }
+    }
+
+    ctx->nodes++;
+    if ((ctx->nodes & (EG_CLOCK_INTERVAL - 1)) == 0 && now_ns() >= ctx->deadline_ns) ctx->aborted = 1;
+    if (ctx->aborted) return 0;
+
+    uint64_t moves = moves_of(me, opp);
+    if (!moves) {
+        if (passed) return disc_diff(me, opp);
+        return -solve(ctx, opp, me, -beta, -alpha, 1);
+    }
+
+    int order[EG_MAX_MOVES];
+    int n = order_moves(me, opp, moves, empties, order);
+    int best = -EG_INF;
+    for (int i = 0; i < n; i++) {
+        uint64_t f = flips_of(me, opp, order[i]);
+        int v = -solve(ctx, opp & ~f, me | f | BITBOARD_BIT(order[i]), -beta, -alpha, 0);
+        if (ctx->aborted) return 0;
+        if (v > best) {
+            best = v;
+            if (best >= beta) break;
+            if (best > alpha) alpha = best;
+        }
+    }
+    return best;
+}
+
+int endgame_solve(const bitboard *b, int player, int time_ms, int wld_only, endgame_result *out) {
+    uint64_t start = now_ns();
+    memset(out, 0, sizeof(*out));
+    out->move = -1;
+
+    uint64_t me = (player == BLACK) ? b->black : b->white;
+    uint64_t opp = (player == BLACK) ? b->white : b->black;
+    out->empties = 64 - __builtin_popcountll(me | opp);
+    if (out->empties > ENDGAME_MAX_EMPTIES) return -1;
+
+    eg_ctx ctx = { .deadline_ns = start + (uint64_t)time_ms * 1000000ULL };
+    int alpha = wld_only ? -1 : -64;
+    int beta = wld_only ? 1 : 64;
+
+    uint64_t moves = moves_of(me, opp);
+    if (!moves) {
+        out->score = moves_of(opp, me) ? -solve(&ctx, opp, me, -beta, -alpha, 1) : disc_diff(me, opp);
+    } else {
+        int order[EG_MAX_MOVES];
+        int n = order_moves(me, opp, moves, out->empties, order);
+        int best = -EG_INF;
+        for (int i = 0; i < n && !ctx.aborted; i++) {
+            uint64_t f = flips_of(me, opp, order[i]);
+            int v = -solve(&ctx, opp & ~f, me | f | BITBOARD_BIT(order[i]), -beta, -alpha, 0);
+            if (ctx.aborted) break;
+            if (v > best) {
+                best = v;
+                out->move = order[i];
+                if (best >= beta) break;
+                if (best > alpha) alpha = best;
+            }
+        }
+        out->score = best;
+    }
+
+    out->nodes = ctx.nodes;
+    out->elapsed_ms = (int)((now_ns() - start) / 1000000ULL);
+    return ctx.aborted ? -1 : 0;
+}
@@ -0,0 +1,25 @@
+#ifndef ENDGAME_H
+#define ENDGAME_H
+
+#include <stdint.h>
+
+#include "bitboard.h"
+
+/* Positions with more empties are refused; beyond this an exact solve does not fit a request. */
+#define ENDGAME_MAX_EMPTIES 22
+
+typedef struct endgame_result {
+    /* Final disc margin (mover minus opponent) under perfect play. With wld_only set it is
+       only exact in sign: >0 win, 0 draw, <0 loss. */
+    int score;
+    int move;           /* best move, -1 if the mover must pass */
+    int empties;
+    uint64_t nodes;
+    int elapsed_ms;
+} endgame_result;
+
+/* Solves b for player to move. Returns 0 when solved, -1 if the position has too many empties
+   or time_ms ran out first. */
+int endgame_solve(const bitboard *b, int player, int time_ms, int wld_only, endgame_result *out);
+
+#endif
@@ -0,0 +1,202 @@
+#include "tt.h"
+
+#include "../core/memory.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#define TT_BUCKET_WAYS 4
+#define TT_MIN_BUCKETS 1024
+#define TT_FILL_SAMPLE 4096
+
+/* Lock-free slot: check holds key ^ data. A reader that races a writer sees a pair whose
+   xor no longer matches its key and treats it as a miss, so no lock is needed. */
+typedef struct tt_slot {
+    uint64_t check;
+    uint64_t data;
+} tt_slot;
+
+/* Four slots fill exactly one 64-byte cache line. */
+typedef struct tt_bucket {
+    tt_slot slot[TT_BUCKET_WAYS];
+} __attribute__((aligned(64))) tt_bucket;
+
+static tt_bucket *table = NULL;
+static uint64_t bucket_mask = 0;
+static size_t table_bytes = 0;
+
+static uint64_t zobrist[2][64];
+static uint64_t zobrist_side;
+static pthread_once_t zobrist_once = PTHREAD_ONCE_INIT;
+
+static uint8_t generation = 0;
+
+static struct {
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t stores;
+    uint64_t collisions;
+} __attribute__((aligned(64))) totals;
+
+/* data layout: score (32) | depth (8) | bound (2) | move + 1 (8) | generation (8) */
+static uint64_t pack(int score, int depth, int bound, int move, uint8_t gen) {
+    return (uint64_t)(uint32_t)score |
+           ((uint64_t)(depth & 0xff) << 32) |
+           ((uint64_t)(bound & 0x3) << 40) |
+           ((uint64_t)((move + 1) & 0xff) << 42) |
+           ((uint64_t)gen << 50);
+}
+
+static int data_depth(uint64_t d) { return (int)((d >> 32) & 0xff); }
+static int data_bound(uint64_t d) { return (int)((d >> 40) & 0x3); }
+static uint8_t data_gen(uint64_t d) { return (uint8_t)((d >> 50) & 0xff); }
+
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Fixed seed: keys are identical across runs and across every worker thread. */
+static void init_zobrist(void) {
+    uint64_t state = 0x436576657273690aULL;
+    for (int color = 0; color < 2; color++) {
+        for (int sq = 0; sq < 64; sq++) zobrist[color][sq] = splitmix64(&state);
+    }
+    zobrist_side = splitmix64(&state);
+}
+
+int tt_init(size_t megabytes) {
+    pthread_once(&zobrist_once, init_zobrist);
+    if (table) return 0;
+    uint64_t buckets = TT_MIN_BUCKETS;
+    uint64_t want = (uint64_t)megabytes * 1024 * 1024 / sizeof(tt_bucket);
+    while (buckets * 2 <= want) buckets *= 2;
+
+    size_t bytes = (size_t)buckets * sizeof(tt_bucket);
+    tt_bucket *t = cev_mem_alloc_pinned(bytes);
+    if (!t) return -1;
+    memset(t, 0, bytes);
+    bucket_mask = buckets - 1;
+    table_bytes = bytes;
+    __atomic_store_n(&table, t, __ATOMIC_RELEASE);
+    return 0;
+}
+
+uint64_t tt_hash(const bitboard *b, int p) {
+    pthread_once(&zobrist_once, init_zobrist);
+    uint64_t key = (p == WHITE) ? zobrist_side : 0;
+    for (uint64_t m = b->black; m; m &= m - 1) key ^= zobrist[0][__builtin_ctzll(m)];
+    for (uint64_t m = b->white; m; m &= m - 1) key ^= zobrist[1][__builtin_ctzll(m)];
+    return key;
+}
+
+uint64_t tt_hash_move(uint64_t key, int p, int sq, uint64_t flips) {
+    int own = (p == BLACK) ? 0 : 1;
+    key ^= zobrist[own][sq] ^ zobrist_side;
+    for (; flips; flips &= flips - 1) {
+        int f = __builtin_ctzll(flips);
+        key ^= zobrist[0][f] ^ zobrist[1][f];
+    }
+    return key;
+}
+
+uint64_t tt_hash_pass(uint64_t key) {
+    return key ^ zobrist_side;
+}
+
+void tt_clear(void) {
+    tt_bucket *t = __atomic_load_n(&table, __ATOMIC_ACQUIRE);
+    if (t) memset(t, 0, table_bytes);
+}
+
+void tt_new_search(void) {
+    __atomic_add_fetch(&generation, 1, __ATOMIC_RELAXED);
+}
+
+int tt_probe(uint64_t key, tt_entry *out, tt_counters *c) {
+    tt_bucket *t = __atomic_load_n(&table, __ATOMIC_ACQUIRE);
+    if (!t) return 0;
+    c->probes++;
+    tt_bucket *bucket = &t[key & bucket_mask];
+    for (int i = 0; i < TT_BUCKET_WAYS; i++) {
+        uint64_t data = __atomic_load_n(&bucket->slot[i].data, __ATOMIC_RELAXED);
+        uint64_t check = __atomic_load_n(&bucket->slot[i].check, __ATOMIC_RELAXED);
+        if (data_bound(data) == 0 || (check ^ data) != key) continue;
+        out->score = (int)(int32_t)(uint32_t)data;
+        out->depth = data_depth(data);
+        out->bound = data_bound(data);
+        out->move = (int)((data >> 42) & 0xff) - 1;
+        c->hits++;
+        return 1;
+    }
+    return 0;
+}
+
+/* Replace-by-depth: an existing entry for the same key is only overwritten by an equal or deeper
+   result (or one from a newer search); otherwise the shallowest, oldest slot is evicted. */
+void tt_store(uint64_t key, int depth, int bound, int score, int move, tt_counters *c) {
+    tt_bucket *t = __atomic_load_n(&table, __ATOMIC_ACQUIRE);
+    if (!t) return;
+    uint8_t gen = __atomic_load_n(&generation, __ATOMIC_RELAXED);
+    tt_bucket *bucket = &t[key & bucket_mask];
+
+    int victim = 0;
+    int victim_rank = 1 << 30;
+    for (int i = 0; i < TT_BUCKET_WAYS; i++) {
+        uint64_t data = __atomic_load_n(&bucket->slot[i].data, __ATOMIC_RELAXED);
+        uint64_t check = __atomic_load_n(&bucket->slot[i].check, __ATOMIC_RELAXED);
+        if (data_bound(data) == 0) {
+            victim = i;
+            victim_rank = -1;
+            break;
+        }
+        if ((check ^ data) == key) {
+            if (depth < data_depth(data) && data_gen(data) == gen) return;
+            victim = i;
+            victim_rank = -1;
+            break;
+        }
+        int rank = data_depth(data) + (data_gen(data) == gen ? 256 : 0);
+        if (rank < victim_rank) {
+            victim = i;
+            victim_rank = rank;
+        }
+    }
+    if (victim_rank >= 0) c->collisions++;
+
+    uint64_t data = pack(score, depth, bound, move, gen);
+    __atomic_store_n(&bucket->slot[victim].data, data, __ATOMIC_RELAXED);
+    __atomic_store_n(&bucket->slot[victim].check, key ^ data, __ATOMIC_RELAXED);
+    c->stores++;
+}
+
+void tt_add_counters(const tt_counters *c) {
+    __atomic_add_fetch(&totals.probes, c->probes, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&totals.hits, c->hits, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&totals.stores, c->stores, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&totals.collisions, c->collisions, __ATOMIC_RELAXED);
+}
+
+void tt_get_stats(tt_stats *out) {
+    memset(out, 0, sizeof(*out));
+    out->probes = __atomic_load_n(&totals.probes, __ATOMIC_RELAXED);
+    out->hits = __atomic_load_n(&totals.hits, __ATOMIC_RELAXED);
+    out->misses = out->probes - out->hits;
+    out->stores = __atomic_load_n(&totals.stores, __ATOMIC_RELAXED);
+    out->collisions = __atomic_load_n(&totals.collisions, __ATOMIC_RELAXED);
+
+    tt_bucket *t = __atomic_load_n(&table, __ATOMIC_ACQUIRE);
+    if (!t) return;
+    out->bytes = table_bytes;
+    out->entries = (bucket_mask + 1) * TT_BUCKET_WAYS;
+    uint64_t sample = (bucket_mask + 1) < TT_FILL_SAMPLE ? (bucket_mask + 1) : TT_FILL_SAMPLE;
+    uint64_t used = 0;
+    for (uint64_t i = 0; i < sample; i++) {
+        for (int w = 0; w < TT_BUCKET_WAYS; w++) {
+            if (data_bound(__atomic_load_n(&t[i].slot[w].data, __ATOMIC_RELAXED))) used++;
+        }
+    }
+    out->fill_permille = (int)(used * 1000 / (sample * TT_BUCKET_WAYS));
+}
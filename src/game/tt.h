@@ -0,0 +1,65 @@
+#ifndef TT_H
+#define TT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitboard.h"
+
+typedef enum tt_bound {
+    TT_EXACT = 1,
+    TT_LOWER = 2,   /* score is a lower bound (search failed high) */
+    TT_UPPER = 3    /* score is an upper bound (search failed low) */
+} tt_bound;
+
+typedef struct tt_entry {
+    int score;
+    int depth;
+    int bound;
+    int move;       /* best move found at this node, -1 if none */
+} tt_entry;
+
+/* Per-search tallies; folded into the shared totals once per search to keep hot counters off the table. */
+typedef struct tt_counters {
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t stores;
+    uint64_t collisions;
+} tt_counters;
+
+typedef struct tt_stats {
+    size_t bytes;
+    uint64_t entries;
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t collisions;
+    /* Occupied share of a sample of buckets, in per mille. */
+    int fill_permille;
+} tt_stats;
+
+/* Allocates the shared table (rounded down to a power-of-two bucket count). Call once at startup;
+   without it the search runs uncached. Returns 0 on success. */
+int tt_init(size_t megabytes);
+
+/* Zobrist key of the position with p to move. */
+uint64_t tt_hash(const bitboard *b, int p);
+/* Key after p plays sq and flips the discs in flips; the side to move switches. */
+uint64_t tt_hash_move(uint64_t key, int p, int sq, uint64_t flips);
+/* Key after p passes. */
+uint64_t tt_hash_pass(uint64_t key);
+
+/* Empties the table. Only safe while no search is running (startup, benchmarks). */
+void tt_clear(void);
+
+/* Starts a new search generation; older entries become preferred replacement victims. */
+void tt_new_search(void);
+
+int tt_probe(uint64_t key, tt_entry *out, tt_counters *c);
+void tt_store(uint64_t key, int depth, int bound, int score, int move, tt_counters *c);
+
+void tt_add_counters(const tt_counters *c);
+void tt_get_stats(tt_stats *out);
+
+#endif
@@ -8,6 +8,8 @@ void join_handler(cwist_http_request *req, cwist_http_response *res);
 void leave_handler(cwist_http_request *req, cwist_http_response *res);
 void state_handler(cwist_http_request *req, cwist_http_response *res);
 void move_handler(cwist_http_request *req, cwist_http_response *res);
+void ai_move_handler(cwist_http_request *req, cwist_http_response *res);
+void ai_stats_handler(cwist_http_request *req, cwist_http_response *res);
 
 void login_handler(cwist_http_request *req, cwist_http_response *res);
 void register_handler(cwist_http_request *req, cwist_http_response *res);
@@ -22,5 +24,10 @@ void betting_place_handler(cwist_http_request *req, cwist_http_response *res);
 void betting_rankings_handler(cwist_http_request *req, cwist_http_response *res);
 void betting_multiplayer_place_handler(cwist_http_request *req, cwist_http_response *res);
 void betting_multiplayer_history_handler(cwist_http_request *req, cwist_http_response *res);
+void betting_multiplayer_predict_handler(cwist_http_request *req, cwist_http_response *res);
+
+void admin_locks_handler(cwist_http_request *req, cwist_http_response *res);
+void admin_mem_handler(cwist_http_request *req, cwist_http_response *res);
+void metrics_handler(cwist_http_request *req, cwist_http_response *res);
 
 #endif
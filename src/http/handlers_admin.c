@@ -0,0 +1,134 @@
+#include "handlers_shared.h"
+
+#include "../core/memory.h"
+#include "../core/metrics.h"
+#include "../core/slab.h"
+#include "../data/db.h"
+#include "../data/rooms.h"
+
+#include <cwist/core/sstring/sstring.h>
+#include <cjson/cJSON.h>
+
+void admin_locks_handler(cwist_http_request *req, cwist_http_response *res) {
+    (void)req;
+    db_lock_stat rows[DB_LOCK_STATS_MAX];
+    int n = db_get_lock_stats(rows, DB_LOCK_STATS_MAX);
+
+    cJSON *locks = cJSON_CreateArray();
+    for (int i = 0; i < n; i++) {
+        cJSON *row = cJSON_CreateObject();
+        cJSON_AddStringToObject(row, "name", rows[i].name);
+        cJSON_AddNumberToObject(row, "acquired", (double)rows[i].acquired);
+        cJSON_AddNumberToObject(row, "contended", (double)rows[i].contended);
+        cJSON_AddNumberToObject(row, "waited_ns", (double)rows[i].waited_ns);
+        cJSON_AddItemToArray(locks, row);
+    }
+    cJSON *reply = cJSON_CreateObject();
+    cJSON_AddItemToObject(reply, "locks", locks);
+
+    char *str = cJSON_PrintUnformatted(reply);
+    cwist_sstring_assign(res->body, str);
+    cev_mem_free(str);
+    cJSON_Delete(reply);
+    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+}
+
+/* GET /admin/mem: libttak allocations by call site (live, expired, failed), plus the slab classes. */
+void admin_mem_handler(cwist_http_request *req, cwist_http_response *res) {
+    (void)req;
+    cev_mem_totals totals;
+    cev_mem_get_totals(&totals);
+    cev_mem_site_stat sites[CEV_MEM_SITES_MAX];
+    int n_sites = cev_mem_site_stats(sites, CEV_MEM_SITES_MAX);
+    cev_slab_stat slabs[CEV_SLAB_CLASSES];
+    int n_slabs = cev_slab_stats(slabs, CEV_SLAB_CLASSES);
+
+    cev_json *w = cev_json_thread();
+    cev_json_begin_object(w);
+    cev_json_key(w, "totals");
+    cev_json_begin_object(w);
+    cev_json_kv_uint64(w, "live_bytes", totals.live_bytes);
+    cev_json_kv_uint64(w, "live_objects", totals.live_objects);
+    cev_json_kv_uint64(w, "allocs", totals.allocs);
+    cev_json_kv_uint64(w, "frees", totals.frees);
+    cev_json_kv_uint64(w, "expired", totals.expired);
+    cev_json_kv_uint64(w, "failures", totals.failures);
+    cev_json_kv_double(w, "allocs_per_sec", totals.allocs_per_sec);
+    cev_json_end_object(w);
+
+    cev_json_key(w, "sites");
+    cev_json_begin_array(w);
+    for (int i = 0; i < n_sites; i++) {
+        cev_json_begin_object(w);
+        cev_json_kv_string(w, "site", sites[i].site);
+        cev_json_kv_uint64(w, "live_bytes", sites[i].live_bytes);
+        cev_json_kv_uint64(w, "live_objects", sites[i].live_objects);
+        cev_json_kv_uint64(w, "allocs", sites[i].allocs);
+        cev_json_kv_uint64(w, "frees", sites[i].frees);
+        cev_json_kv_uint64(w, "expired", sites[i].expired);
+        cev_json_kv_uint64(w, "failures", sites[i].failures);
+        cev_json_end_object(w);
+    }
+    cev_json_end_array(w);
+
+    cev_json_key(w, "slabs");
+    cev_json_begin_array(w);
+    for (int i = 0; i < n_slabs; i++) {
+        cev_json_begin_object(w);
+        cev_json_kv_uint64(w, "object_size", slabs[i].object_size);
+        cev_json_kv_uint64(w, "pages", slabs[i].pages);
+        cev_json_kv_uint64(w, "allocs", slabs[i].allocs);
+        cev_json_kv_uint64(w, "frees", slabs[i].frees);
+        cev_json_kv_uint64(w, "depot_objects", slabs[i].depot_objects);
+        cev_json_end_object(w);
+    }
+    cev_json_end_array(w);
+    cev_json_end_object(w);
+    send_json(res, w);
+}
+
+/* GET /metrics: Prometheus text exposition of the route, subsystem, lock and room counters. */
+void metrics_handler(cwist_http_request *req, cwist_http_response *res) {
+    (void)req;
+    cev_metrics_buf b = {0};
+    cev_metrics_write(&b);
+
+    db_lock_stat locks[DB_LOCK_STATS_MAX];
+    int n = db_get_lock_stats(locks, DB_LOCK_STATS_MAX);
+    cev_metrics_printf(&b, "# HELP ceversi_lock_wait_seconds_total Time spent blocked on a contended lock.\n");
+    cev_metrics_printf(&b, "# TYPE ceversi_lock_wait_seconds_total counter\n");
+    for (int i = 0; i < n; i++) {
+        cev_metrics_printf(&b, "ceversi_lock_wait_seconds_total{lock=\"%s\"} %.9f\n",
+                           locks[i].name, (double)locks[i].waited_ns / 1e9);
+    }
+    cev_metrics_printf(&b, "# TYPE ceversi_lock_acquired_total counter\n");
+    for (int i = 0; i < n; i++) {
+        cev_metrics_printf(&b, "ceversi_lock_acquired_total{lock=\"%s\"} %llu\n",
+                           locks[i].name, (unsigned long long)locks[i].acquired);
+    }
+    cev_metrics_printf(&b, "# TYPE ceversi_lock_contended_total counter\n");
+    for (int i = 0; i < n; i++) {
+        cev_metrics_printf(&b, "ceversi_lock_contended_total{lock=\"%s\"} %llu\n",
+                           locks[i].name, (unsigned long long)locks[i].contended);
+    }
+
+    int rooms = 0;
+    int players = 0;
+    rooms_count(&rooms, &players);
+    cev_mem_totals mem;
+    cev_mem_get_totals(&mem);
+    cev_metrics_printf(&b, "# HELP ceversi_rooms_active Multiplayer rooms resident in memory.\n");
+    cev_metrics_printf(&b, "# TYPE ceversi_rooms_active gauge\nceversi_rooms_active %d\n", rooms);
+    cev_metrics_printf(&b, "# HELP ceversi_players_active Players seated in resident rooms.\n");
+    cev_metrics_printf(&b, "# TYPE ceversi_players_active gauge\nceversi_players_active %d\n", players);
+    cev_metrics_printf(&b, "# TYPE ceversi_mem_live_bytes gauge\nceversi_mem_live_bytes %llu\n",
+                       (unsigned long long)mem.live_bytes);
+
+    if (b.failed) {
+        res->status_code = 500;
+    } else {
+        cwist_sstring_assign(res->body, b.data ? b.data : "");
+    }
+    cev_metrics_buf_free(&b);
+    cwist_http_header_add(&res->headers, "Content-Type", "text/plain; version=0.0.4");
+}
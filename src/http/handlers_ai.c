@@ -0,0 +1,118 @@
+#include "handlers_shared.h"
+
+#include "../core/memory.h"
+#include "../game/ai.h"
+#include "../game/tt.h"
+
+#include <cwist/core/sstring/sstring.h>
+#include <cjson/cJSON.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Reads a flat 64-cell board (row-major, values 0/1/2). Returns 0 on success. */
+static int parse_board(cJSON *arr, bitboard *board) {
+    if (!arr || !cJSON_IsArray(arr) || cJSON_GetArraySize(arr) != SIZE * SIZE) return -1;
+    bitboard_init(board, 0);
+    for (int sq = 0; sq < SIZE * SIZE; sq++) {
+        cJSON *cell = cJSON_GetArrayItem(arr, sq);
+        if (!cJSON_IsNumber(cell)) return -1;
+        int v = cell->valueint;
+        if (v != 0 && v != BLACK && v != WHITE) return -1;
+        bitboard_set(board, sq / SIZE, sq % SIZE, v);
+    }
+    return 0;
+}
+
+/* Reversi opens with the four centre squares filled one disc at a time, without flips. */
+static int reversi_setup_move(const bitboard *board) {
+    static const int centre[4] = {
+        BITBOARD_SQ(3, 3), BITBOARD_SQ(3, 4), BITBOARD_SQ(4, 3), BITBOARD_SQ(4, 4)
+    };
+    int open[4];
+    int n = 0;
+    for (int i = 0; i < 4; i++) {
+        if (!((board->black | board->white) & BITBOARD_BIT(centre[i]))) open[n++] = centre[i];
+    }
+    return n ? open[rand() % n] : -1;
+}
+
+/* POST /ai/move {"board":[64], "player":1|2, "difficulty":"easy|medium|hard", "mode":"othello|reversi"} */
+void ai_move_handler(cwist_http_request *req, cwist_http_response *res) {
+    cJSON *json = cJSON_Parse(req->body->data);
+    if (!json) {
+        res->status_code = CWIST_HTTP_BAD_REQUEST;
+        return;
+    }
+
+    bitboard board;
+    cJSON *player_item = cJSON_GetObjectItem(json, "player");
+    cJSON *difficulty_item = cJSON_GetObjectItem(json, "difficulty");
+    cJSON *mode_item = cJSON_GetObjectItem(json, "mode");
+    int player = (player_item && cJSON_IsNumber(player_item)) ? player_item->valueint : 0;
+    if (parse_board(cJSON_GetObjectItem(json, "board"), &board) != 0 || (player != BLACK && player != WHITE)) {
+        res->status_code = CWIST_HTTP_BAD_REQUEST;
+        cwist_sstring_assign(res->body, "{\"error\":\"board must be 64 cells of 0/1/2 and player 1 or 2\"}");
+        cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+        cJSON_Delete(json);
+        return;
+    }
+
+    ai_difficulty difficulty = AI_MEDIUM;
+    if (difficulty_item && cJSON_IsString(difficulty_item)) ai_parse_difficulty(difficulty_item->valuestring, &difficulty);
+    int reversi = mode_item && cJSON_IsString(mode_item) && strcmp(mode_item->valuestring, "reversi") == 0;
+
+    ai_result result;
+    if (reversi && bitboard_count_all(&board) < 4) {
+        memset(&result, 0, sizeof(result));
+        result.move = reversi_setup_move(&board);
+    } else {
+        ai_limits limits;
+        ai_limits_for(difficulty, &limits);
+        ai_search(&board, player, &limits, &result);
+    }
+
+    cJSON *reply = cJSON_CreateObject();
+    cJSON_AddBoolToObject(reply, "pass", result.move < 0);
+    if (result.move >= 0) {
+        cJSON_AddNumberToObject(reply, "r", result.move / SIZE);
+        cJSON_AddNumberToObject(reply, "c", result.move % SIZE);
+    }
+    cJSON_AddStringToObject(reply, "difficulty", ai_difficulty_name(difficulty));
+    cJSON_AddNumberToObject(reply, "score", result.score);
+    cJSON_AddNumberToObject(reply, "depth", result.depth);
+    cJSON_AddBoolToObject(reply, "solved", result.solved);
+    cJSON_AddNumberToObject(reply, "nodes", (double)result.nodes);
+    cJSON_AddNumberToObject(reply, "elapsed_ms", result.elapsed_ms);
+
+    char *str = cJSON_PrintUnformatted(reply);
+    cwist_sstring_assign(res->body, str);
+    cev_mem_free(str);
+    cJSON_Delete(reply);
+    cJSON_Delete(json);
+    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+}
+
+/* GET /ai/stats: transposition-table size and hit rates, for sizing AI_TT_MB against RAM. */
+void ai_stats_handler(cwist_http_request *req, cwist_http_response *res) {
+    (void)req;
+    tt_stats stats;
+    tt_get_stats(&stats);
+
+    cJSON *tt = cJSON_CreateObject();
+    cJSON_AddNumberToObject(tt, "bytes", (double)stats.bytes);
+    cJSON_AddNumberToObject(tt, "entries", (double)stats.entries);
+    cJSON_AddNumberToObject(tt, "probes", (double)stats.probes);
+    cJSON_AddNumberToObject(tt, "hits", (double)stats.hits);
+    cJSON_AddNumberToObject(tt, "misses", (double)stats.misses);
+    cJSON_AddNumberToObject(tt, "stores", (double)stats.stores);
+    cJSON_AddNumberToObject(tt, "collisions", (double)stats.collisions);
+    cJSON_AddNumberToObject(tt, "fill_permille", stats.fill_permille);
+    cJSON *reply = cJSON_CreateObject();
+    cJSON_AddItemToObject(reply, "tt", tt);
+
+    char *str = cJSON_PrintUnformatted(reply);
+    cwist_sstring_assign(res->body, str);
+    cev_mem_free(str);
+    cJSON_Delete(reply);
+    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+}
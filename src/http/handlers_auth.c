@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 void login_handler(cwist_http_request *req, cwist_http_response *res) {
     cJSON *json = cJSON_Parse(req->body->data);
@@ -126,13 +127,27 @@ void register_handler(cwist_http_request *req, cwist_http_response *res) {
     cwist_http_header_add(&res->headers, "Content-Type", "application/json");
 }
 
+static void write_user_stats(cev_json *w, const db_user_stats *row) {
+    cev_json_begin_object(w);
+    cev_json_kv_string(w, "username", row->username);
+    cev_json_kv_int(w, "wins", row->wins);
+    cev_json_kv_int(w, "losses", row->losses);
+    cev_json_kv_int(w, "ties", row->ties);
+    cev_json_end_object(w);
+}
+
 void rankings_handler(cwist_http_request *req, cwist_http_response *res) {
-    cJSON *ranks = db_get_rankings(req->db);
-    char *str = cJSON_PrintUnformatted(ranks);
-    cwist_sstring_assign(res->body, str);
-    cev_mem_free(str);
-    cJSON_Delete(ranks);
-    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+    static json_cache cache = JSON_CACHE_INITIALIZER;
+    if (send_json_from_cache(req, res, &cache, db_rankings_version())) return;
+
+    db_user_stats rows[DB_RANKINGS_LIMIT];
+    uint64_t version = 0;
+    int n = db_get_rankings(req->db, rows, DB_RANKINGS_LIMIT, &version);
+    cev_json *w = cev_json_thread();
+    cev_json_begin_array(w);
+    for (int i = 0; i < n; i++) write_user_stats(w, &rows[i]);
+    cev_json_end_array(w);
+    send_json_cached(res, w, &cache, version);
 }
 
 void user_info_handler(cwist_http_request *req, cwist_http_response *res) {
@@ -142,23 +157,40 @@ void user_info_handler(cwist_http_request *req, cwist_http_response *res) {
         return;
     }
 
-    cJSON *info = db_get_user_info(req->db, atoi(uid_str));
-    if (info) {
-        char *str = cJSON_PrintUnformatted(info);
-        cwist_sstring_assign(res->body, str);
-        cev_mem_free(str);
-        cJSON_Delete(info);
+    db_user_stats row;
+    if (db_get_user_info(req->db, atoi(uid_str), &row) == 0) {
+        cev_json *w = cev_json_thread();
+        write_user_stats(w, &row);
+        send_json(res, w);
     } else {
         res->status_code = 404;
+        cwist_http_header_add(&res->headers, "Content-Type", "application/json");
     }
-    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
 }
 
 void rooms_handler(cwist_http_request *req, cwist_http_response *res) {
-    cJSON *rooms = db_get_multiplayer_rooms(req->db);
-    char *str = cJSON_PrintUnformatted(rooms);
-    cwist_sstring_assign(res->body, str);
-    cev_mem_free(str);
-    cJSON_Delete(rooms);
-    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+    static json_cache cache = JSON_CACHE_INITIALIZER;
+    uint64_t version = db_rooms_version();
+    if (send_json_from_cache(req, res, &cache, version)) return;
+
+    db_room_summary rows[DB_ROOM_LIST_LIMIT];
+    int n = db_get_multiplayer_rooms(req->db, rows, DB_ROOM_LIST_LIMIT);
+    cev_json *w = cev_json_thread();
+    cev_json_begin_array(w);
+    for (int i = 0; i < n; i++) {
+        char last_activity[32];
+        struct tm tm_utc;
+        gmtime_r(&rows[i].last_activity, &tm_utc);
+        strftime(last_activity, sizeof(last_activity), "%Y-%m-%d %H:%M:%S", &tm_utc);
+
+        cev_json_begin_object(w);
+        cev_json_kv_int(w, "room_id", rows[i].room_id);
+        cev_json_kv_string(w, "mode", rows[i].mode);
+        cev_json_kv_string(w, "status", rows[i].status);
+        cev_json_kv_int(w, "players", rows[i].players);
+        cev_json_kv_string(w, "last_activity", last_activity);
+        cev_json_end_object(w);
+    }
+    cev_json_end_array(w);
+    send_json_cached(res, w, &cache, version);
 }
@@ -1,6 +1,5 @@
 #include "handlers_shared.h"
 
-#include "../core/memory.h"
 #include "../data/db.h"
 #include "../game/betting_logic.h"
 
@@ -8,6 +7,7 @@
 #include <cwist/net/http/query.h>
 #include <cjson/cJSON.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 void betting_enter_handler(cwist_http_request *req, cwist_http_response *res) {
@@ -19,37 +19,61 @@ void betting_enter_handler(cwist_http_request *req, cwist_http_response *res) {
         return;
     }
 
-    cJSON *reply = cJSON_CreateObject();
-    cJSON_AddStringToObject(reply, "identity", identity);
-    cJSON_AddNumberToObject(reply, "points", points);
-    char *str = cJSON_PrintUnformatted(reply);
-    cwist_sstring_assign(res->body, str);
-    cev_mem_free(str);
-    cJSON_Delete(reply);
-    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+    cev_json *w = cev_json_thread();
+    cev_json_begin_object(w);
+    cev_json_kv_string(w, "identity", identity);
+    cev_json_kv_int(w, "points", points);
+    cev_json_end_object(w);
+    send_json(res, w);
 }
 
 void betting_slots_handler(cwist_http_request *req, cwist_http_response *res) {
-    cJSON *slots = db_get_betting_slots(req->db);
-    cJSON *reply = cJSON_CreateObject();
-    cJSON_AddItemToObject(reply, "slots", slots);
-
-    char *str = cJSON_PrintUnformatted(reply);
-    cwist_sstring_assign(res->body, str);
-    cev_mem_free(str);
-    cJSON_Delete(reply);
-    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+    static json_cache cache = JSON_CACHE_INITIALIZER;
+    uint64_t version = db_betting_slots_version();
+    if (send_json_from_cache(req, res, &cache, version)) return;
+
+    db_betting_slot rows[DB_BETTING_SLOT_COUNT];
+    int n = db_get_betting_slots(req->db, rows, DB_BETTING_SLOT_COUNT);
+    cev_json *w = cev_json_thread();
+    cev_json_begin_object(w);
+    cev_json_key(w, "slots");
+    cev_json_begin_array(w);
+    for (int i = 0; i < n; i++) {
+        cev_json_begin_object(w);
+        cev_json_kv_int(w, "slot_id", rows[i].slot_id);
+        cev_json_kv_string(w, "difficulty", rows[i].difficulty);
+        cev_json_kv_double(w, "odds_win", rows[i].odds_win);
+        cev_json_kv_double(w, "odds_lose", rows[i].odds_lose);
+        cev_json_kv_double(w, "odds_draw", rows[i].odds_draw);
+        cev_json_kv_string(w, "updated_at", rows[i].updated_at);
+        cev_json_end_object(w);
+    }
+    cev_json_end_array(w);
+    cev_json_end_object(w);
+    send_json_cached(res, w, &cache, version);
 }
 
 void betting_rankings_handler(cwist_http_request *req, cwist_http_response *res) {
-    cJSON *ranks = db_get_betting_rankings(req->db);
-    cJSON *reply = cJSON_CreateObject();
-    cJSON_AddItemToObject(reply, "rankings", ranks);
-    char *str = cJSON_PrintUnformatted(reply);
-    cwist_sstring_assign(res->body, str);
-    cev_mem_free(str);
-    cJSON_Delete(reply);
-    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+    static json_cache cache = JSON_CACHE_INITIALIZER;
+    if (send_json_from_cache(req, res, &cache, db_betting_rankings_version())) return;
+
+    db_betting_rank rows[DB_BETTING_RANKINGS_LIMIT];
+    uint64_t version = 0;
+    int n = db_get_betting_rankings(req->db, rows, DB_BETTING_RANKINGS_LIMIT, &version);
+    cev_json *w = cev_json_thread();
+    cev_json_begin_object(w);
+    cev_json_key(w, "rankings");
+    cev_json_begin_array(w);
+    for (int i = 0; i < n; i++) {
+        cev_json_begin_object(w);
+        cev_json_kv_string(w, "identity", rows[i].identity);
+        cev_json_kv_int(w, "points", rows[i].points);
+        cev_json_kv_string(w, "updated_at", rows[i].updated_at);
+        cev_json_end_object(w);
+    }
+    cev_json_end_array(w);
+    cev_json_end_object(w);
+    send_json_cached(res, w, &cache, version);
 }
 
 void betting_place_handler(cwist_http_request *req, cwist_http_response *res) {
@@ -73,34 +97,33 @@ void betting_place_handler(cwist_http_request *req, cwist_http_response *res) {
         return;
     }
 
-    cJSON *result = NULL;
+    db_bet_result bet;
     int rc = db_apply_bet(
         req->db,
         identity,
         slot_item->valueint,
         outcome_item->valuestring,
         amount_item->valueint,
-        &result
+        &bet
     );
+    cJSON_Delete(json);
+    cev_json *w = cev_json_thread();
+    cev_json_begin_object(w);
     if (rc != 0) {
-        cJSON *err = cJSON_CreateObject();
-        if (rc == -3) cJSON_AddStringToObject(err, "error", "Bet amount exceeds current points");
-        else cJSON_AddStringToObject(err, "error", "Invalid bet request");
-        char *err_str = cJSON_PrintUnformatted(err);
-        cwist_sstring_assign(res->body, err_str);
-        cev_mem_free(err_str);
-        cJSON_Delete(err);
+        cev_json_kv_string(w, "error", rc == -3 ? "Bet amount exceeds current points" : "Invalid bet request");
+        cev_json_end_object(w);
         res->status_code = CWIST_HTTP_BAD_REQUEST;
-        cJSON_Delete(json);
+        send_json(res, w);
         return;
     }
 
-    char *str = cJSON_PrintUnformatted(result);
-    cwist_sstring_assign(res->body, str);
-    cev_mem_free(str);
-    cJSON_Delete(result);
-    cJSON_Delete(json);
-    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+    cev_json_kv_bool(w, "success", bet.success);
+    cev_json_kv_int(w, "delta", bet.delta);
+    cev_json_kv_int(w, "points", bet.points);
+    cev_json_kv_string(w, "result", bet.result);
+    cev_json_kv_double(w, "odds", bet.odds);
+    cev_json_end_object(w);
+    send_json(res, w);
 }
 
 void betting_multiplayer_place_handler(cwist_http_request *req, cwist_http_response *res) {
@@ -125,34 +148,34 @@ void betting_multiplayer_place_handler(cwist_http_request *req, cwist_http_respo
     char identity[128];
     build_identity_from_json(user_item, guest_item, identity, sizeof(identity));
 
-    cJSON *result = NULL;
+    int points = 0;
     int rc = db_place_multiplayer_bet(
         req->db,
         identity,
         room_item->valueint,
         target_item->valueint,
         amount_item->valueint,
-        &result
+        &points
     );
+    cev_json *w = cev_json_thread();
+    cev_json_begin_object(w);
     if (rc != 0) {
-        cJSON *err = cJSON_CreateObject();
-        if (rc == -3) cJSON_AddStringToObject(err, "error", "Bet amount exceeds allowed point range");
-        else cJSON_AddStringToObject(err, "error", "Invalid multiplayer bet request");
-        char *err_str = cJSON_PrintUnformatted(err);
-        cwist_sstring_assign(res->body, err_str);
-        cev_mem_free(err_str);
-        cJSON_Delete(err);
+        cev_json_kv_string(w, "error", rc == -3 ? "Bet amount exceeds allowed point range" : "Invalid multiplayer bet request");
+        cev_json_end_object(w);
         res->status_code = CWIST_HTTP_BAD_REQUEST;
         cJSON_Delete(json);
+        send_json(res, w);
         return;
     }
 
-    char *str = cJSON_PrintUnformatted(result);
-    cwist_sstring_assign(res->body, str);
-    cev_mem_free(str);
-    cJSON_Delete(result);
+    cev_json_kv_string(w, "identity", identity);
+    cev_json_kv_int(w, "room_id", room_item->valueint);
+    cev_json_kv_int(w, "target_player", target_item->valueint);
+    cev_json_kv_int(w, "amount", amount_item->valueint);
+    cev_json_kv_int(w, "points", points);
+    cev_json_end_object(w);
     cJSON_Delete(json);
-    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+    send_json(res, w);
 }
 
 void betting_multiplayer_history_handler(cwist_http_request *req, cwist_http_response *res) {
@@ -161,14 +184,51 @@ void betting_multiplayer_history_handler(cwist_http_request *req, cwist_http_res
     char identity[128];
     build_identity(req, identity, sizeof(identity));
 
-    cJSON *history = db_get_multiplayer_bet_history(req->db, identity, room_id);
-    cJSON *reply = cJSON_CreateObject();
-    cJSON_AddStringToObject(reply, "identity", identity);
-    cJSON_AddItemToObject(reply, "bets", history);
+    db_mp_bet_row rows[DB_BET_HISTORY_LIMIT];
+    int n = db_get_multiplayer_bet_history(req->db, identity, room_id, rows, DB_BET_HISTORY_LIMIT);
+    cev_json *w = cev_json_thread();
+    cev_json_begin_object(w);
+    cev_json_kv_string(w, "identity", identity);
+    cev_json_key(w, "bets");
+    cev_json_begin_array(w);
+    for (int i = 0; i < n; i++) {
+        cev_json_begin_object(w);
+        cev_json_kv_int(w, "id", rows[i].id);
+        cev_json_kv_int(w, "room_id", rows[i].room_id);
+        cev_json_kv_int(w, "target_player", rows[i].target_player);
+        cev_json_kv_int(w, "amount", rows[i].amount);
+        cev_json_kv_int(w, "settled", rows[i].settled);
+        cev_json_kv_string(w, "created_at", rows[i].created_at);
+        cev_json_end_object(w);
+    }
+    cev_json_end_array(w);
+    cev_json_end_object(w);
+    send_json(res, w);
+}
 
-    char *str = cJSON_PrintUnformatted(reply);
-    cwist_sstring_assign(res->body, str);
-    cev_mem_free(str);
-    cJSON_Delete(reply);
-    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+/* GET /betting/multiplayer/predict?room_id=N: perfect-play result of a live room near its end. */
+void betting_multiplayer_predict_handler(cwist_http_request *req, cwist_http_response *res) {
+    const char *room_str = cwist_query_map_get(req->query_params, "room_id");
+    int room_id = room_str ? atoi(room_str) : 0;
+    db_prediction prediction;
+    if (db_predict_multiplayer_result(req->db, room_id, &prediction) != 0) {
+        res->status_code = CWIST_HTTP_NOT_FOUND;
+        cwist_sstring_assign(res->body, "{\"error\":\"Room not found\"}");
+        cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+        return;
+    }
+
+    cev_json *w = cev_json_thread();
+    cev_json_begin_object(w);
+    cev_json_kv_int(w, "room_id", prediction.room_id);
+    cev_json_kv_uint64(w, "version", prediction.version);
+    cev_json_kv_int(w, "empties", prediction.empties);
+    cev_json_kv_int(w, "turn", prediction.turn);
+    cev_json_kv_bool(w, "solved", prediction.solved);
+    if (prediction.solved) {
+        cev_json_kv_int(w, "predicted_winner", prediction.winner_player);
+        cev_json_kv_int(w, "margin", prediction.margin);
+    }
+    cev_json_end_object(w);
+    send_json(res, w);
 }
@@ -1,10 +1,8 @@
 #include "handlers_shared.h"
 
 #include "../data/db.h"
-#include "../core/memory.h"
 
 #include <cwist/core/sstring/sstring.h>
-#include <cwist/core/utils/json_builder.h>
 #include <cwist/net/http/query.h>
 #include <cjson/cJSON.h>
 #include <stdio.h>
@@ -25,16 +23,13 @@ void join_handler(cwist_http_request *req, cwist_http_response *res) {
         return;
     }
 
-    cwist_json_builder *jb = cwist_json_builder_create();
-    cwist_json_begin_object(jb);
-    cwist_json_add_int(jb, "player_id", pid);
-    cwist_json_add_int(jb, "room_id", room_id);
-    cwist_json_add_string(jb, "mode", mode);
-    cwist_json_end_object(jb);
-
-    cwist_sstring_assign(res->body, (char *)cwist_json_get_raw(jb));
-    cwist_json_builder_destroy(jb);
-    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+    cev_json *w = cev_json_thread();
+    cev_json_begin_object(w);
+    cev_json_kv_int(w, "player_id", pid);
+    cev_json_kv_int(w, "room_id", room_id);
+    cev_json_kv_string(w, "mode", mode);
+    cev_json_end_object(w);
+    send_json(res, w);
 }
 
 void leave_handler(cwist_http_request *req, cwist_http_response *res) {
@@ -51,33 +46,37 @@ void leave_handler(cwist_http_request *req, cwist_http_response *res) {
     cwist_http_header_add(&res->headers, "Content-Type", "application/json");
 }
 
+#define STATE_LONG_POLL_MS 25000
+
+/* /state?room=N[&since=V]: with since, the request parks until the room's version moves past V
+   (or the long-poll window closes), so clients only get woken by moves in their own room. */
 void state_handler(cwist_http_request *req, cwist_http_response *res) {
     int room_id = get_room_id(req);
-    int board[SIZE][SIZE];
-    int turn, players;
-    char status[32];
-    char mode[16];
-    get_game_state(req->db, room_id, board, &turn, status, &players, mode, NULL);
-
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddStringToObject(json, "status", status);
-    cJSON_AddNumberToObject(json, "turn", turn);
-    cJSON_AddStringToObject(json, "mode", mode);
-    cJSON_AddNumberToObject(json, "room_id", room_id);
-
-    cJSON *board_arr = cJSON_CreateArray();
-    for (int r = 0; r < SIZE; r++) {
-        for (int c = 0; c < SIZE; c++) {
-            cJSON_AddItemToArray(board_arr, cJSON_CreateNumber(board[r][c]));
-        }
+    const char *since_str = cwist_query_map_get(req->query_params, "since");
+    uint64_t since = (since_str && since_str[0]) ? strtoull(since_str, NULL, 10) : 0;
+    db_touch_room(req->db, room_id);
+    if (since) db_wait_game_state(req->db, room_id, since, STATE_LONG_POLL_MS);
+
+    // Version and board come from one snapshot, so the ETag always matches the body.
+    db_room_view view;
+    db_get_room_view(req->db, room_id, &view);
+    if (reply_not_modified(req, res, view.version)) return;
+
+    cev_json *w = cev_json_thread();
+    cev_json_begin_object(w);
+    cev_json_kv_string(w, "status", view.status);
+    cev_json_kv_int(w, "turn", view.turn);
+    cev_json_kv_string(w, "mode", view.mode);
+    cev_json_kv_int(w, "room_id", room_id);
+    cev_json_kv_uint64(w, "version", view.version);
+    cev_json_key(w, "board");
+    cev_json_begin_array(w);
+    for (int sq = 0; sq < SIZE * SIZE; sq++) {
+        cev_json_int(w, (view.board.black >> sq) & 1 ? BLACK : (view.board.white >> sq) & 1 ? WHITE : 0);
     }
-    cJSON_AddItemToObject(json, "board", board_arr);
-
-    char *str = cJSON_PrintUnformatted(json);
-    cwist_sstring_assign(res->body, str);
-    cev_mem_free(str);
-    cJSON_Delete(json);
-    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+    cev_json_end_array(w);
+    cev_json_end_object(w);
+    send_json(res, w);
 }
 
 void move_handler(cwist_http_request *req, cwist_http_response *res) {
@@ -91,87 +90,14 @@ void move_handler(cwist_http_request *req, cwist_http_response *res) {
     int r = cJSON_GetObjectItem(json, "r")->valueint;
     int c = cJSON_GetObjectItem(json, "c")->valueint;
     int p = cJSON_GetObjectItem(json, "player")->valueint;
+    cJSON_Delete(json);
 
-    int board[SIZE][SIZE];
-    int turn, players;
-    char status[32];
-    char mode[16];
-    get_game_state(req->db, room_id, board, &turn, status, &players, mode, NULL);
-
-    if (strcmp(status, "active") == 0 && p == turn) {
-        int pieces = count_pieces(board);
-        int is_reversi_setup = (strcmp(mode, "reversi") == 0 && pieces < 4);
-
-        if (is_reversi_setup) {
-            if (r < 3 || r > 4 || c < 3 || c > 4 || board[r][c] != 0) {
-                res->status_code = CWIST_HTTP_BAD_REQUEST;
-                cJSON_Delete(json);
-                return;
-            }
-        } else if (!is_valid_move(board, r, c, p)) {
-            res->status_code = CWIST_HTTP_BAD_REQUEST;
-            cJSON_Delete(json);
-            return;
-        }
-
-        board[r][c] = p;
-        int opponent = (p == BLACK) ? WHITE : BLACK;
-
-        if (!is_reversi_setup) {
-            int dr[] = {-1, -1, -1, 0, 0, 1, 1, 1};
-            int dc[] = {-1, 0, 1, -1, 1, -1, 0, 1};
-            for (int i = 0; i < 8; i++) {
-                int nr = r + dr[i];
-                int nc = c + dc[i];
-                int r_temp = nr;
-                int c_temp = nc;
-                int count = 0;
-                while (r_temp >= 0 && r_temp < SIZE && c_temp >= 0 && c_temp < SIZE &&
-                       board[r_temp][c_temp] == opponent) {
-                    r_temp += dr[i];
-                    c_temp += dc[i];
-                    count++;
-                }
-                if (count > 0 && r_temp >= 0 && r_temp < SIZE && c_temp >= 0 && c_temp < SIZE &&
-                    board[r_temp][c_temp] == p) {
-                    int rr = r + dr[i];
-                    int cc = c + dc[i];
-                    while (board[rr][cc] == opponent) {
-                        board[rr][cc] = p;
-                        rr += dr[i];
-                        cc += dc[i];
-                    }
-                }
-            }
-        }
-
-        if (is_reversi_setup && count_pieces(board) < 4) {
-            turn = opponent;
-        } else {
-            if (has_valid_moves(board, opponent)) {
-                turn = opponent;
-            } else if (!has_valid_moves(board, p)) {
-                strcpy(status, "finished");
-
-                int b_cnt = 0;
-                int w_cnt = 0;
-                for (int rr = 0; rr < SIZE; rr++) {
-                    for (int cc = 0; cc < SIZE; cc++) {
-                        if (board[rr][cc] == BLACK) b_cnt++;
-                        else if (board[rr][cc] == WHITE) w_cnt++;
-                    }
-                }
-                int winner = (b_cnt > w_cnt) ? 1 : (w_cnt > b_cnt ? 2 : 0);
-                db_record_result(req->db, room_id, winner);
-                db_settle_multiplayer_bets(req->db, room_id, winner, NULL);
-            }
-        }
-
-        update_game_state(req->db, room_id, board, turn, status, players, mode);
-        cwist_sstring_assign(res->body, "{\"status\":\"ok\"}");
-    } else {
+    int rc = db_play_move(req->db, room_id, p, r, c, NULL);
+    if (rc == DB_MOVE_ILLEGAL) {
+        res->status_code = CWIST_HTTP_BAD_REQUEST;
+    } else if (rc != DB_MOVE_OK) {
         res->status_code = CWIST_HTTP_FORBIDDEN;
+    } else {
+        cwist_sstring_assign(res->body, "{\"status\":\"ok\"}");
     }
-
-    cJSON_Delete(json);
 }
@@ -1,104 +1,89 @@
 #include "handlers_shared.h"
 
-#include "../core/memory.h"
 #include "../data/db.h"
+#include "page_template.h"
 
-#include <cwist/core/html/builder.h>
 #include <cwist/core/sstring/sstring.h>
-#include <cwist/core/template/template.h>
 #include <cwist/net/http/query.h>
-#include <cjson/cJSON.h>
 #include <stdlib.h>
+#include <string.h>
 
-void root_handler(cwist_http_request *req, cwist_http_response *res) {
-    const char *room_str = cwist_query_map_get(req->query_params, "room");
-    cJSON *context = cJSON_CreateObject();
-
-    cJSON_AddNumberToObject(context, "room_id", 0);
-    cJSON_AddStringToObject(context, "mode", "othello");
-    cJSON_AddStringToObject(context, "status", "waiting");
-    cJSON_AddNumberToObject(context, "turn_val", 1);
-    cJSON_AddStringToObject(context, "turn_text", "Black's Turn");
-    cJSON_AddNumberToObject(context, "score_black", 0);
-    cJSON_AddNumberToObject(context, "score_white", 0);
-    cJSON_AddStringToObject(context, "board_html", "");
-    cJSON_AddStringToObject(context, "board_json", "[]");
+#define CELL_EMPTY_HTML "<div class=\"cell\"></div>"
+#define CELL_BLACK_HTML "<div class=\"cell\"><div class=\"disc black\"></div></div>"
+#define CELL_WHITE_HTML "<div class=\"cell\"><div class=\"disc white\"></div></div>"
 
-    if (room_str) {
-        int room_id = atoi(room_str);
-        int board[SIZE][SIZE];
-        int turn, players;
-        char status[32];
-        char mode[16];
+/* Cell markup and JSON value indexed by 0 / BLACK / WHITE. */
+static const char *const cell_html[3] = { CELL_EMPTY_HTML, CELL_BLACK_HTML, CELL_WHITE_HTML };
+static const size_t cell_html_len[3] = {
+    sizeof(CELL_EMPTY_HTML) - 1, sizeof(CELL_BLACK_HTML) - 1, sizeof(CELL_WHITE_HTML) - 1,
+};
+static const char cell_json[3] = { '0', '1', '2' };
 
-        get_game_state(req->db, room_id, board, &turn, status, &players, mode, NULL);
+/* Sized for a full board of the longest cell. */
+#define BOARD_HTML_MAX (SIZE * SIZE * (sizeof(CELL_WHITE_HTML) - 1) + 1)
+#define BOARD_JSON_MAX (SIZE * SIZE * 2 + 2)
 
-        cJSON_ReplaceItemInObject(context, "room_id", cJSON_CreateNumber(room_id));
-        cJSON_ReplaceItemInObject(context, "mode", cJSON_CreateString(mode));
-        cJSON_ReplaceItemInObject(context, "status", cJSON_CreateString(status));
-        cJSON_ReplaceItemInObject(context, "turn_val", cJSON_CreateNumber(turn));
-        cJSON_ReplaceItemInObject(
-            context,
-            "turn_text",
-            cJSON_CreateString(turn == 1 ? "Black's Turn" : "White's Turn")
-        );
+static int cell_value(const bitboard *b, int sq) {
+    if (b->black & BITBOARD_BIT(sq)) return BLACK;
+    if (b->white & BITBOARD_BIT(sq)) return WHITE;
+    return 0;
+}
 
-        int black_score = 0;
-        int white_score = 0;
-        for (int r = 0; r < SIZE; r++) {
-            for (int c = 0; c < SIZE; c++) {
-                if (board[r][c] == BLACK) black_score++;
-                else if (board[r][c] == WHITE) white_score++;
-            }
-        }
-        cJSON_ReplaceItemInObject(context, "score_black", cJSON_CreateNumber(black_score));
-        cJSON_ReplaceItemInObject(context, "score_white", cJSON_CreateNumber(white_score));
+void root_handler(cwist_http_request *req, cwist_http_response *res) {
+    const char *room_str = cwist_query_map_get(req->query_params, "room");
+    page_context ctx;
+    char board_html[BOARD_HTML_MAX];
+    char board_json[BOARD_JSON_MAX];
+    int room_id = room_str ? atoi(room_str) : 0;
 
-        cJSON *board_arr = cJSON_CreateArray();
-        for (int r = 0; r < SIZE; r++) {
-            for (int c = 0; c < SIZE; c++) {
-                cJSON_AddItemToArray(board_arr, cJSON_CreateNumber(board[r][c]));
-            }
-        }
+    /* The page renders from this one snapshot, and the tag names both its version and the
+       template's. */
+    db_room_view view;
+    view.version = 0;
+    if (room_str) db_get_room_view(req->db, room_id, &view);
+    if (reply_not_modified_pair(req, res, page_template_version(), view.version)) return;
 
-        char *board_json_str = cJSON_PrintUnformatted(board_arr);
-        cJSON_ReplaceItemInObject(context, "board_json", cJSON_CreateString(board_json_str));
-        cev_mem_free(board_json_str);
-        cJSON_Delete(board_arr);
+    page_context_init(&ctx);
+    page_set_int(&ctx, PAGE_ROOM_ID, 0);
+    page_set_text(&ctx, PAGE_MODE, "othello", 7);
+    page_set_text(&ctx, PAGE_STATUS, "waiting", 7);
+    page_set_int(&ctx, PAGE_TURN_VAL, 1);
+    page_set_text(&ctx, PAGE_TURN_TEXT, "Black's Turn", 12);
+    page_set_int(&ctx, PAGE_SCORE_BLACK, 0);
+    page_set_int(&ctx, PAGE_SCORE_WHITE, 0);
+    page_set_text(&ctx, PAGE_BOARD_JSON, "[]", 2);
 
-        cwist_sstring *cells_html = cwist_sstring_create();
-        cwist_sstring_assign(cells_html, "");
-        for (int r = 0; r < SIZE; r++) {
-            for (int c = 0; c < SIZE; c++) {
-                cwist_html_element_t *cell = cwist_html_element_create("div");
-                cwist_html_element_add_class(cell, "cell");
-                if (board[r][c] != 0) {
-                    cwist_html_element_t *disc = cwist_html_element_create("div");
-                    cwist_html_element_add_class(disc, "disc");
-                    cwist_html_element_add_class(disc, board[r][c] == BLACK ? "black" : "white");
-                    cwist_html_element_add_child(cell, disc);
-                }
+    if (room_str) {
+        const bitboard *board = &view.board;
+        page_set_int(&ctx, PAGE_ROOM_ID, room_id);
+        page_set_text(&ctx, PAGE_MODE, view.mode, strlen(view.mode));
+        page_set_text(&ctx, PAGE_STATUS, view.status, strlen(view.status));
+        page_set_int(&ctx, PAGE_TURN_VAL, view.turn);
+        page_set_text(&ctx, PAGE_TURN_TEXT, view.turn == 1 ? "Black's Turn" : "White's Turn", 12);
+        page_set_int(&ctx, PAGE_SCORE_BLACK, bitboard_count(board, BLACK));
+        page_set_int(&ctx, PAGE_SCORE_WHITE, bitboard_count(board, WHITE));
 
-                cwist_sstring *cell_str = cwist_html_render(cell);
-                cwist_sstring_append_sstring(cells_html, cell_str);
-                cwist_sstring_destroy(cell_str);
-                cwist_html_element_destroy(cell);
-            }
+        size_t html_len = 0;
+        size_t json_len = 0;
+        board_json[json_len++] = '[';
+        for (int sq = 0; sq < SIZE * SIZE; sq++) {
+            int v = cell_value(board, sq);
+            memcpy(board_html + html_len, cell_html[v], cell_html_len[v]);
+            html_len += cell_html_len[v];
+            if (sq > 0) board_json[json_len++] = ',';
+            board_json[json_len++] = cell_json[v];
         }
-
-        cJSON_ReplaceItemInObject(context, "board_html", cJSON_CreateString(cells_html->data));
-        cwist_sstring_destroy(cells_html);
+        board_json[json_len++] = ']';
+        page_set_text(&ctx, PAGE_BOARD_HTML, board_html, html_len);
+        page_set_text(&ctx, PAGE_BOARD_JSON, board_json, json_len);
     }
 
-    cwist_sstring *rendered = cwist_template_render_file("templates/index.html.tmpl", context);
+    const char *rendered = page_template_render(&ctx, NULL);
     if (rendered) {
-        cwist_sstring_assign(res->body, rendered->data);
-        cwist_sstring_destroy(rendered);
+        cwist_sstring_assign(res->body, rendered);
     } else {
         res->status_code = 500;
         cwist_sstring_assign(res->body, "Template Error");
     }
-
-    cJSON_Delete(context);
     cwist_http_header_add(&res->headers, "Content-Type", "text/html");
 }
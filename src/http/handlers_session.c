@@ -1,6 +1,5 @@
 #include "handlers_shared.h"
 
-#include "../core/memory.h"
 #include "../data/db.h"
 
 #include <cwist/core/sstring/sstring.h>
@@ -21,18 +20,42 @@ void sessions_handler(cwist_http_request *req, cwist_http_response *res) {
 
     const char *limit_str = cwist_query_map_get(req->query_params, "limit");
     int limit = parse_positive_int_or_default(limit_str, 8);
-    cJSON *sessions = db_get_recent_sessions(req->db, identity, type, limit);
-
-    cJSON *reply = cJSON_CreateObject();
-    cJSON_AddStringToObject(reply, "identity", identity);
-    cJSON_AddStringToObject(reply, "type", type);
-    cJSON_AddItemToObject(reply, "sessions", sessions);
-
-    char *str = cJSON_PrintUnformatted(reply);
-    cwist_sstring_assign(res->body, str);
-    cev_mem_free(str);
-    cJSON_Delete(reply);
-    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+    db_session_row rows[DB_SESSION_LIMIT_MAX];
+    int n = db_get_recent_sessions(req->db, identity, type, rows, limit);
+    db_session_total totals[DB_SESSION_TOTALS_MAX];
+    int n_totals = db_get_session_totals(req->db, identity, type, totals, DB_SESSION_TOTALS_MAX);
+    cev_json *w = cev_json_thread();
+    cev_json_begin_object(w);
+    cev_json_kv_string(w, "identity", identity);
+    cev_json_kv_string(w, "type", type);
+    cev_json_key(w, "sessions");
+    cev_json_begin_array(w);
+    for (int i = 0; i < n; i++) {
+        cev_json_begin_object(w);
+        cev_json_kv_int(w, "id", rows[i].id);
+        cev_json_kv_string(w, "session_type", type);
+        cev_json_kv_string(w, "mode", rows[i].mode);
+        cev_json_kv_string(w, "difficulty", rows[i].difficulty);
+        cev_json_kv_int(w, "room_id", rows[i].room_id);
+        cev_json_kv_string(w, "created_at", rows[i].created_at);
+        cev_json_end_object(w);
+    }
+    cev_json_end_array(w);
+    // Older sessions survive only as counts once retention has compacted them.
+    cev_json_key(w, "archived");
+    cev_json_begin_array(w);
+    for (int i = 0; i < n_totals; i++) {
+        cev_json_begin_object(w);
+        cev_json_kv_string(w, "mode", totals[i].mode);
+        cev_json_kv_string(w, "difficulty", totals[i].difficulty);
+        cev_json_kv_int(w, "sessions", totals[i].sessions);
+        cev_json_kv_string(w, "first_at", totals[i].first_at);
+        cev_json_kv_string(w, "last_at", totals[i].last_at);
+        cev_json_end_object(w);
+    }
+    cev_json_end_array(w);
+    cev_json_end_object(w);
+    send_json(res, w);
 }
 
 void sessions_log_handler(cwist_http_request *req, cwist_http_response *res) {
@@ -76,14 +99,11 @@ void sessions_log_handler(cwist_http_request *req, cwist_http_response *res) {
         return;
     }
 
-    cJSON *reply = cJSON_CreateObject();
-    cJSON_AddStringToObject(reply, "status", "ok");
-    cJSON_AddStringToObject(reply, "identity", identity);
-
-    char *str = cJSON_PrintUnformatted(reply);
-    cwist_sstring_assign(res->body, str);
-    cev_mem_free(str);
-    cJSON_Delete(reply);
+    cev_json *w = cev_json_thread();
+    cev_json_begin_object(w);
+    cev_json_kv_string(w, "status", "ok");
+    cev_json_kv_string(w, "identity", identity);
+    cev_json_end_object(w);
     cJSON_Delete(json);
-    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+    send_json(res, w);
 }
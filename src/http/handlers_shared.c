@@ -1,49 +1,13 @@
 #include "handlers_shared.h"
 
+#include "../core/metrics.h"
+
+#include <cwist/core/sstring/sstring.h>
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-
-int is_valid_move(int board[SIZE][SIZE], int r, int c, int p) {
-    if (r < 0 || r >= SIZE || c < 0 || c >= SIZE || board[r][c] != 0) return 0;
-    int opponent = (p == BLACK) ? WHITE : BLACK;
-    int dr[] = {-1, -1, -1, 0, 0, 1, 1, 1};
-    int dc[] = {-1, 0, 1, -1, 1, -1, 0, 1};
-    for (int i = 0; i < 8; i++) {
-        int nr = r + dr[i];
-        int nc = c + dc[i];
-        int count = 0;
-        while (nr >= 0 && nr < SIZE && nc >= 0 && nc < SIZE && board[nr][nc] == opponent) {
-            nr += dr[i];
-            nc += dc[i];
-            count++;
-        }
-        if (count > 0 && nr >= 0 && nr < SIZE && nc >= 0 && nc < SIZE && board[nr][nc] == p) {
-            return 1;
-        }
-    }
-    return 0;
-}
-
-int has_valid_moves(int board[SIZE][SIZE], int p) {
-    for (int r = 0; r < SIZE; r++) {
-        for (int c = 0; c < SIZE; c++) {
-            if (is_valid_move(board, r, c, p)) return 1;
-        }
-    }
-    return 0;
-}
-
-int count_pieces(int board[SIZE][SIZE]) {
-    int count = 0;
-    for (int r = 0; r < SIZE; r++) {
-        for (int c = 0; c < SIZE; c++) {
-            if (board[r][c] != 0) count++;
-        }
-    }
-    return count;
-}
+#include <time.h>
 
 int get_room_id(cwist_http_request *req) {
     int room_id = 1;
@@ -89,3 +53,105 @@ void build_identity_from_json(cJSON *user_item, cJSON *guest_item, char *identit
         snprintf(identity, n, "guest:default");
     }
 }
+
+void send_json(cwist_http_response *res, const cev_json *w) {
+    const char *data = cev_json_data(w);
+    if (!data) {
+        res->status_code = 500;
+        cwist_sstring_assign(res->body, "{\"error\":\"response too large\"}");
+    } else {
+        cwist_sstring_assign(res->body, data);
+    }
+    cev_metrics_add_time(CEV_TIMER_JSON, cev_metrics_now_ns() - w->started_ns);
+    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+}
+
+static unsigned long long etag_epoch;
+static pthread_once_t etag_once = PTHREAD_ONCE_INIT;
+
+static void init_etag_epoch(void) {
+    etag_epoch = (unsigned long long)time(NULL);
+}
+
+/* Versions restart with the process, so the tag carries the start time as well. */
+static void format_etag(char *out, size_t n, uint64_t version) {
+    pthread_once(&etag_once, init_etag_epoch);
+    snprintf(out, n, "\"%llx-%llx\"", etag_epoch, (unsigned long long)version);
+}
+
+static void format_etag_pair(char *out, size_t n, uint64_t first, uint64_t second) {
+    pthread_once(&etag_once, init_etag_epoch);
+    snprintf(out, n, "\"%llx-%llx-%llx\"", etag_epoch, (unsigned long long)first, (unsigned long long)second);
+}
+
+/* If-None-Match is '*' or a comma-separated list of tags, possibly weak (W/"..."). */
+static int etag_listed(const char *header, const char *etag) {
+    size_t len = strlen(etag);
+    const char *p = header;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') p++;
+        if (*p == '*') return 1;
+        if (strncmp(p, "W/", 2) == 0) p += 2;
+        const char *end = p;
+        while (*end && *end != ',') end++;
+        const char *last = end;
+        while (last > p && (last[-1] == ' ' || last[-1] == '\t')) last--;
+        if ((size_t)(last - p) == len && strncmp(p, etag, len) == 0) return 1;
+        p = end;
+    }
+    return 0;
+}
+
+int if_none_match(cwist_http_request *req, const char *etag) {
+    const char *tags = cwist_http_header_get(req->headers, "If-None-Match");
+    return tags && etag_listed(tags, etag);
+}
+
+static int reply_etag(cwist_http_request *req, cwist_http_response *res, const char *etag) {
+    cwist_http_header_add(&res->headers, "ETag", etag);
+    cwist_http_header_add(&res->headers, "Cache-Control", "no-cache");
+    if (!if_none_match(req, etag)) return 0;
+    res->status_code = 304;
+    return 1;
+}
+
+int reply_not_modified(cwist_http_request *req, cwist_http_response *res, uint64_t version) {
+    char etag[48];
+    format_etag(etag, sizeof(etag), version);
+    return reply_etag(req, res, etag);
+}
+
+int reply_not_modified_pair(cwist_http_request *req, cwist_http_response *res, uint64_t first, uint64_t second) {
+    char etag[64];
+    format_etag_pair(etag, sizeof(etag), first, second);
+    return reply_etag(req, res, etag);
+}
+
+int send_json_from_cache(cwist_http_request *req, cwist_http_response *res, json_cache *cache, uint64_t version) {
+    if (reply_not_modified(req, res, version)) return 1;
+
+    int hit = 0;
+    pthread_mutex_lock(&cache->lock);
+    if (cache->body && cache->version == version) {
+        cwist_sstring_assign(res->body, cache->body);
+        hit = 1;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    if (!hit) return 0;
+    cwist_http_header_add(&res->headers, "Content-Type", "application/json");
+    return 1;
+}
+
+void send_json_cached(cwist_http_response *res, const cev_json *w, json_cache *cache, uint64_t version) {
+    send_json(res, w);
+    const char *data = cev_json_data(w);
+    if (!data) return;
+    char *copy = strdup(data);
+    if (copy) {
+        pthread_mutex_lock(&cache->lock);
+        free(cache->body);
+        cache->body = copy;
+        cache->version = version;
+        pthread_mutex_unlock(&cache->lock);
+    }
+}
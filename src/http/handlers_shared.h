@@ -4,16 +4,44 @@
 #include "handlers.h"
 
 #include "../core/common.h"
+#include "../core/json_writer.h"
+#include "../game/bitboard.h"
 
 #include <cjson/cJSON.h>
+#include <pthread.h>
+#include <stdint.h>
 
-int is_valid_move(int board[SIZE][SIZE], int r, int c, int p);
-int has_valid_moves(int board[SIZE][SIZE], int p);
-int count_pieces(int board[SIZE][SIZE]);
 int get_room_id(cwist_http_request *req);
 void build_session_identity(cwist_http_request *req, char *identity, size_t n);
 void build_identity(cwist_http_request *req, char *identity, size_t n);
 void build_identity_from_json(cJSON *user_item, cJSON *guest_item, char *identity, size_t n);
 int parse_positive_int_or_default(const char *s, int fallback);
+/* Copies the writer's output into the body as application/json; answers 500 if it failed. */
+void send_json(cwist_http_response *res, const cev_json *w);
+
+/* True when the request's If-None-Match names etag (quoted, as sent in the ETag header). */
+int if_none_match(cwist_http_request *req, const char *etag);
+
+/* Validators for a resource with a version counter. Sets a strong ETag and
+   Cache-Control: no-cache (keep the body, but revalidate before reuse). Returns 1 after
+   answering 304 when If-None-Match already names this version; the handler then stops. */
+int reply_not_modified(cwist_http_request *req, cwist_http_response *res, uint64_t version);
+/* The same for a resource built from two independently versioned inputs; both go in the tag. */
+int reply_not_modified_pair(cwist_http_request *req, cwist_http_response *res, uint64_t first, uint64_t second);
+
+/* A JSON body kept until the version of the resource it renders moves on. */
+typedef struct json_cache {
+    pthread_mutex_t lock;
+    uint64_t version;
+    char *body;
+} json_cache;
+
+#define JSON_CACHE_INITIALIZER { PTHREAD_MUTEX_INITIALIZER, 0, NULL }
+
+/* reply_not_modified, then replays the cached body if it is still at version. Returns 1 if
+   the response is complete. */
+int send_json_from_cache(cwist_http_request *req, cwist_http_response *res, json_cache *cache, uint64_t version);
+/* send_json, keeping the body in cache for version. Follows a send_json_from_cache miss. */
+void send_json_cached(cwist_http_response *res, const cev_json *w, json_cache *cache, uint64_t version);
 
 #endif
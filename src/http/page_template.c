@@ -0,0 +1,336 @@
+#include "page_template.h"
+
+#include "static_assets.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/* Supports what the index template uses: {{ var }}, {% if [not] var %} and {% endif %}. */
+typedef enum segment_kind {
+    SEG_TEXT,
+    SEG_VAR,
+    SEG_IF,
+    SEG_ENDIF
+} segment_kind;
+
+typedef struct page_segment {
+    segment_kind kind;
+    int var;
+    int negate;
+    /* SEG_TEXT: slice of the template source. */
+    size_t offset;
+    size_t len;
+    /* SEG_IF: index of the matching SEG_ENDIF, where a false condition continues. */
+    int skip_to;
+} page_segment;
+
+typedef struct page_template {
+    char *source;
+    page_segment *segments;
+    int count;
+    time_t mtime;
+} page_template;
+
+#define PAGE_IF_DEPTH_MAX 8
+#define PAGE_RENDER_INITIAL 16384
+
+static const char *const var_names[PAGE_VAR_COUNT] = {
+    [PAGE_ROOM_ID] = "room_id",
+    [PAGE_MODE] = "mode",
+    [PAGE_STATUS] = "status",
+    [PAGE_TURN_VAL] = "turn_val",
+    [PAGE_TURN_TEXT] = "turn_text",
+    [PAGE_SCORE_BLACK] = "score_black",
+    [PAGE_SCORE_WHITE] = "score_white",
+    [PAGE_BOARD_HTML] = "board_html",
+    [PAGE_BOARD_JSON] = "board_json",
+};
+
+static page_template current;
+static char template_path[256];
+static int template_reload = 0;
+static unsigned long long template_version = 0;
+/* Only taken in reload mode; otherwise the template is immutable after startup. */
+static pthread_rwlock_t template_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static __thread char *render_buf = NULL;
+static __thread size_t render_cap = 0;
+
+void page_context_init(page_context *ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+    for (int i = 0; i < PAGE_VAR_COUNT; i++) ctx->text[i] = "";
+}
+
+void page_set_text(page_context *ctx, page_var var, const char *text, size_t len) {
+    ctx->text[var] = text ? text : "";
+    ctx->len[var] = text ? len : 0;
+}
+
+void page_set_int(page_context *ctx, page_var var, int value) {
+    int n = snprintf(ctx->number[var], sizeof(ctx->number[var]), "%d", value);
+    page_set_text(ctx, var, ctx->number[var], (size_t)n);
+}
+
+/* Template truthiness: empty strings and 0 are false. */
+static int is_truthy(const page_context *ctx, int var) {
+    size_t len = ctx->len[var];
+    if (len == 0) return 0;
+    return !(len == 1 && ctx->text[var][0] == '0');
+}
+
+static const char *skip_space(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    return p;
+}
+
+/* Reads one identifier from [p, end); returns its end. */
+static const char *read_word(const char *p, const char *end, const char **word, size_t *len) {
+    p = skip_space(p, end);
+    const char *start = p;
+    while (p < end && (*p == '_' || (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9'))) p++;
+    *word = start;
+    *len = (size_t)(p - start);
+    return p;
+}
+
+static int word_is(const char *word, size_t len, const char *s) {
+    return strlen(s) == len && memcmp(word, s, len) == 0;
+}
+
+static int lookup_var(const char *word, size_t len) {
+    for (int i = 0; i < PAGE_VAR_COUNT; i++) {
+        if (word_is(word, len, var_names[i])) return i;
+    }
+    return -1;
+}
+
+static int push_segment(page_template *t, int *cap, page_segment seg) {
+    if (t->count == *cap) {
+        int grow = *cap ? *cap * 2 : 32;
+        page_segment *tmp = realloc(t->segments, sizeof(page_segment) * (size_t)grow);
+        if (!tmp) return -1;
+        t->segments = tmp;
+        *cap = grow;
+    }
+    t->segments[t->count++] = seg;
+    return 0;
+}
+
+static int compile_error(const char *path, const char *source, const char *at, const char *what) {
+    int line = 1;
+    for (const char *p = source; p < at; p++) {
+        if (*p == '\n') line++;
+    }
+    fprintf(stderr, "%s:%d: %s\n", path, line, what);
+    return -1;
+}
+
+static int compile(const char *path, char *source, size_t size, page_template *out) {
+    page_template t = { .source = source };
+    int cap = 0;
+    int open_ifs[PAGE_IF_DEPTH_MAX];
+    int depth = 0;
+    const char *end = source + size;
+    const char *p = source;
+
+    while (p < end) {
+        const char *tag = p;
+        while (tag + 1 < end && !(tag[0] == '{' && (tag[1] == '{' || tag[1] == '%'))) tag++;
+        if (tag + 1 >= end) tag = end;
+        if (tag > p) {
+            page_segment seg = { .kind = SEG_TEXT, .offset = (size_t)(p - source), .len = (size_t)(tag - p) };
+            if (push_segment(&t, &cap, seg) != 0) goto fail;
+        }
+        if (tag == end) break;
+
+        int is_var = tag[1] == '{';
+        const char *close = strstr(tag + 2, is_var ? "}}" : "%}");
+        if (!close || close >= end) {
+            compile_error(path, source, tag, "unterminated tag");
+            goto fail;
+        }
+
+        const char *word;
+        size_t len;
+        const char *q = read_word(tag + 2, close, &word, &len);
+        page_segment seg = { 0 };
+        if (is_var) {
+            seg.kind = SEG_VAR;
+            seg.var = lookup_var(word, len);
+            if (seg.var < 0) {
+                compile_error(path, source, tag, "unknown variable");
+                goto fail;
+            }
+        } else if (word_is(word, len, "if")) {
+            seg.kind = SEG_IF;
+            q = read_word(q, close, &word, &len);
+            if (word_is(word, len, "not")) {
+                seg.negate = 1;
+                q = read_word(q, close, &word, &len);
+            }
+            seg.var = lookup_var(word, len);
+            if (seg.var < 0 || depth == PAGE_IF_DEPTH_MAX) {
+                compile_error(path, source, tag, seg.var < 0 ? "unknown variable" : "if nested too deep");
+                goto fail;
+            }
+            open_ifs[depth++] = t.count;
+        } else if (word_is(word, len, "endif")) {
+            if (depth == 0) {
+                compile_error(path, source, tag, "endif without if");
+                goto fail;
+            }
+            seg.kind = SEG_ENDIF;
+            t.segments[open_ifs[--depth]].skip_to = t.count;
+        } else {
+            compile_error(path, source, tag, "unsupported tag");
+            goto fail;
+        }
+        if (skip_space(q, close) != close) {
+            compile_error(path, source, tag, "unexpected text in tag");
+            goto fail;
+        }
+        if (push_segment(&t, &cap, seg) != 0) goto fail;
+        p = close + 2;
+    }
+    if (depth != 0) {
+        compile_error(path, source, end, "if without endif");
+        goto fail;
+    }
+    *out = t;
+    return 0;
+
+fail:
+    free(t.segments);
+    return -1;
+}
+
+/* Reads and compiles path into current, replacing the previous template only on success. */
+static int load_locked(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Failed to open template %s\n", path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fileno(f), &st) != 0 || st.st_size < 0) {
+        fclose(f);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    char *source = malloc(size + 1);
+    if (!source || fread(source, 1, size, f) != size) {
+        free(source);
+        fclose(f);
+        fprintf(stderr, "Failed to read template %s\n", path);
+        return -1;
+    }
+    fclose(f);
+    source[size] = '\0';
+    // Point asset links at their content-hashed URLs (nothing to do when no assets are loaded).
+    char *rewritten = static_assets_rewrite(source, &size);
+    if (rewritten) {
+        free(source);
+        source = rewritten;
+    }
+
+    page_template t;
+    if (compile(path, source, size, &t) != 0) {
+        free(source);
+        return -1;
+    }
+    t.mtime = st.st_mtime;
+    free(current.source);
+    free(current.segments);
+    current = t;
+    __atomic_add_fetch(&template_version, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int page_template_load(const char *path, int reload) {
+    pthread_rwlock_wrlock(&template_lock);
+    snprintf(template_path, sizeof(template_path), "%s", path);
+    template_reload = reload;
+    int rc = load_locked(template_path);
+    pthread_rwlock_unlock(&template_lock);
+    return rc;
+}
+
+static void reload_if_changed(void) {
+    struct stat st;
+    if (stat(template_path, &st) != 0) return;
+    pthread_rwlock_rdlock(&template_lock);
+    int changed = st.st_mtime != current.mtime;
+    pthread_rwlock_unlock(&template_lock);
+    if (!changed) return;
+    pthread_rwlock_wrlock(&template_lock);
+    /* Another render may have reloaded it meanwhile. */
+    if (st.st_mtime != current.mtime) load_locked(template_path);
+    pthread_rwlock_unlock(&template_lock);
+}
+
+unsigned long long page_template_version(void) {
+    if (template_reload) reload_if_changed();
+    return __atomic_load_n(&template_version, __ATOMIC_ACQUIRE);
+}
+
+static size_t rendered_size(const page_context *ctx) {
+    size_t total = 1;
+    for (int i = 0; i < current.count; i++) {
+        const page_segment *seg = &current.segments[i];
+        if (seg->kind == SEG_TEXT) total += seg->len;
+        else if (seg->kind == SEG_VAR) total += ctx->len[seg->var];
+    }
+    return total;
+}
+
+const char *page_template_render(const page_context *ctx, size_t *len) {
+    if (template_reload) {
+        reload_if_changed();
+        pthread_rwlock_rdlock(&template_lock);
+    }
+    if (!current.segments) {
+        if (template_reload) pthread_rwlock_unlock(&template_lock);
+        return NULL;
+    }
+
+    /* Upper bound (ignores skipped branches), so the copy loop never has to grow the buffer. */
+    size_t need = rendered_size(ctx);
+    if (need > render_cap) {
+        size_t cap = render_cap ? render_cap : PAGE_RENDER_INITIAL;
+        while (cap < need) cap *= 2;
+        char *tmp = realloc(render_buf, cap);
+        if (!tmp) {
+            if (template_reload) pthread_rwlock_unlock(&template_lock);
+            return NULL;
+        }
+        render_buf = tmp;
+        render_cap = cap;
+    }
+
+    char *out = render_buf;
+    for (int i = 0; i < current.count; i++) {
+        const page_segment *seg = &current.segments[i];
+        switch (seg->kind) {
+        case SEG_TEXT:
+            memcpy(out, current.source + seg->offset, seg->len);
+            out += seg->len;
+            break;
+        case SEG_VAR:
+            memcpy(out, ctx->text[seg->var], ctx->len[seg->var]);
+            out += ctx->len[seg->var];
+            break;
+        case SEG_IF:
+            if (is_truthy(ctx, seg->var) == seg->negate) i = seg->skip_to;
+            break;
+        case SEG_ENDIF:
+            break;
+        }
+    }
+    *out = '\0';
+    if (template_reload) pthread_rwlock_unlock(&template_lock);
+    if (len) *len = (size_t)(out - render_buf);
+    return render_buf;
+}
@@ -0,0 +1,42 @@
+#ifndef PAGE_TEMPLATE_H
+#define PAGE_TEMPLATE_H
+
+#include <stddef.h>
+
+/* Variables templates/index.html.tmpl may reference. */
+typedef enum page_var {
+    PAGE_ROOM_ID,
+    PAGE_MODE,
+    PAGE_STATUS,
+    PAGE_TURN_VAL,
+    PAGE_TURN_TEXT,
+    PAGE_SCORE_BLACK,
+    PAGE_SCORE_WHITE,
+    PAGE_BOARD_HTML,
+    PAGE_BOARD_JSON,
+    PAGE_VAR_COUNT
+} page_var;
+
+/* Values are inserted verbatim; text must outlive the render call. */
+typedef struct page_context {
+    const char *text[PAGE_VAR_COUNT];
+    size_t len[PAGE_VAR_COUNT];
+    char number[PAGE_VAR_COUNT][16];
+} page_context;
+
+void page_context_init(page_context *ctx);
+void page_set_text(page_context *ctx, page_var var, const char *text, size_t len);
+void page_set_int(page_context *ctx, page_var var, int value);
+
+/* Compiles the template at path into a segment list. With reload set (dev mode) every render
+   checks the file's mtime and recompiles it after a change. Returns 0 on success. */
+int page_template_load(const char *path, int reload);
+
+/* Counts successful loads, reloading first in reload mode; part of the page's ETag. */
+unsigned long long page_template_version(void);
+
+/* Renders into a per-thread buffer that stays valid until the thread's next render.
+   Returns NULL if no template is loaded. */
+const char *page_template_render(const page_context *ctx, size_t *len);
+
+#endif
@@ -0,0 +1,441 @@
+#include "room_feed.h"
+
+#include "../core/json_writer.h"
+#include "../core/slab.h"
+#include "../data/db.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define FEED_BUCKETS 256
+
+/* The subscribers of one room and what they have been sent. view is the room as of the last
+   frame fanned out; the next move frame is built against it. */
+typedef struct room_feed {
+    int room_id;
+    room_sub *subs;
+    int has_view;
+    db_room_view view;
+    /* view as a whole-room frame. Built on first need, so a move all subscribers keep up
+       with is serialized exactly once. */
+    room_frame *state;
+    int closed;         /* subscribers were told the room is gone */
+    struct room_feed *next;
+} room_feed;
+
+/* Feeds and every linked subscriber's queue. Never held while taking a room stripe, so the
+   broadcaster may read rooms with it released and subscribers never wait on a move. */
+static room_feed *feed_buckets[FEED_BUCKETS];
+static pthread_mutex_t feeds_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int feeds_live = 0;
+
+/* A room in the pending set; it counts only while batch is the current pending_batch. */
+typedef struct pending_slot {
+    int room_id;
+    unsigned batch;
+} pending_slot;
+
+/* Rooms changed since the broadcaster last looked, in arrival order and each at most once, so
+   the backlog is bounded by the number of rooms however often they change. pending_slots is an
+   open-addressed set of the same ids; bumping pending_batch empties it in one step when the
+   broadcaster takes the batch. pending_mutex is a leaf: the watcher takes it with a room
+   stripe held. */
+static int *pending_ids = NULL;
+static int pending_count = 0;
+static int pending_cap = 0;
+static pending_slot *pending_slots = NULL;
+static unsigned pending_slot_cap = 0;
+static unsigned pending_batch = 1;
+static pthread_mutex_t pending_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pending_cond = PTHREAD_COND_INITIALIZER;
+
+static unsigned feed_bucket(int room_id) {
+    return ((unsigned)room_id * 2654435761u) % FEED_BUCKETS;
+}
+
+/* Frames come from the slab pools (malloc if they are too large or unavailable). */
+static room_frame *frame_from(room_frame_kind kind, uint64_t version, const cev_json *w) {
+    const char *data = cev_json_data(w);
+    if (!data) return NULL;
+    size_t len = cev_json_len(w);
+    size_t size = sizeof(room_frame) + len + 1;
+    room_frame *frame = cev_slab_alloc(size);
+    if (!frame) frame = malloc(size);
+    if (!frame) return NULL;
+    frame->refs = 1;
+    frame->kind = kind;
+    frame->version = version;
+    frame->len = len;
+    memcpy(frame->data, data, len + 1);
+    return frame;
+}
+
+static room_frame *frame_retain(room_frame *frame) {
+    __atomic_add_fetch(&frame->refs, 1, __ATOMIC_RELAXED);
+    return frame;
+}
+
+void room_frame_release(room_frame *frame) {
+    if (!frame || __atomic_sub_fetch(&frame->refs, 1, __ATOMIC_ACQ_REL) != 0) return;
+    if (cev_slab_owns(frame)) cev_slab_free(frame);
+    else free(frame);
+}
+
+static void kv_mask(cev_json *w, const char *key, uint64_t mask) {
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)mask);
+    cev_json_kv_string(w, key, hex);
+}
+
+/* Finds the single move that turns a into b: exactly one new disc, no disc removed, and only
+   the mover's opponent's discs changed colour. Returns 0 if b is not one move past a. */
+static int single_move(const bitboard *a, const bitboard *b, int *square, int *player, uint64_t *flips) {
+    uint64_t before = a->black | a->white;
+    uint64_t after = b->black | b->white;
+    uint64_t placed = after & ~before;
+    if ((before & ~after) || placed == 0 || (placed & (placed - 1))) return 0;
+    uint64_t to_black = a->white & b->black;
+    uint64_t to_white = a->black & b->white;
+    if (placed & b->black) {
+        if (to_white) return 0;
+        *player = BLACK;
+        *flips = to_black;
+    } else {
+        if (to_black) return 0;
+        *player = WHITE;
+        *flips = to_white;
+    }
+    *square = __builtin_ctzll(placed);
+    return 1;
+}
+
+static room_frame *build_state(const db_room_view *view) {
+    cev_json *w = cev_json_thread();
+    cev_json_begin_object(w);
+    cev_json_kv_string(w, "t", "state");
+    cev_json_kv_uint64(w, "v", view->version);
+    cev_json_kv_string(w, "status", view->status);
+    cev_json_kv_int(w, "turn", view->turn);
+    cev_json_kv_string(w, "mode", view->mode);
+    cev_json_kv_int(w, "players", view->players);
+    kv_mask(w, "black", view->board.black);
+    kv_mask(w, "white", view->board.white);
+    cev_json_end_object(w);
+    return frame_from(ROOM_FRAME_STATE, view->version, w);
+}
+
+static room_frame *build_move(const db_room_view *view, int square, int player, uint64_t flips) {
+    cev_json *w = cev_json_thread();
+    cev_json_begin_object(w);
+    cev_json_kv_string(w, "t", "move");
+    cev_json_kv_uint64(w, "v", view->version);
+    cev_json_kv_int(w, "sq", square);
+    cev_json_kv_int(w, "p", player);
+    kv_mask(w, "flips", flips);
+    cev_json_kv_int(w, "turn", view->turn);
+    cev_json_kv_string(w, "status", view->status);
+    cev_json_end_object(w);
+    return frame_from(ROOM_FRAME_MOVE, view->version, w);
+}
+
+static room_frame *build_closed(int room_id) {
+    cev_json *w = cev_json_thread();
+    cev_json_begin_object(w);
+    cev_json_kv_string(w, "t", "closed");
+    cev_json_kv_int(w, "room", room_id);
+    cev_json_end_object(w);
+    return frame_from(ROOM_FRAME_CLOSED, 0, w);
+}
+
+static void queue_push(room_sub *sub, room_frame *frame) {
+    sub->queue[(sub->head + sub->count) % ROOM_FEED_QUEUE] = frame_retain(frame);
+    if (sub->count++ == 0) {
+        uint64_t one = 1;
+        if (write(sub->efd, &one, sizeof(one)) < 0) {
+            // Only fails when the counter is already nonzero, which wakes the reader anyway.
+        }
+    }
+}
+
+static void queue_clear(room_sub *sub) {
+    while (sub->count > 0) {
+        room_frame_release(sub->queue[sub->head]);
+        sub->head = (sub->head + 1) % ROOM_FEED_QUEUE;
+        sub->count--;
+    }
+}
+
+/* Call with feeds_mutex held and feed->has_view set. NULL if the frame can't be allocated. */
+static room_frame *feed_state(room_feed *feed) {
+    if (!feed->state) feed->state = build_state(&feed->view);
+    return feed->state;
+}
+
+/* Call with feeds_mutex held. frame NULL means the change is only available as a state. A
+   subscriber that is not synced, or whose queue is full, drops what it has queued and gets
+   only the latest state: slow readers skip to the present instead of holding an unbounded
+   backlog. */
+static void fan_out(room_feed *feed, room_frame *frame) {
+    for (room_sub *sub = feed->subs; sub; sub = sub->next) {
+        if (frame && sub->synced && sub->count < ROOM_FEED_QUEUE) {
+            queue_push(sub, frame);
+            continue;
+        }
+        room_frame *state = feed_state(feed);
+        if (!state) {
+            sub->synced = 0;
+            continue;
+        }
+        if (sub->count == ROOM_FEED_QUEUE) {
+            queue_clear(sub);
+            sub->resets++;
+        }
+        queue_push(sub, state);
+        sub->synced = 1;
+    }
+}
+
+static room_feed *find_feed(int room_id) {
+    room_feed *feed = feed_buckets[feed_bucket(room_id)];
+    while (feed && feed->room_id != room_id) feed = feed->next;
+    return feed;
+}
+
+/* Serializes the room's change once and queues the frame to every subscriber. */
+static void broadcast_room(int room_id) {
+    db_room_view view;
+    int exists = db_get_room_view(db_conn, room_id, &view) == 0;
+
+    pthread_mutex_lock(&feeds_mutex);
+    room_feed *feed = find_feed(room_id);
+    if (!feed) {
+        pthread_mutex_unlock(&feeds_mutex);
+        return;
+    }
+    if (!exists) {
+        // Everyone hears it once; later subscribers hear it when they arrive.
+        room_frame *closed = build_closed(room_id);
+        for (room_sub *sub = feed->subs; sub && closed; sub = sub->next) {
+            if (feed->closed && sub->synced) continue;
+            if (sub->count == ROOM_FEED_QUEUE) queue_clear(sub);
+            queue_push(sub, closed);
+            sub->synced = 1;
+        }
+        room_frame_release(closed);
+        room_frame_release(feed->state);
+        feed->state = NULL;
+        feed->has_view = 0;
+        feed->closed = 1;
+        pthread_mutex_unlock(&feeds_mutex);
+        return;
+    }
+    if (feed->has_view && view.version <= feed->view.version) {
+        pthread_mutex_unlock(&feeds_mutex);
+        return;
+    }
+
+    room_frame *move = NULL;
+    int square, player;
+    uint64_t flips;
+    if (feed->has_view && single_move(&feed->view.board, &view.board, &square, &player, &flips)) {
+        move = build_move(&view, square, player, flips);
+    }
+    room_frame_release(feed->state);
+    feed->state = NULL;
+    feed->view = view;
+    feed->has_view = 1;
+    feed->closed = 0;
+    fan_out(feed, move);
+    room_frame_release(move);
+    pthread_mutex_unlock(&feeds_mutex);
+}
+
+/* Call with pending_mutex held. Returns the room's slot in the set: taken if it is already
+   pending, free otherwise. The set is kept at most half full. */
+static pending_slot *pending_find(int room_id) {
+    unsigned mask = pending_slot_cap - 1;
+    unsigned i = ((unsigned)room_id * 2654435761u) & mask;
+    while (pending_slots[i].batch == pending_batch && pending_slots[i].room_id != room_id) i = (i + 1) & mask;
+    return &pending_slots[i];
+}
+
+/* Call with pending_mutex held. Rebuilds the set from pending_ids at twice the size. */
+static int pending_grow_set(void) {
+    unsigned cap = pending_slot_cap ? pending_slot_cap * 2 : 128;
+    pending_slot *slots = calloc(cap, sizeof(pending_slot));
+    if (!slots) return -1;
+    free(pending_slots);
+    pending_slots = slots;
+    pending_slot_cap = cap;
+    for (int i = 0; i < pending_count; i++) {
+        pending_slot *slot = pending_find(pending_ids[i]);
+        slot->room_id = pending_ids[i];
+        slot->batch = pending_batch;
+    }
+    return 0;
+}
+
+static void queue_pending(int room_id) {
+    pthread_mutex_lock(&pending_mutex);
+    if ((unsigned)(pending_count + 1) * 2 > pending_slot_cap && pending_grow_set() != 0) {
+        pthread_mutex_unlock(&pending_mutex);
+        return;
+    }
+    pending_slot *slot = pending_find(room_id);
+    if (slot->batch == pending_batch) {
+        // Already queued; the broadcaster reads the room's latest state either way.
+        pthread_mutex_unlock(&pending_mutex);
+        return;
+    }
+    if (pending_count == pending_cap) {
+        int cap = pending_cap ? pending_cap * 2 : 64;
+        int *grown = realloc(pending_ids, sizeof(int) * (size_t)cap);
+        if (!grown) {
+            pthread_mutex_unlock(&pending_mutex);
+            return;
+        }
+        pending_ids = grown;
+        pending_cap = cap;
+    }
+    slot->room_id = room_id;
+    slot->batch = pending_batch;
+    pending_ids[pending_count++] = room_id;
+    pthread_cond_signal(&pending_cond);
+    pthread_mutex_unlock(&pending_mutex);
+}
+
+/* Runs with the room's stripe held: only note the id. */
+static void room_changed(int room_id) {
+    if (__atomic_load_n(&feeds_live, __ATOMIC_RELAXED) == 0) return;
+    queue_pending(room_id);
+}
+
+static void *broadcaster_thread(void *arg) {
+    (void)arg;
+    int *batch = NULL;
+    int batch_cap = 0;
+    for (;;) {
+        pthread_mutex_lock(&pending_mutex);
+        while (pending_count == 0) pthread_cond_wait(&pending_cond, &pending_mutex);
+        // Swap buffers so the watcher never waits behind a broadcast.
+        int n = pending_count;
+        int *ids = pending_ids;
+        int cap = pending_cap;
+        pending_ids = batch;
+        pending_cap = batch_cap;
+        pending_count = 0;
+        if (++pending_batch == 0) {
+            // Wrapped: clear stamps that could match again.
+            memset(pending_slots, 0, sizeof(pending_slot) * pending_slot_cap);
+            pending_batch = 1;
+        }
+        batch = ids;
+        batch_cap = cap;
+        pthread_mutex_unlock(&pending_mutex);
+
+        for (int i = 0; i < n; i++) broadcast_room(batch[i]);
+    }
+    return NULL;
+}
+
+int room_feed_init(void) {
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, broadcaster_thread, NULL) != 0) return -1;
+    pthread_detach(tid);
+    db_set_room_watcher(room_changed);
+    return 0;
+}
+
+int room_sub_init(room_sub *sub) {
+    memset(sub, 0, sizeof(*sub));
+    sub->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return sub->efd < 0 ? -1 : 0;
+}
+
+void room_sub_destroy(room_sub *sub) {
+    room_feed_unsubscribe(sub);
+    if (sub->efd >= 0) close(sub->efd);
+    sub->efd = -1;
+}
+
+void room_feed_subscribe(room_sub *sub, int room_id) {
+    room_feed_unsubscribe(sub);
+    pthread_mutex_lock(&feeds_mutex);
+    room_feed *feed = find_feed(room_id);
+    if (!feed) {
+        feed = calloc(1, sizeof(*feed));
+        if (!feed) {
+            pthread_mutex_unlock(&feeds_mutex);
+            return;
+        }
+        feed->room_id = room_id;
+        unsigned b = feed_bucket(room_id);
+        feed->next = feed_buckets[b];
+        feed_buckets[b] = feed;
+        __atomic_add_fetch(&feeds_live, 1, __ATOMIC_RELAXED);
+    }
+    sub->room_id = room_id;
+    sub->next = feed->subs;
+    feed->subs = sub;
+    sub->synced = 0;
+    room_frame *state = feed->has_view ? feed_state(feed) : NULL;
+    if (state) {
+        queue_push(sub, state);
+        sub->synced = 1;
+    }
+    pthread_mutex_unlock(&feeds_mutex);
+    // A feed that has not seen the room yet (or is closed) gets its first frame from the
+    // broadcaster.
+    if (!sub->synced) queue_pending(room_id);
+}
+
+void room_feed_unsubscribe(room_sub *sub) {
+    if (sub->room_id == 0) return;
+    pthread_mutex_lock(&feeds_mutex);
+    unsigned b = feed_bucket(sub->room_id);
+    room_feed **link = &feed_buckets[b];
+    while (*link && (*link)->room_id != sub->room_id) link = &(*link)->next;
+    room_feed *feed = *link;
+    if (feed) {
+        room_sub **s = &feed->subs;
+        while (*s && *s != sub) s = &(*s)->next;
+        if (*s) *s = sub->next;
+        if (!feed->subs) {
+            *link = feed->next;
+            room_frame_release(feed->state);
+            free(feed);
+            __atomic_sub_fetch(&feeds_live, 1, __ATOMIC_RELAXED);
+        }
+    }
+    queue_clear(sub);
+    sub->room_id = 0;
+    sub->next = NULL;
+    sub->synced = 0;
+    pthread_mutex_unlock(&feeds_mutex);
+}
+
+int room_sub_take(room_sub *sub, room_frame **out, int max) {
+    uint64_t count;
+    pthread_mutex_lock(&feeds_mutex);
+    if (read(sub->efd, &count, sizeof(count)) < 0) {
+        // Nothing signalled yet; the queue may still hold frames from before a resubscribe.
+    }
+    int n = 0;
+    while (n < max && sub->count > 0) {
+        out[n++] = sub->queue[sub->head];
+        sub->head = (sub->head + 1) % ROOM_FEED_QUEUE;
+        sub->count--;
+    }
+    if (sub->count > 0) {
+        uint64_t one = 1;
+        if (write(sub->efd, &one, sizeof(one)) < 0) {
+            // Already signalled.
+        }
+    }
+    pthread_mutex_unlock(&feeds_mutex);
+    return n;
+}
@@ -0,0 +1,57 @@
+#ifndef ROOM_FEED_H
+#define ROOM_FEED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Frames a subscriber may have waiting before it is reset to the room's latest state. */
+#define ROOM_FEED_QUEUE 16
+
+typedef enum room_frame_kind {
+    ROOM_FRAME_STATE,   /* whole room; always safe to apply */
+    ROOM_FRAME_MOVE,    /* one move on top of the previous frame */
+    ROOM_FRAME_CLOSED,  /* the room is gone; the subscriber should unsubscribe */
+} room_frame_kind;
+
+/* One room update, serialized once and shared read-only by every subscriber it is queued to.
+   data holds a JSON text message (see ws_game.h for the formats). */
+typedef struct room_frame {
+    int refs;
+    room_frame_kind kind;
+    uint64_t version;
+    size_t len;
+    char data[];
+} room_frame;
+
+void room_frame_release(room_frame *frame);
+
+/* A subscriber's bounded frame queue. It belongs to one connection, which alone drains it;
+   the broadcaster fills it while the subscriber is linked to a room. */
+typedef struct room_sub {
+    int room_id;        /* 0 while unsubscribed */
+    int efd;            /* eventfd bumped when the queue stops being empty */
+    int synced;         /* has the room's state queued or applied, so moves can follow */
+    unsigned head;
+    unsigned count;
+    room_frame *queue[ROOM_FEED_QUEUE];
+    uint64_t resets;    /* times a full queue was replaced by the latest state */
+    struct room_sub *next;
+} room_sub;
+
+/* Registers the room watcher and starts the broadcaster thread. Returns 0 on success. */
+int room_feed_init(void);
+
+/* Returns 0 on success, -1 if the eventfd could not be created. */
+int room_sub_init(room_sub *sub);
+/* Unsubscribes and closes the eventfd. */
+void room_sub_destroy(room_sub *sub);
+
+/* Switches sub to room_id. The room's current state is queued first, then every change. */
+void room_feed_subscribe(room_sub *sub, int room_id);
+void room_feed_unsubscribe(room_sub *sub);
+
+/* Moves up to max queued frames into out, oldest first; the caller releases each. Clears the
+   eventfd. Returns the count. */
+int room_sub_take(room_sub *sub, room_frame **out, int max);
+
+#endif
@@ -0,0 +1,351 @@
+#include "static_assets.h"
+
+#include "handlers_shared.h"
+
+#include <brotli/encode.h>
+#include <cwist/core/sstring/sstring.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <openssl/sha.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define STATIC_PATH_MAX 512
+/* Bytes of the SHA-256 digest kept in the ETag and hashed URL. */
+#define STATIC_HASH_BYTES 8
+
+typedef enum static_encoding {
+    ENC_IDENTITY,
+    ENC_GZIP,
+    ENC_BROTLI,
+    ENC_COUNT
+} static_encoding;
+
+static const char *const encoding_names[ENC_COUNT] = { NULL, "gzip", "br" };
+static const char *const encoding_tags[ENC_COUNT] = { "", "-gz", "-br" };
+
+typedef struct static_variant {
+    const unsigned char *data;
+    size_t len;
+    char etag[48];
+} static_variant;
+
+typedef struct static_asset {
+    char url[STATIC_ASSET_URL_MAX];
+    char hashed_url[STATIC_ASSET_URL_MAX];
+    const char *content_type;
+    /* Identity bytes are mapped from the file; the compressed ones are heap copies, present
+       only when they came out smaller. */
+    static_variant variants[ENC_COUNT];
+} static_asset;
+
+static static_asset assets[STATIC_ASSETS_MAX];
+static int asset_count = 0;
+
+static const struct {
+    const char *ext;
+    const char *type;
+    int compress;
+} content_types[] = {
+    { "js", "application/javascript", 1 },
+    { "css", "text/css", 1 },
+    { "wasm", "application/wasm", 1 },
+    { "html", "text/html", 1 },
+    { "json", "application/json", 1 },
+    { "svg", "image/svg+xml", 1 },
+    { "txt", "text/plain", 1 },
+    { "png", "image/png", 0 },
+    { "jpg", "image/jpeg", 0 },
+    { "ico", "image/x-icon", 0 },
+    { "woff2", "font/woff2", 0 },
+};
+
+static const char *extension_of(const char *name) {
+    const char *dot = strrchr(name, '.');
+    return dot && dot != name ? dot + 1 : NULL;
+}
+
+static int lookup_type(const char *name, const char **type) {
+    const char *ext = extension_of(name);
+    *type = "application/octet-stream";
+    if (!ext) return 0;
+    for (size_t i = 0; i < sizeof(content_types) / sizeof(content_types[0]); i++) {
+        if (strcmp(ext, content_types[i].ext) == 0) {
+            *type = content_types[i].type;
+            return content_types[i].compress;
+        }
+    }
+    return 0;
+}
+
+static int gzip_variant(const unsigned char *in, size_t len, static_variant *out) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // windowBits 15 + 16 selects the gzip wrapper.
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) return -1;
+    size_t cap = deflateBound(&zs, (uLong)len);
+    unsigned char *buf = malloc(cap);
+    if (!buf) {
+        deflateEnd(&zs);
+        return -1;
+    }
+    zs.next_in = (Bytef *)in;
+    zs.avail_in = (uInt)len;
+    zs.next_out = buf;
+    zs.avail_out = (uInt)cap;
+    int rc = deflate(&zs, Z_FINISH);
+    size_t written = cap - zs.avail_out;
+    deflateEnd(&zs);
+    if (rc != Z_STREAM_END) {
+        free(buf);
+        return -1;
+    }
+    out->data = buf;
+    out->len = written;
+    return 0;
+}
+
+static int brotli_variant(const unsigned char *in, size_t len, static_variant *out) {
+    size_t cap = BrotliEncoderMaxCompressedSize(len);
+    if (cap == 0) return -1;
+    unsigned char *buf = malloc(cap);
+    if (!buf) return -1;
+    size_t written = cap;
+    if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC,
+                               len, in, &written, buf)) {
+        free(buf);
+        return -1;
+    }
+    out->data = buf;
+    out->len = written;
+    return 0;
+}
+
+/* Maps path read-only, so the bytes live in the page cache rather than the heap. */
+static int map_file(const char *path, static_variant *out) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        out->data = (const unsigned char *)"";
+        out->len = 0;
+        return 0;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    out->data = map;
+    out->len = (size_t)st.st_size;
+    return 0;
+}
+
+/* name is relative to the asset directory, e.g. "script.js" or "img/logo.png". */
+static void add_asset(const char *path, const char *name, const char *prefix) {
+    if (asset_count == STATIC_ASSETS_MAX) {
+        fprintf(stderr, "Static asset table full; %s stays on the disk fallback\n", name);
+        return;
+    }
+    static_asset *a = &assets[asset_count];
+    memset(a, 0, sizeof(*a));
+    if (map_file(path, &a->variants[ENC_IDENTITY]) != 0) {
+        fprintf(stderr, "Failed to map static asset %s\n", path);
+        return;
+    }
+    const static_variant *plain = &a->variants[ENC_IDENTITY];
+
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256(plain->data, plain->len, digest);
+    char hash[STATIC_HASH_BYTES * 2 + 1];
+    for (int i = 0; i < STATIC_HASH_BYTES; i++) sprintf(hash + i * 2, "%02x", digest[i]);
+
+    int n = snprintf(a->url, sizeof(a->url), "%s/%s", prefix, name);
+    int hn;
+    const char *ext = extension_of(name);
+    if (ext) {
+        hn = snprintf(a->hashed_url, sizeof(a->hashed_url), "%s/%.*s.%s.%s", prefix,
+                      (int)(ext - 1 - name), name, hash, ext);
+    } else {
+        hn = snprintf(a->hashed_url, sizeof(a->hashed_url), "%s/%s.%s", prefix, name, hash);
+    }
+    if (n < 0 || hn < 0 || (size_t)n >= sizeof(a->url) || (size_t)hn >= sizeof(a->hashed_url)) {
+        fprintf(stderr, "Static asset path too long: %s\n", name);
+        if (plain->len > 0) munmap((void *)plain->data, plain->len);
+        return;
+    }
+
+    if (lookup_type(name, &a->content_type) && plain->len > 0) {
+        static_variant *gz = &a->variants[ENC_GZIP];
+        static_variant *br = &a->variants[ENC_BROTLI];
+        if (gzip_variant(plain->data, plain->len, gz) == 0 && gz->len >= plain->len) {
+            free((void *)gz->data);
+            gz->data = NULL;
+        }
+        if (brotli_variant(plain->data, plain->len, br) == 0 && br->len >= plain->len) {
+            free((void *)br->data);
+            br->data = NULL;
+        }
+    }
+    // A strong ETag names one representation, so each encoding gets its own.
+    for (int e = 0; e < ENC_COUNT; e++) {
+        if (!a->variants[e].data) continue;
+        snprintf(a->variants[e].etag, sizeof(a->variants[e].etag), "\"%s%s\"", hash, encoding_tags[e]);
+    }
+    asset_count++;
+}
+
+static void scan_dir(const char *dir, const char *rel, const char *prefix) {
+    char path[STATIC_PATH_MAX];
+    snprintf(path, sizeof(path), "%s%s%s", dir, rel[0] ? "/" : "", rel);
+    DIR *d = opendir(path);
+    if (!d) return;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (ent->d_name[0] == '.') continue;
+        char child_rel[STATIC_PATH_MAX];
+        char child_path[STATIC_PATH_MAX];
+        int n = snprintf(child_rel, sizeof(child_rel), "%s%s%s", rel, rel[0] ? "/" : "", ent->d_name);
+        if (n < 0 || (size_t)n >= sizeof(child_rel)) continue;
+        n = snprintf(child_path, sizeof(child_path), "%s/%s", dir, child_rel);
+        if (n < 0 || (size_t)n >= sizeof(child_path)) continue;
+        struct stat st;
+        if (stat(child_path, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) scan_dir(dir, child_rel, prefix);
+        else if (S_ISREG(st.st_mode)) add_asset(child_path, child_rel, prefix);
+    }
+    closedir(d);
+}
+
+int static_assets_load(const char *dir, const char *prefix) {
+    scan_dir(dir, "", prefix);
+    return asset_count;
+}
+
+int static_assets_count(void) {
+    return asset_count;
+}
+
+const char *static_assets_url(int i) {
+    return i >= 0 && i < asset_count ? assets[i].url : NULL;
+}
+
+const char *static_assets_hashed_url(int i) {
+    return i >= 0 && i < asset_count ? assets[i].hashed_url : NULL;
+}
+
+char *static_assets_rewrite(const char *text, size_t *len) {
+    char *out = NULL;
+    size_t out_len = *len;
+    const char *src = text;
+    for (int i = 0; i < asset_count; i++) {
+        const char *from = assets[i].url;
+        const char *to = assets[i].hashed_url;
+        size_t from_len = strlen(from);
+        size_t to_len = strlen(to);
+        // Only quoted references: "/static/a.js" must not match inside "/static/a.json".
+        size_t hits = 0;
+        for (const char *p = src; (p = strstr(p, from)) != NULL; p += from_len) {
+            if (p > src && (p[-1] == '"' || p[-1] == '\'') && p[from_len] == p[-1]) hits++;
+        }
+        if (hits == 0) continue;
+
+        char *next = malloc(out_len + hits * (to_len - from_len) + 1);
+        if (!next) break;
+        char *w = next;
+        const char *p = src;
+        const char *hit;
+        while ((hit = strstr(p, from)) != NULL) {
+            int quoted = hit > src && (hit[-1] == '"' || hit[-1] == '\'') && hit[from_len] == hit[-1];
+            size_t keep = (size_t)(hit - p) + (quoted ? 0 : from_len);
+            memcpy(w, p, keep);
+            w += keep;
+            if (quoted) {
+                memcpy(w, to, to_len);
+                w += to_len;
+            }
+            p = hit + from_len;
+        }
+        size_t rest = strlen(p);
+        memcpy(w, p, rest + 1);
+        out_len = (size_t)(w - next) + rest;
+        free(out);
+        out = next;
+        src = out;
+    }
+    if (out) *len = out_len;
+    return out;
+}
+
+/* Accept-Encoding lists codings with optional weights; q=0 refuses one. */
+static int accepts_encoding(const char *header, const char *name) {
+    size_t name_len = strlen(name);
+    const char *p = header;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') p++;
+        const char *end = p;
+        while (*end && *end != ',' && *end != ';' && *end != ' ') end++;
+        int match = (size_t)(end - p) == name_len && strncasecmp(p, name, name_len) == 0;
+        const char *next = strchr(end, ',');
+        const char *q = strstr(end, "q=");
+        int refused = q && (!next || q < next) && strtod(q + 2, NULL) <= 0.0;
+        if (match) return !refused;
+        if (!next) break;
+        p = next;
+    }
+    return 0;
+}
+
+static const static_asset *find_asset(const char *path, int *hashed) {
+    size_t len = strcspn(path, "?");
+    for (int i = 0; i < asset_count; i++) {
+        if (strlen(assets[i].url) == len && strncmp(assets[i].url, path, len) == 0) {
+            *hashed = 0;
+            return &assets[i];
+        }
+        if (strlen(assets[i].hashed_url) == len && strncmp(assets[i].hashed_url, path, len) == 0) {
+            *hashed = 1;
+            return &assets[i];
+        }
+    }
+    return NULL;
+}
+
+void static_asset_handler(cwist_http_request *req, cwist_http_response *res) {
+    int hashed = 0;
+    const static_asset *a = find_asset(req->path->data, &hashed);
+    if (!a) {
+        res->status_code = 404;
+        return;
+    }
+
+    static_encoding enc = ENC_IDENTITY;
+    const char *accept = cwist_http_header_get(req->headers, "Accept-Encoding");
+    if (accept) {
+        if (a->variants[ENC_BROTLI].data && accepts_encoding(accept, "br")) enc = ENC_BROTLI;
+        else if (a->variants[ENC_GZIP].data && accepts_encoding(accept, "gzip")) enc = ENC_GZIP;
+    }
+    const static_variant *v = &a->variants[enc];
+
+    cwist_http_header_add(&res->headers, "ETag", v->etag);
+    cwist_http_header_add(&res->headers, "Vary", "Accept-Encoding");
+    // A hashed URL names one exact content, so it never needs revalidating.
+    cwist_http_header_add(&res->headers, "Cache-Control",
+                          hashed ? "public, max-age=31536000, immutable" : "no-cache");
+    if (if_none_match(req, v->etag)) {
+        res->status_code = 304;
+        return;
+    }
+    cwist_http_header_add(&res->headers, "Content-Type", a->content_type);
+    if (encoding_names[enc]) cwist_http_header_add(&res->headers, "Content-Encoding", encoding_names[enc]);
+    cwist_sstring_assign_len(res->body, (const char *)v->data, v->len);
+}
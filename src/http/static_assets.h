@@ -0,0 +1,29 @@
+#ifndef STATIC_ASSETS_H
+#define STATIC_ASSETS_H
+
+#include <cwist/net/http/http.h>
+#include <stddef.h>
+
+#define STATIC_ASSETS_MAX 64
+#define STATIC_ASSET_URL_MAX 160
+
+/* Maps every file under dir at startup and precomputes its gzip and brotli variants and a
+   content-hash ETag. Each file is reachable at prefix/<path> (revalidated through the ETag)
+   and at a hashed URL prefix/<stem>.<hash>.<ext> that is cacheable forever. Returns the
+   number of assets loaded. Not thread-safe; call once before serving. */
+int static_assets_load(const char *dir, const char *prefix);
+
+int static_assets_count(void);
+/* URLs of asset i, for route registration. */
+const char *static_assets_url(int i);
+const char *static_assets_hashed_url(int i);
+
+/* Returns a copy of text (length *len, updated) in which every quoted reference to an asset's
+   plain URL points at its hashed URL instead, or NULL when nothing was rewritten. The caller
+   frees the copy. */
+char *static_assets_rewrite(const char *text, size_t *len);
+
+/* Serves the asset at req->path in the best encoding the client accepts. */
+void static_asset_handler(cwist_http_request *req, cwist_http_response *res);
+
+#endif
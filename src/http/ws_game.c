@@ -0,0 +1,199 @@
+#include "ws_game.h"
+
+#include "room_feed.h"
+#include "../core/json_writer.h"
+#include "../core/memory.h"
+#include "../core/metrics.h"
+#include "../data/db.h"
+
+#include <cjson/cJSON.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+
+/* An idle connection is pinged this often so proxies keep it open. */
+#define WS_PING_INTERVAL_MS 30000
+#define WS_CLOSE_NORMAL 1000
+#define WS_CLOSE_INTERNAL 1011
+
+typedef struct ws_session {
+    cwist_websocket *ws;
+    room_sub sub;
+    int player;  /* 0 = spectator */
+} ws_session;
+
+static int ws_metric = -1;
+
+void ws_game_init(void) {
+    ws_metric = cev_metrics_route("ws", "/ws");
+    if (room_feed_init() != 0) fprintf(stderr, "Failed to start the room broadcaster; /ws gets no updates\n");
+}
+
+static int send_writer(ws_session *s, const cev_json *w) {
+    const char *data = cev_json_data(w);
+    if (!data) return 0;
+    return cwist_websocket_send(s->ws, CWIST_WS_OP_TEXT, data, cev_json_len(w)) >= 0;
+}
+
+static int send_error(ws_session *s, const char *error) {
+    cev_json *w = cev_json_thread();
+    cev_json_begin_object(w);
+    cev_json_kv_string(w, "t", "error");
+    cev_json_kv_string(w, "error", error);
+    cev_json_end_object(w);
+    return send_writer(s, w);
+}
+
+/* Sends every frame the broadcaster queued, in order. Returns 0 if the connection failed. */
+static int send_frames(ws_session *s) {
+    room_frame *frames[ROOM_FEED_QUEUE];
+    int n = room_sub_take(&s->sub, frames, ROOM_FEED_QUEUE);
+    int alive = 1;
+    for (int i = 0; i < n; i++) {
+        if (alive) alive = cwist_websocket_send(s->ws, CWIST_WS_OP_TEXT, frames[i]->data, frames[i]->len) >= 0;
+        if (frames[i]->kind == ROOM_FRAME_CLOSED) {
+            room_feed_unsubscribe(&s->sub);
+            s->player = 0;
+        }
+        room_frame_release(frames[i]);
+    }
+    return alive;
+}
+
+static int json_int(cJSON *json, const char *key, int fallback) {
+    cJSON *item = cJSON_GetObjectItem(json, key);
+    return cJSON_IsNumber(item) ? item->valueint : fallback;
+}
+
+/* Returns the /metrics status of the message; *alive turns 0 if the connection failed. */
+static int handle_join(ws_session *s, cJSON *json, int spectate, int *alive) {
+    int room_id = json_int(json, "room", 1);
+    int player = spectate ? 0 : json_int(json, "player", 0);
+    char mode[16];
+    db_room_view view;
+
+    if (!spectate && player == 0) {
+        cJSON *mode_item = cJSON_GetObjectItem(json, "mode");
+        const char *requested_mode = cJSON_IsString(mode_item) ? mode_item->valuestring : NULL;
+        if (db_join_game(db_conn, room_id, requested_mode, &player, mode, json_int(json, "user_id", 0)) < 0) {
+            *alive = send_error(s, "Room full");
+            return 403;
+        }
+    } else if (player < 0 || player > 2) {
+        *alive = send_error(s, "Bad player");
+        return 400;
+    } else if (db_get_room_view(db_conn, room_id, &view) != 0) {
+        *alive = send_error(s, "No such room");
+        return 404;
+    } else {
+        strcpy(mode, view.mode);
+    }
+
+    room_feed_unsubscribe(&s->sub);
+    s->player = player;
+    if (player) {
+        cev_json *w = cev_json_thread();
+        cev_json_begin_object(w);
+        cev_json_kv_string(w, "t", "joined");
+        cev_json_kv_int(w, "room", room_id);
+        cev_json_kv_int(w, "player", player);
+        cev_json_kv_string(w, "mode", mode);
+        cev_json_end_object(w);
+        if (!send_writer(s, w)) {
+            *alive = 0;
+            return 200;
+        }
+    }
+    // The room's state is this subscription's first frame.
+    room_feed_subscribe(&s->sub, room_id);
+    return 200;
+}
+
+/* The move's frame reaches this connection through the room feed like everyone else's. */
+static int handle_move(ws_session *s, cJSON *json, int *alive) {
+    if (s->player == 0) {
+        *alive = send_error(s, "Join a room first");
+        return 403;
+    }
+    int rc = db_play_move(db_conn, s->sub.room_id, s->player, json_int(json, "r", -1), json_int(json, "c", -1), NULL);
+    if (rc == DB_MOVE_ILLEGAL) {
+        *alive = send_error(s, "Illegal move");
+        return 400;
+    }
+    if (rc != DB_MOVE_OK) {
+        *alive = send_error(s, "Not your turn");
+        return 403;
+    }
+    return 200;
+}
+
+/* Returns 0 when the connection should close. */
+static int handle_message(ws_session *s, const cwist_ws_message *msg) {
+    if (msg->opcode == CWIST_WS_OP_CLOSE) return 0;
+    if (msg->opcode == CWIST_WS_OP_PING) {
+        return cwist_websocket_send(s->ws, CWIST_WS_OP_PONG, msg->payload, msg->payload_len) >= 0;
+    }
+    if (msg->opcode != CWIST_WS_OP_TEXT) return 1;
+
+    uint64_t start = cev_metrics_now_ns();
+    int alive = 1;
+    int status = 400;
+    cev_arena_begin();
+    cJSON *json = cJSON_ParseWithLength((const char *)msg->payload, msg->payload_len);
+    cJSON *type = cJSON_GetObjectItem(json, "t");
+    if (!cJSON_IsString(type)) {
+        alive = send_error(s, "Bad message");
+    } else if (strcmp(type->valuestring, "move") == 0) {
+        status = handle_move(s, json, &alive);
+    } else if (strcmp(type->valuestring, "join") == 0) {
+        status = handle_join(s, json, 0, &alive);
+    } else if (strcmp(type->valuestring, "watch") == 0) {
+        status = handle_join(s, json, 1, &alive);
+    } else {
+        alive = send_error(s, "Unknown message type");
+    }
+    cJSON_Delete(json);
+    cev_arena_reset();
+    cev_metrics_observe(ws_metric, status, cev_metrics_now_ns() - start);
+    return alive;
+}
+
+/* Each connection runs on its own thread and is the only writer to its socket: it sleeps in
+   poll() until the client sends a frame or the room feed queues one. */
+void ws_game_handler(cwist_websocket *ws) {
+    ws_session s;
+    memset(&s, 0, sizeof(s));
+    s.ws = ws;
+    if (room_sub_init(&s.sub) != 0) {
+        cwist_websocket_close(ws, WS_CLOSE_INTERNAL);
+        return;
+    }
+
+    struct pollfd fds[2] = {
+        { .fd = ws->fd, .events = POLLIN },
+        { .fd = s.sub.efd, .events = POLLIN },
+    };
+    int alive = 1;
+    while (alive) {
+        int ready = poll(fds, 2, WS_PING_INTERVAL_MS);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (ready == 0) {
+            alive = cwist_websocket_send(ws, CWIST_WS_OP_PING, NULL, 0) >= 0;
+            continue;
+        }
+        if (fds[1].revents & POLLIN) alive = send_frames(&s);
+        if (alive && (fds[0].revents & (POLLIN | POLLHUP | POLLERR))) {
+            cwist_ws_message *msg = cwist_websocket_receive(ws);
+            if (!msg) break;
+            alive = handle_message(&s, msg);
+            cwist_ws_message_destroy(msg);
+        }
+    }
+
+    room_sub_destroy(&s.sub);
+    cwist_websocket_close(ws, WS_CLOSE_NORMAL);
+}
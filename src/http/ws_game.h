@@ -0,0 +1,27 @@
+#ifndef WS_GAME_H
+#define WS_GAME_H
+
+#include <cwist/net/websocket/websocket.h>
+
+/* Registers the room watcher that wakes /ws connections. Call once before serving. */
+void ws_game_init(void);
+
+/* /ws: one persistent connection per player or spectator. Text frames carry JSON.
+   Client -> server:
+     {"t":"join","room":N[,"mode":"othello"][,"user_id":U]}  take a seat, as POST /join does
+     {"t":"join","room":N,"player":P}   resume a seat already taken through POST /join
+     {"t":"watch","room":N}             spectate
+     {"t":"move","r":R,"c":C}           play as the joined player
+   Server -> client:
+     {"t":"joined","room":N,"player":P,"mode":M}
+     {"t":"state","v":V,"status":S,"turn":T,"mode":M,"players":K,"black":HEX,"white":HEX}
+     {"t":"move","v":V,"sq":Q,"p":P,"flips":HEX,"turn":T,"status":S}
+     {"t":"closed","room":N} when the room is dropped, {"t":"error","error":E} for a rejected message.
+   Boards and flip masks are 16-digit hex bitboards (bit r * 8 + c). A room change that is a
+   single move goes out as a "move" delta; anything else sends the whole "state". Each change
+   is serialized once per room and the frame shared by every connection watching it (see
+   room_feed.h); a connection that falls ROOM_FEED_QUEUE frames behind skips straight to the
+   latest "state". */
+void ws_game_handler(cwist_websocket *ws);
+
+#endif
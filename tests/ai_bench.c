@@ -0,0 +1,159 @@
+/* AI search throughput benchmark: make ai-bench && ./tests/ai_bench [max_workers] [depth] [searches]
+   Prints positions/sec (search nodes) for increasing pool sizes, first with many concurrent
+   requests (how /ai/move is loaded in production), then for a single root-split search.
+   First checks that a search on a board with more legal moves than any real game reaches
+   returns a legal move, and exits 1 if not. */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/core/memory.h"
+#include "../src/game/ai.h"
+#include "../src/game/ai_pool.h"
+#include "../src/game/tt.h"
+
+#define BENCH_POSITIONS 64
+#define BENCH_TT_MB 64
+
+/* Black has 35 legal moves. POST /ai/move takes any board, so the search must handle every
+   move mask up to 64 squares. */
+static const bitboard wide_board = { .black = 0x60213744203c0800ULL, .white = 0x0052000252405600ULL };
+
+static bitboard positions[BENCH_POSITIONS];
+static int position_player[BENCH_POSITIONS];
+
+typedef struct bench_client {
+    pthread_t tid;
+    int first;
+    int searches;
+    int depth;
+    uint64_t nodes;
+} bench_client;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Midgame positions from seeded random playouts, so every run searches the same set. */
+static void build_positions(void) {
+    unsigned seed = 20240601u;
+    for (int i = 0; i < BENCH_POSITIONS; i++) {
+        bitboard b;
+        bitboard_init(&b, 1);
+        int p = BLACK;
+        int plies = 14 + i % 12;
+        for (int k = 0; k < plies; k++) {
+            uint64_t moves = bitboard_legal_moves(&b, p);
+            if (!moves) {
+                p = BITBOARD_OPPONENT(p);
+                if (!bitboard_has_moves(&b, p)) break;
+                continue;
+            }
+            int pick = (int)(rand_r(&seed) % (unsigned)__builtin_popcountll(moves));
+            while (pick-- > 0) moves &= moves - 1;
+            bitboard_apply_move(&b, p, __builtin_ctzll(moves));
+            p = BITBOARD_OPPONENT(p);
+        }
+        positions[i] = b;
+        position_player[i] = p;
+    }
+}
+
+static void *client_main(void *arg) {
+    bench_client *c = arg;
+    ai_limits limits = { .max_depth = c->depth, .time_ms = 600000, .random_pct = 0 };
+    for (int i = 0; i < c->searches; i++) {
+        int idx = (c->first + i) % BENCH_POSITIONS;
+        ai_result r;
+        ai_search(&positions[idx], position_player[idx], &limits, &r);
+        c->nodes += r.nodes;
+    }
+    return NULL;
+}
+
+/* Runs clients concurrent requesters against a pool of workers; returns nodes/sec. */
+static double run(int workers, int clients, int depth, int searches, double *elapsed) {
+    /* Every run starts cold so earlier runs do not hand later ones a warm table. */
+    tt_clear();
+    ai_pool_start(workers);
+    bench_client *cs = calloc((size_t)clients, sizeof(bench_client));
+    double t0 = now_sec();
+    for (int i = 0; i < clients; i++) {
+        cs[i].first = i * 7;
+        cs[i].searches = searches;
+        cs[i].depth = depth;
+        pthread_create(&cs[i].tid, NULL, client_main, &cs[i]);
+    }
+    uint64_t nodes = 0;
+    for (int i = 0; i < clients; i++) {
+        pthread_join(cs[i].tid, NULL);
+        nodes += cs[i].nodes;
+    }
+    *elapsed = now_sec() - t0;
+    free(cs);
+    ai_pool_stop();
+    return (double)nodes / *elapsed;
+}
+
+/* Searches wide_board inline and on a pool, where the root moves are split over workers. */
+static int check_wide_board(int workers) {
+    ai_limits limits = { .max_depth = 3, .time_ms = 10000, .random_pct = 0 };
+    uint64_t legal = bitboard_legal_moves(&wide_board, BLACK);
+    int ok = 1;
+    for (int pooled = 0; pooled <= 1; pooled++) {
+        if (pooled) ai_pool_start(workers);
+        ai_result r;
+        ai_search(&wide_board, BLACK, &limits, &r);
+        if (r.move < 0 || !(legal & BITBOARD_BIT(r.move))) {
+            fprintf(stderr, "%s search on a %d-move board returned move %d\n", pooled ? "pooled" : "inline",
+                    __builtin_popcountll(legal), r.move);
+            ok = 0;
+        }
+        if (pooled) ai_pool_stop();
+    }
+    return ok;
+}
+
+/* 1, 2, 4, ... and finally max itself. */
+static int next_workers(int w, int max) {
+    return w * 2 <= max ? w * 2 : max;
+}
+
+int main(int argc, char **argv) {
+    int max_workers = argc > 1 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int depth = argc > 2 ? atoi(argv[2]) : 7;
+    int searches = argc > 3 ? atoi(argv[3]) : 8;
+    if (max_workers < 1) max_workers = 1;
+
+    cev_mem_bootstrap();
+    if (tt_init(BENCH_TT_MB) != 0) fprintf(stderr, "transposition table unavailable; running uncached\n");
+    if (!check_wide_board(max_workers)) return 1;
+    build_positions();
+
+    printf("concurrent requests (2 per worker, %d searches each, depth %d)\n", searches, depth);
+    printf("workers\tpos/sec\t\tspeedup\tseconds\n");
+    double base = 0.0;
+    for (int w = 1;; w = next_workers(w, max_workers)) {
+        double elapsed;
+        double rate = run(w, 2 * w, depth, searches, &elapsed);
+        if (w == 1) base = rate;
+        printf("%d\t%.0f\t%.2fx\t%.2f\n", w, rate, rate / base, elapsed);
+        if (w == max_workers) break;
+    }
+
+    printf("\nsingle search, root split (%d searches, depth %d)\n", searches * 2, depth + 2);
+    printf("workers\tpos/sec\t\tspeedup\tseconds\n");
+    for (int w = 1;; w = next_workers(w, max_workers)) {
+        double elapsed;
+        double rate = run(w, 1, depth + 2, searches * 2, &elapsed);
+        if (w == 1) base = rate;
+        printf("%d\t%.0f\t%.2fx\t%.2f\n", w, rate, rate / base, elapsed);
+        if (w == max_workers) break;
+    }
+    return 0;
+}
@@ -10,6 +10,7 @@ PROTO="${PROTO:-http}"        # http or https
 PATH_INDEX="${PATH_INDEX:-/}"
 PATH_API="${PATH_API:-/api}"
 PATH_POST="${PATH_POST:-/api}" # change if your POST endpoint differs
+PATH_LOCKS="${PATH_LOCKS:-/admin/locks}" # lock contention counters, snapshotted around the run
 
 # Concurrency sweep
 CONCURRENCY_LIST=(${CONCURRENCY_LIST:-"1 4 8 16 32 64"})
@@ -95,10 +96,17 @@ run_suite() {
 
 echo -e "suite\tC\tRPS\tTPR(ms)\tP50(ms)\tP90(ms)\tP99(ms)" > "${OUTDIR}/summary.tsv"
 
+snapshot_locks() {
+  command -v curl >/dev/null 2>&1 || return 0
+  curl -ks "${URL_BASE}${PATH_LOCKS}" > "${OUTDIR}/locks_$1.json" || true
+}
+
 # Warm-up (short)
 echo "[WARMUP]"
 ab -n 2000 -c 8 -s "${TIMEOUT}" -r -S "${URL_BASE}${PATH_INDEX}" >/dev/null || true
 
+snapshot_locks before
+
 # GET /
 run_suite "GET_index" "${URL_BASE}${PATH_INDEX}"
 
@@ -109,9 +117,12 @@ run_suite "GET_api" "${URL_BASE}${PATH_API}"
 # -p payload -T content-type
 run_suite "POST_json" "${URL_BASE}${PATH_POST}" -p "${PAYLOAD_FILE}" -T "application/json"
 
+snapshot_locks after
+
 echo
 echo "[DONE] Results in: ${OUTDIR}"
 echo "Summary: ${OUTDIR}/summary.tsv"
 echo
 echo "Tip: compare two runs by diffing summary.tsv (before vs after)."
+echo "Lock contention: diff locks_before.json and locks_after.json (if curl was available)."
 
@@ -0,0 +1,78 @@
+/* Endgame solver benchmark: make endgame-bench && ./tests/endgame_bench [max_empties]
+   Solves a fixed set of endgame positions exactly (in the spirit of the FFO test suite) and
+   prints nodes/sec per position and overall. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/game/endgame.h"
+
+#define BENCH_PER_EMPTIES 4
+#define BENCH_MIN_EMPTIES 12
+#define BENCH_DEFAULT_MAX_EMPTIES 18
+#define BENCH_TIME_MS 600000
+
+/* Reaches exactly empties empty squares by seeded random play; the same seed always gives the same position. */
+static int build_position(unsigned seed, int empties, bitboard *out, int *player) {
+    bitboard b;
+    bitboard_init(&b, 1);
+    int p = BLACK;
+    while (64 - bitboard_count_all(&b) > empties) {
+        uint64_t moves = bitboard_legal_moves(&b, p);
+        if (!moves) {
+            p = BITBOARD_OPPONENT(p);
+            if (!bitboard_has_moves(&b, p)) return 0;
+            continue;
+        }
+        int pick = (int)(rand_r(&seed) % (unsigned)__builtin_popcountll(moves));
+        while (pick-- > 0) moves &= moves - 1;
+        bitboard_apply_move(&b, p, __builtin_ctzll(moves));
+        p = BITBOARD_OPPONENT(p);
+    }
+    if (!bitboard_has_moves(&b, p)) return 0;
+    *out = b;
+    *player = p;
+    return 1;
+}
+
+static void square_name(int sq, char *out) {
+    out[0] = sq < 0 ? '-' : (char)('a' + sq % SIZE);
+    out[1] = sq < 0 ? '-' : (char)('1' + sq / SIZE);
+    out[2] = '\0';
+}
+
+int main(int argc, char **argv) {
+    int max_empties = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_MAX_EMPTIES;
+    if (max_empties > ENDGAME_MAX_EMPTIES) max_empties = ENDGAME_MAX_EMPTIES;
+
+    printf("%-4s %7s %6s %5s %12s %9s %12s\n", "#", "empties", "score", "move", "nodes", "ms", "nodes/sec");
+    uint64_t total_nodes = 0;
+    long long total_ms = 0;
+    int id = 0;
+    for (int empties = BENCH_MIN_EMPTIES; empties <= max_empties; empties += 2) {
+        unsigned seed = 1000u * (unsigned)empties;
+        for (int k = 0; k < BENCH_PER_EMPTIES; seed++) {
+            bitboard b;
+            int player;
+            if (!build_position(seed, empties, &b, &player)) continue;
+            k++;
+            id++;
+            endgame_result r;
+            if (endgame_solve(&b, player, BENCH_TIME_MS, 0, &r) != 0) {
+                printf("%-4d %7d  timed out\n", id, empties);
+                continue;
+            }
+            char move[4];
+            square_name(r.move, move);
+            double nps = r.elapsed_ms > 0 ? (double)r.nodes * 1000.0 / r.elapsed_ms : 0.0;
+            printf("%-4d %7d %+6d %5s %12llu %9d %12.0f\n", id, empties, r.score, move,
+                   (unsigned long long)r.nodes, r.elapsed_ms, nps);
+            fflush(stdout);
+            total_nodes += r.nodes;
+            total_ms += r.elapsed_ms;
+        }
+    }
+    printf("total: %llu nodes in %lld ms, %.0f nodes/sec\n", (unsigned long long)total_nodes, total_ms,
+           total_ms > 0 ? (double)total_nodes * 1000.0 / (double)total_ms : 0.0);
+    return 0;
+}
@@ -0,0 +1,241 @@
+/* Room feed fan-out benchmark: make room-feed-bench && ./tests/room_feed_bench [subscribers] [rooms] [games] [readers]
+   Plays games of random moves in every room as fast as moves are accepted, resetting the
+   rooms between games, while subscribers follow them through the room feed as /ws
+   connections do. Half the subscribers are drained by reader threads; the other half never
+   read until the end, so they exercise the drop-to-latest path. Prints moves/sec and frames
+   delivered/sec, and exits 1 if any subscriber ends on a board other than its room's. */
+#define _GNU_SOURCE
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cjson/cJSON.h>
+#include <cwist/sys/app/app.h>
+
+#include "../src/core/memory.h"
+#include "../src/data/db.h"
+#include "../src/http/room_feed.h"
+
+#define BENCH_FIRST_ROOM 1000
+#define BENCH_SETTLE_MS 5000
+
+typedef struct bench_sub {
+    room_sub sub;
+    bitboard board;     /* as rebuilt from the frames */
+    uint64_t version;   /* published last, so the main thread can watch readers catch up */
+    uint64_t frames;
+} bench_sub;
+
+typedef struct bench_reader {
+    pthread_t tid;
+    bench_sub *subs;
+    int count;
+} bench_reader;
+
+static int reading = 1;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t json_mask(cJSON *json, const char *key) {
+    cJSON *item = cJSON_GetObjectItem(json, key);
+    return cJSON_IsString(item) ? strtoull(item->valuestring, NULL, 16) : 0;
+}
+
+/* Applies one frame the way a client does: a state replaces the board, a move is replayed. */
+static void apply_frame(bench_sub *s, const room_frame *frame) {
+    s->frames++;
+    if (frame->kind == ROOM_FRAME_CLOSED) return;
+    cJSON *json = cJSON_ParseWithLength(frame->data, frame->len);
+    if (!json) return;
+    if (frame->kind == ROOM_FRAME_STATE) {
+        s->board.black = json_mask(json, "black");
+        s->board.white = json_mask(json, "white");
+    } else {
+        cJSON *sq = cJSON_GetObjectItem(json, "sq");
+        cJSON *p = cJSON_GetObjectItem(json, "p");
+        uint64_t changed = json_mask(json, "flips") | BITBOARD_BIT(sq->valueint);
+        if (p->valueint == BLACK) {
+            s->board.black |= changed;
+            s->board.white &= ~changed;
+        } else {
+            s->board.white |= changed;
+            s->board.black &= ~changed;
+        }
+    }
+    __atomic_store_n(&s->version, frame->version, __ATOMIC_RELEASE);
+    cJSON_Delete(json);
+}
+
+static void drain(bench_sub *s) {
+    room_frame *frames[ROOM_FEED_QUEUE];
+    int n = room_sub_take(&s->sub, frames, ROOM_FEED_QUEUE);
+    for (int i = 0; i < n; i++) {
+        apply_frame(s, frames[i]);
+        room_frame_release(frames[i]);
+    }
+}
+
+static void *reader_main(void *arg) {
+    bench_reader *r = arg;
+    struct pollfd *fds = calloc((size_t)r->count, sizeof(struct pollfd));
+    if (!fds) return NULL;
+    for (int i = 0; i < r->count; i++) {
+        fds[i].fd = r->subs[i].sub.efd;
+        fds[i].events = POLLIN;
+    }
+    while (__atomic_load_n(&reading, __ATOMIC_RELAXED)) {
+        if (poll(fds, (nfds_t)r->count, 50) <= 0) continue;
+        for (int i = 0; i < r->count; i++) {
+            if (fds[i].revents & POLLIN) drain(&r->subs[i]);
+        }
+    }
+    free(fds);
+    return NULL;
+}
+
+/* Plays one random legal move in the room. Returns 0 once the game is over. */
+static int play_random_move(cwist_db *db, int room_id, unsigned *seed) {
+    db_room_view view;
+    if (db_get_room_view(db, room_id, &view) != 0 || strcmp(view.status, "active") != 0) return 0;
+    uint64_t moves = bitboard_legal_moves(&view.board, view.turn);
+    if (!moves) return 0;
+    int pick = (int)(rand_r(seed) % (unsigned)__builtin_popcountll(moves));
+    while (pick-- > 0) moves &= moves - 1;
+    int sq = __builtin_ctzll(moves);
+    return db_play_move(db, room_id, view.turn, sq / SIZE, sq % SIZE, NULL) == DB_MOVE_OK;
+}
+
+static int up_to_date(const bench_sub *s, const db_room_view *view) {
+    return s->version == view->version && s->board.black == view->board.black && s->board.white == view->board.white;
+}
+
+int main(int argc, char **argv) {
+    int subscribers = argc > 1 ? atoi(argv[1]) : 2000;
+    int rooms = argc > 2 ? atoi(argv[2]) : 16;
+    int games = argc > 3 ? atoi(argv[3]) : 20;
+    int readers = argc > 4 ? atoi(argv[4]) : 4;
+    if (subscribers < 2) subscribers = 2;
+    if (rooms < 1) rooms = 1;
+    if (games < 1) games = 1;
+    if (readers < 1) readers = 1;
+    if (readers > subscribers / 2) readers = subscribers / 2;
+
+    char dir[] = "/tmp/room_feed_bench.XXXXXX";
+    char path[sizeof(dir) + 16];
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(path, sizeof(path), "%s/othello.db", dir);
+
+    cev_mem_bootstrap();
+    cwist_app *app = cwist_app_create();
+    if (!app) {
+        fprintf(stderr, "Failed to create cwist app\n");
+        return 1;
+    }
+    cwist_app_use_nuke_db(app, path, 5000);
+    cwist_db *db = cwist_app_get_db(app);
+    init_db(db);
+    if (room_feed_init() != 0) {
+        fprintf(stderr, "Failed to start the room broadcaster\n");
+        return 1;
+    }
+
+    bench_sub *subs = calloc((size_t)subscribers, sizeof(bench_sub));
+    bench_reader *rs = calloc((size_t)readers, sizeof(bench_reader));
+    if (!subs || !rs) return 1;
+    for (int i = 0; i < subscribers; i++) {
+        if (room_sub_init(&subs[i].sub) != 0) {
+            fprintf(stderr, "Out of eventfds at subscriber %d\n", i);
+            return 1;
+        }
+        room_feed_subscribe(&subs[i].sub, BENCH_FIRST_ROOM + i % rooms);
+    }
+    // The first half is read as frames arrive, split evenly over the reader threads.
+    int fast = subscribers / 2;
+    for (int i = 0; i < readers; i++) {
+        rs[i].subs = subs + fast * i / readers;
+        rs[i].count = fast * (i + 1) / readers - fast * i / readers;
+        pthread_create(&rs[i].tid, NULL, reader_main, &rs[i]);
+    }
+
+    printf("%d subscribers (%d read live) on %d rooms, %d games each, %d reader threads\n", subscribers, fast,
+           rooms, games, readers);
+    unsigned seed = 20240601u;
+    int moves = 0;
+    double t0 = now_sec();
+    for (int g = 0; g < games; g++) {
+        // Subscriptions outlive the room: a reset sends "closed", the next game a fresh state.
+        for (int r = 0; r < rooms; r++) {
+            int player;
+            char mode[16];
+            if (g > 0) db_reset_room(db, BENCH_FIRST_ROOM + r);
+            db_join_game(db, BENCH_FIRST_ROOM + r, "othello", &player, mode, 0);
+            db_join_game(db, BENCH_FIRST_ROOM + r, "othello", &player, mode, 0);
+        }
+        int live = rooms;
+        while (live > 0) {
+            live = 0;
+            for (int r = 0; r < rooms; r++) {
+                if (play_random_move(db, BENCH_FIRST_ROOM + r, &seed)) {
+                    moves++;
+                    live++;
+                }
+            }
+        }
+    }
+    double played = now_sec() - t0;
+
+    // Every live reader must catch up with its room's final version; boards are compared once
+    // the readers have stopped.
+    db_room_view *finals = calloc((size_t)rooms, sizeof(db_room_view));
+    if (!finals) return 1;
+    for (int r = 0; r < rooms; r++) db_get_room_view(db, BENCH_FIRST_ROOM + r, &finals[r]);
+    double deadline = now_sec() + BENCH_SETTLE_MS / 1000.0;
+    int behind = fast;
+    while (behind > 0 && now_sec() < deadline) {
+        behind = 0;
+        for (int i = 0; i < fast; i++) {
+            behind += __atomic_load_n(&subs[i].version, __ATOMIC_ACQUIRE) != finals[i % rooms].version;
+        }
+        if (behind) usleep(1000);
+    }
+    double settled = now_sec() - t0;
+    __atomic_store_n(&reading, 0, __ATOMIC_RELAXED);
+    for (int i = 0; i < readers; i++) pthread_join(rs[i].tid, NULL);
+
+    uint64_t delivered = 0;
+    uint64_t resets = 0;
+    for (int i = 0; i < fast; i++) delivered += subs[i].frames;
+    for (int i = fast; i < subscribers; i++) {
+        drain(&subs[i]);
+        resets += subs[i].sub.resets;
+    }
+    int mismatched = 0;
+    for (int i = 0; i < subscribers; i++) mismatched += !up_to_date(&subs[i], &finals[i % rooms]);
+
+    printf("moves\tmoves/sec\tframes/sec\tseconds\n");
+    printf("%d\t%.0f\t\t%.0f\t\t%.2f\n", moves, moves / played, delivered / settled, settled);
+    printf("slow subscribers reset to the latest state %llu times\n", (unsigned long long)resets);
+    printf("subscribers off their room's final board: %d\n", mismatched);
+
+    for (int i = 0; i < subscribers; i++) room_sub_destroy(&subs[i].sub);
+    free(finals);
+    free(rs);
+    free(subs);
+    cwist_app_destroy(app);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/betting.db", dir);
+    unlink(path);
+    rmdir(dir);
+    return mismatched ? 1 : 0;
+}